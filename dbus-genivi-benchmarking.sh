@@ -3,6 +3,32 @@
 DBUS_TEST_DATA="struct:int32:1:double:12.6:double:1e40:string:XXXXXXXXXXXXXXXXXXXX"
 DBUS_TEST_DATA_MULTIPLY="0 1 10 100 1000"
 DBUS_PING_COUNT=70000
+DBUS_PING=dbus-ping
+DBUS_PING_SYSTEMD=${DBUS_PING_SYSTEMD:-dbus-ping-systemd}
+DBUS_PING_GDBUS=${DBUS_PING_GDBUS:-dbus-ping-gdbus}
+
+DBUS_TEST_SERVICE=${DBUS_TEST_SERVICE:-/usr/libexec/dbus-test-service}
+DBUS_TEST_SERVICE_SYSTEMD=${DBUS_TEST_SERVICE_SYSTEMD:-/usr/libexec/dbus-test-service-systemd}
+DBUS_TEST_SERVICE_GDBUS=${DBUS_TEST_SERVICE_GDBUS:-/usr/libexec/dbus-test-service-gdbus}
+DBUS_TEST_SERVICE_WORKERS="0 1 2 4 8"
+DBUS_TEST_SERVICE_MAIN_LOOPS="dispatch epoll"
+DBUS_TEST_SERVICE_CLIENTS=8
+DBUS_TEST_SERVICE_OUTPUT=dbus-test-service.out
+DBUS_TEST_SERVICE_HANDLER_COST="getEcho:spin:exp:100"
+DBUS_TEST_SERVICE_LOAD_CLIENTS="1 2 4 8 16"
+DBUS_TEST_SERVICE_SUBSCRIBERS="1 2 4 8 16 32 64"
+DBUS_TEST_SERVICE_SIGNAL_COUNT=10000
+DBUS_TEST_SERVICE_SIGNAL_ARGS="--main-loop dispatch"
+DBUS_PING_MATCH_RULES="0 100 1000 5000 10000"
+DBUS_PING_MATCH_CONNECTIONS=4
+DBUS_PING_IDLE_CONNECTIONS="0 100 500 1000 5000"
+# TCP needs a daemon configuration that accepts an auth mechanism other than EXTERNAL
+DBUS_PING_CONNECT_ADDRESSES="unix:tmpdir=/tmp unix:abstract=/tmp/dbus-ping tcp:host=127.0.0.1,port=0"
+DBUS_PING_CONNECT_COUNT=1000
+DBUS_PING_ACTIVATION_COUNT=100
+DBUS_TEST_SERVICE_PROPERTIES="1 10 100 1000"
+DBUS_TEST_SERVICE_P2P_ADDRESS="unix:path=/tmp/dbus-test-service-$$"
+DBUS_PING_VERIFY_COUNT=1000
 
 LOG_FILE=dbus-genivi-benchmarking.log
 
@@ -21,6 +47,11 @@ log() {
 handle_sigint() {
    log "Interrupted by user request!"
 
+   if [ ! -z "${DBUS_TEST_SERVICE_PID}" ]; then
+     log "Killing dbus-test-service: ${DBUS_TEST_SERVICE_PID}"
+     kill -9 $DBUS_TEST_SERVICE_PID
+   fi
+
    if [ ! -z "${DBUS_SESSION_BUS_PID}" ]; then
      log "Killing dbus-daemon: ${DBUS_SESSION_BUS_PID}"
      kill -9 $DBUS_SESSION_BUS_PID
@@ -29,9 +60,34 @@ handle_sigint() {
    exit 1
 }
 
+start_test_service() {
+    local DBUS_TEST_SERVICE_ARGS="--bash $1"
+
+    log "Executing: ${DBUS_TEST_SERVICE} ${DBUS_TEST_SERVICE_ARGS}"
+    DBUS_STARTER_BUS_TYPE=session ${DBUS_TEST_SERVICE} ${DBUS_TEST_SERVICE_ARGS} > $DBUS_TEST_SERVICE_OUTPUT &
+    DBUS_TEST_SERVICE_PID=$!
+
+    # don't let the bus activate a second instance
+    while ! dbus-send --session --print-reply --dest=org.freedesktop.DBus / \
+            org.freedesktop.DBus.NameHasOwner string:com.bmw.Test | grep -q true; do
+        sleep 0.1
+    done
+}
+
+stop_test_service() {
+    kill -TERM $DBUS_TEST_SERVICE_PID
+    wait $DBUS_TEST_SERVICE_PID
+    DBUS_TEST_SERVICE_PID=
+
+    eval $(cat $DBUS_TEST_SERVICE_OUTPUT)
+    rm -f $DBUS_TEST_SERVICE_OUTPUT
+}
+
 run_ping_pong() {
     local DBUS_PING_ARGS=$1
     local DBUS_DAEMON_ARGS=$2
+    local DBUS_TEST_SERVICE_ARGS=$3
+    local DBUS_PING_CLIENTS=${4:-1}
 
     # start our own session bus
     DBUS_DAEMON_ARGS="--session --print-address=1 --print-pid=1 --fork ${DBUS_DAEMON_ARGS}"
@@ -49,9 +105,70 @@ run_ping_pong() {
     DBUS_SESSION_BUS_PID=$(echo ${DBUS_DAEMON_ADDRES_AND_PID_OUTPUT} | cut -d' ' -f2)
     log "DBUS_SESSION_BUS_PID=${DBUS_SESSION_BUS_PID}"
 
+    export DBUS_SESSION_BUS_ADDRESS DBUS_SESSION_BUS_PID
+    if [ ! -z "${DBUS_TEST_SERVICE_ARGS}" ]; then
+        start_test_service "${DBUS_TEST_SERVICE_ARGS}"
+    fi
+
     # start dbus-ping
     DBUS_PING_ARGS="--count $DBUS_PING_COUNT --destination com.bmw.Test --path /com/bmw/Test --bash ${DBUS_PING_ARGS}"
-    export DBUS_SESSION_BUS_ADDRESS
+    if [ $DBUS_PING_CLIENTS -eq 1 ]; then
+        log "Executing: ${DBUS_PING} ${DBUS_PING_ARGS}"
+        DBUS_PING_OUTPUT=$(${DBUS_PING} ${DBUS_PING_ARGS})
+
+        DBUS_PING_RET=$?
+        if [ $DBUS_PING_RET -eq 0 ]; then
+            eval $DBUS_PING_OUTPUT
+        fi
+    else
+        local CLIENT
+        local DBUS_PING_PIDS=
+        local DBUS_PING_TOTAL_MSGS_PER_SEC=0
+
+        log "Executing ${DBUS_PING_CLIENTS}x: dbus-ping ${DBUS_PING_ARGS}"
+        for CLIENT in $(seq $DBUS_PING_CLIENTS); do
+            dbus-ping ${DBUS_PING_ARGS} > dbus-ping-${CLIENT}.out &
+            DBUS_PING_PIDS="$DBUS_PING_PIDS $!"
+        done
+
+        DBUS_PING_RET=0
+        for CLIENT in $DBUS_PING_PIDS; do
+            wait $CLIENT || DBUS_PING_RET=$?
+        done
+
+        for CLIENT in $(seq $DBUS_PING_CLIENTS); do
+            eval $(cat dbus-ping-${CLIENT}.out)
+            DBUS_PING_TOTAL_MSGS_PER_SEC=$((DBUS_PING_TOTAL_MSGS_PER_SEC + DBUS_PING_MSGS_PER_SEC))
+            rm -f dbus-ping-${CLIENT}.out
+        done
+        DBUS_PING_MSGS_PER_SEC=$DBUS_PING_TOTAL_MSGS_PER_SEC
+    fi
+
+    # clean up
+    if [ ! -z "${DBUS_TEST_SERVICE_PID}" ]; then
+        stop_test_service
+    fi
+
+    kill -9 $DBUS_SESSION_BUS_PID
+
+    return $DBUS_PING_RET
+}
+
+# the same workload as run_ping_pong, but straight to the service without a bus daemon
+run_peer_to_peer() {
+    local DBUS_PING_ARGS=$1
+    local SOCKET_PATH=${DBUS_TEST_SERVICE_P2P_ADDRESS#unix:path=}
+
+    rm -f $SOCKET_PATH
+    log "Executing: ${DBUS_TEST_SERVICE} --bash --listen ${DBUS_TEST_SERVICE_P2P_ADDRESS}"
+    ${DBUS_TEST_SERVICE} --bash --listen ${DBUS_TEST_SERVICE_P2P_ADDRESS} > $DBUS_TEST_SERVICE_OUTPUT &
+    DBUS_TEST_SERVICE_PID=$!
+
+    while [ ! -S $SOCKET_PATH ]; do
+        sleep 0.1
+    done
+
+    DBUS_PING_ARGS="--count $DBUS_PING_COUNT --p2p --address ${DBUS_TEST_SERVICE_P2P_ADDRESS} --path /com/bmw/Test --bash ${DBUS_PING_ARGS}"
     log "Executing: dbus-ping ${DBUS_PING_ARGS}"
     DBUS_PING_OUTPUT=$(dbus-ping ${DBUS_PING_ARGS})
 
@@ -60,12 +177,24 @@ run_ping_pong() {
         eval $DBUS_PING_OUTPUT
     fi
 
-    # clean up
-    kill -9 $DBUS_SESSION_BUS_PID
+    stop_test_service
+    rm -f $SOCKET_PATH
 
     return $DBUS_PING_RET
 }
 
+# the same bytes echoed over a socketpair, the floor every D-Bus result is compared to
+run_raw_baseline() {
+    local DBUS_PING_ARGS="--count $DBUS_PING_COUNT --raw --path /com/bmw/Test --bash $1"
+
+    log "Executing: dbus-ping ${DBUS_PING_ARGS}"
+    DBUS_PING_RAW_OUTPUT=$(dbus-ping ${DBUS_PING_ARGS}) || return $?
+
+    # keep the D-Bus results of the case, only pick what is needed
+    RAW_SEND_TIME=$(eval $DBUS_PING_RAW_OUTPUT; echo $DBUS_PING_SEND_TIME)
+    RAW_LATENCY_P50=$(eval $DBUS_PING_RAW_OUTPUT; echo $DBUS_PING_LATENCY_P50)
+}
+
 
 run_benchmark_case() {
     local BENCHMARK_NAME=$1
@@ -87,27 +216,433 @@ run_benchmark_case() {
         log "Failed ${BENCHMARK_NAME}"
         return 1
     fi
- 
+
+    run_raw_baseline "${DBUS_PING_ARGS}"
+    if [ $? -ne 0 ]; then
+        log "Failed ${BENCHMARK_NAME} (raw baseline)"
+        return 1
+    fi
+
+    local RAW_MULTIPLE=$(awk "BEGIN { printf \"%.1f\", ($RAW_SEND_TIME > 0 ? $DBUS_PING_SEND_TIME / $RAW_SEND_TIME : 0) }")
+
     local BENCHMARK_RESULTS="msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
     BENCHMARK_RESULTS="$BENCHMARK_RESULTS creation_time=${DBUS_PING_DUPLICATE_TIME}"
     BENCHMARK_RESULTS="$BENCHMARK_RESULTS transport_time=${DBUS_PING_SEND_TIME}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p50=${DBUS_PING_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p99=${DBUS_PING_LATENCY_P99}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS raw_transport_time=${RAW_SEND_TIME}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS raw_latency_p50=${RAW_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS raw_multiple=${RAW_MULTIPLE}"
     log "Finished ${BENCHMARK_NAME}: ${BENCHMARK_RESULTS}"
 
     return 0
 }
 
+run_worker_scaling_case() {
+    local WORKERS=$1
+    local MAIN_LOOP=$2
+    local DBUS_PING_ARGS="$3 --contents-multiply 1000 ${DBUS_TEST_DATA}"
+    local DBUS_DAEMON_ARGS=$4
+
+    log "Starting workers: workers=${WORKERS} main_loop=${MAIN_LOOP} clients=${DBUS_TEST_SERVICE_CLIENTS}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}" "--workers ${WORKERS} --main-loop ${MAIN_LOOP}" $DBUS_TEST_SERVICE_CLIENTS
+    if [ $? -ne 0 ]; then
+        log "Failed workers"
+        return 1
+    fi
+
+    local BENCHMARK_RESULTS="msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS service_msgs_per_second=${DBUS_TEST_SERVICE_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS wakeups_per_msg=${DBUS_TEST_SERVICE_WAKEUPS_PER_MSG}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS syscalls_per_msg=${DBUS_TEST_SERVICE_SYSCALLS_PER_MSG}"
+    log "Finished workers: workers=${WORKERS} main_loop=${MAIN_LOOP} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_batching_case() {
+    local MAIN_LOOP=$1
+    local DBUS_PING_ARGS="$2 ${DBUS_TEST_DATA}"
+    local DBUS_DAEMON_ARGS=$3
+
+    log "Starting batching: main_loop=${MAIN_LOOP} clients=${DBUS_TEST_SERVICE_CLIENTS}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}" "--batch --main-loop ${MAIN_LOOP}" $DBUS_TEST_SERVICE_CLIENTS
+    if [ $? -ne 0 ]; then
+        log "Failed batching"
+        return 1
+    fi
+
+    local BENCHMARK_RESULTS="msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS service_msgs_per_second=${DBUS_TEST_SERVICE_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS replies_per_write=${DBUS_TEST_SERVICE_REPLIES_PER_WRITE}"
+    log "Finished batching: main_loop=${MAIN_LOOP} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_handler_cost_case() {
+    local CLIENTS=$1
+    local DBUS_PING_ARGS="$2 ${DBUS_TEST_DATA}"
+    local DBUS_DAEMON_ARGS=$3
+
+    log "Starting handler cost: cost=${DBUS_TEST_SERVICE_HANDLER_COST} clients=${CLIENTS}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}" "--handler-cost ${DBUS_TEST_SERVICE_HANDLER_COST}" $CLIENTS
+    if [ $? -ne 0 ]; then
+        log "Failed handler cost"
+        return 1
+    fi
+
+    # with several clients the latency is the one of the last client
+    local BENCHMARK_RESULTS="msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p50=${DBUS_PING_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p99=${DBUS_PING_LATENCY_P99}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS cost_time=${DBUS_TEST_SERVICE_GETECHO_COST_TIME}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS service_time=${DBUS_TEST_SERVICE_TIME}"
+    log "Finished handler cost: clients=${CLIENTS} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_signal_fanout_case() {
+    local SUBSCRIBERS=$1
+    local DBUS_PING_ARGS="$2 --subscribers ${SUBSCRIBERS} ${DBUS_TEST_DATA}"
+    local DBUS_DAEMON_ARGS=$3
+    local DBUS_PING_COUNT=$DBUS_TEST_SERVICE_SIGNAL_COUNT
+
+    log "Starting signal fan-out: subscribers=${SUBSCRIBERS} signals=${DBUS_PING_COUNT}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}" "${DBUS_TEST_SERVICE_SIGNAL_ARGS}"
+    if [ $? -ne 0 ]; then
+        log "Failed signal fan-out"
+        return 1
+    fi
+
+    local BENCHMARK_RESULTS="delivered_per_second=${DBUS_PING_DELIVERED_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS lost=${DBUS_PING_SIGNALS_LOST}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS emit_time=${DBUS_PING_EMIT_TIME}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p50=${DBUS_PING_SIGNAL_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p99=${DBUS_PING_SIGNAL_LATENCY_P99}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS skew_p50=${DBUS_PING_SIGNAL_SKEW_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS skew_p99=${DBUS_PING_SIGNAL_SKEW_P99}"
+    log "Finished signal fan-out: subscribers=${SUBSCRIBERS} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_match_rules_case() {
+    local MATCH_RULES=$1
+    local DBUS_PING_ARGS="$2 --match-rules ${MATCH_RULES} --match-connections ${DBUS_PING_MATCH_CONNECTIONS} ${DBUS_TEST_DATA}"
+    local DBUS_DAEMON_ARGS=$3
+
+    log "Starting match rules: rules=${MATCH_RULES} connections=${DBUS_PING_MATCH_CONNECTIONS}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}"
+    if [ $? -ne 0 ]; then
+        log "Failed match rules"
+        return 1
+    fi
+
+    local BENCHMARK_RESULTS="msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p50=${DBUS_PING_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p99=${DBUS_PING_LATENCY_P99}"
+    log "Finished match rules: rules=${MATCH_RULES} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_idle_connections_case() {
+    local IDLE_CONNECTIONS=$1
+    local DBUS_PING_ARGS="$2 --idle-connections ${IDLE_CONNECTIONS} --idle-names ${DBUS_TEST_DATA}"
+    local DBUS_DAEMON_ARGS=$3
+
+    log "Starting idle connections: connections=${IDLE_CONNECTIONS}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}"
+    if [ $? -ne 0 ]; then
+        log "Failed idle connections"
+        return 1
+    fi
+
+    local BENCHMARK_RESULTS="msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p99=${DBUS_PING_LATENCY_P99}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS daemon_rss=${DBUS_PING_DAEMON_RSS}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS rss_per_connection=${DBUS_PING_DAEMON_RSS_PER_CONNECTION}"
+    log "Finished idle connections: connections=${IDLE_CONNECTIONS} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_connect_case() {
+    local ADDRESS=$1
+    local DBUS_PING_ARGS="$2 --connect --connect-name"
+    local DBUS_DAEMON_ARGS="$3 --address=${ADDRESS}"
+    local DBUS_PING_COUNT=$DBUS_PING_CONNECT_COUNT
+
+    log "Starting connection setup: address=${ADDRESS} connections=${DBUS_PING_COUNT}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}"
+    if [ $? -ne 0 ]; then
+        log "Failed connection setup"
+        return 1
+    fi
+
+    local BENCHMARK_RESULTS="connects_per_second=${DBUS_PING_CONNECTS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS connect_p50=${DBUS_PING_SETUP_CONNECT_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS auth_p50=${DBUS_PING_SETUP_AUTH_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS hello_p50=${DBUS_PING_SETUP_HELLO_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS request_name_p50=${DBUS_PING_SETUP_REQUEST_NAME_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS close_p50=${DBUS_PING_SETUP_CLOSE_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS total_p99=${DBUS_PING_SETUP_TOTAL_P99}"
+    log "Finished connection setup: address=${ADDRESS} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_activation_case() {
+    local DBUS_PING_ARGS="$1 --activation"
+    local DBUS_DAEMON_ARGS=$2
+    local DBUS_PING_COUNT=$DBUS_PING_ACTIVATION_COUNT
+
+    # no test service of our own, the daemon activates the installed one
+    log "Starting activation: activations=${DBUS_PING_COUNT}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}"
+    if [ $? -ne 0 ]; then
+        log "Failed activation"
+        return 1
+    fi
+
+    local BENCHMARK_RESULTS="activation_p50=${DBUS_PING_ACTIVATION_ACTIVATION_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS startup_p50=${DBUS_PING_ACTIVATION_STARTUP_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS request_name_p50=${DBUS_PING_ACTIVATION_REQUEST_NAME_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS first_reply_p50=${DBUS_PING_ACTIVATION_FIRST_REPLY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS total_p50=${DBUS_PING_ACTIVATION_TOTAL_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS total_p99=${DBUS_PING_ACTIVATION_TOTAL_P99}"
+    log "Finished activation: ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+run_properties_case() {
+    local PROPERTIES=$1
+    local METHOD=$2
+    local DBUS_PING_ARGS="$3 --interface org.freedesktop.DBus.Properties --member ${METHOD} string:com.bmw.Test"
+    local DBUS_DAEMON_ARGS=$4
+
+    case "$METHOD" in
+    Get)  DBUS_PING_ARGS="$DBUS_PING_ARGS string:Property0" ;;
+    Set)  DBUS_PING_ARGS="$DBUS_PING_ARGS string:Property0 variant:int32:1" ;;
+    esac
+
+    log "Starting properties: properties=${PROPERTIES} method=${METHOD}"
+
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}" "--properties ${PROPERTIES}"
+    if [ $? -ne 0 ]; then
+        log "Failed properties"
+        return 1
+    fi
+
+    # what the service spends building the reply, the a{sv} of GetAll grows with the count
+    local SERVICE_PREFIX=DBUS_TEST_SERVICE_$(echo $METHOD | tr a-z A-Z)
+    local BUILD_TIME=$(eval echo \$${SERVICE_PREFIX}_BUILD_TIME)
+    local CALLS=$(eval echo \$${SERVICE_PREFIX}_CALLS)
+    local BUILD_PER_CALL=$(awk "BEGIN { printf \"%.2f\", $BUILD_TIME / $CALLS }")
+
+    local BENCHMARK_RESULTS="msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p50=${DBUS_PING_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS latency_p99=${DBUS_PING_LATENCY_P99}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS build_per_call=${BUILD_PER_CALL}"
+    log "Finished properties: properties=${PROPERTIES} method=${METHOD} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
+# one cell of the matrix, the client and the service come from DBUS_PING and DBUS_TEST_SERVICE
+run_matrix_pair() {
+    local DBUS_PING_ARGS=$1
+    local DBUS_DAEMON_ARGS=$2
+
+    local PREFIX=DBUS_PING
+
+    # GDBus is optional at build time
+    if ! command -v ${DBUS_PING} > /dev/null || [ ! -x ${DBUS_TEST_SERVICE} ]; then
+        log "Skipping matrix: client=${DBUS_PING} service=${DBUS_TEST_SERVICE} not installed"
+        return 2
+    fi
+
+    # all clients print the same summary, each under its own prefix
+    case "${DBUS_PING}" in
+    ${DBUS_PING_SYSTEMD})  PREFIX=DBUS_PING_SYSTEMD ;;
+    ${DBUS_PING_GDBUS})    PREFIX=DBUS_PING_GDBUS ;;
+    esac
+    unset ${PREFIX}_MSGS_PER_SEC ${PREFIX}_LATENCY_P50
+
+    # the sd-bus and GDBus services take no options, any argument just makes run_ping_pong start them
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}" "--main-loop dispatch" || return $?
+
+    PAIR_MSGS_PER_SEC=$(eval echo \$${PREFIX}_MSGS_PER_SEC)
+    PAIR_LATENCY_P50=$(eval echo \$${PREFIX}_LATENCY_P50)
+}
+
+# the same workload for every client x service pair of libdbus, sd-bus and GDBus
+run_matrix_case() {
+    local CONTENTS_MULTIPLY_COUNT=$1
+    local DBUS_PING_ARGS=$2
+    local DBUS_DAEMON_ARGS=$3
+    local DBUS_PING DBUS_TEST_SERVICE
+    local TABLE="client/service libdbus sd-bus gdbus"
+    local ROW
+
+    if [ $CONTENTS_MULTIPLY_COUNT -gt 0 ]; then
+        if [ $CONTENTS_MULTIPLY_COUNT -gt 1 ]; then
+            DBUS_PING_ARGS="$DBUS_PING_ARGS --contents-multiply $CONTENTS_MULTIPLY_COUNT"
+        fi
+        DBUS_PING_ARGS="$DBUS_PING_ARGS ${DBUS_TEST_DATA}"
+    fi
+
+    log "Starting matrix: contents_multiply_count=${CONTENTS_MULTIPLY_COUNT}"
+
+    for DBUS_PING in dbus-ping ${DBUS_PING_SYSTEMD} ${DBUS_PING_GDBUS}; do
+        ROW=$(basename ${DBUS_PING})
+
+        for DBUS_TEST_SERVICE in ${DBUS_TEST_SERVICE_LIBDBUS} ${DBUS_TEST_SERVICE_SYSTEMD} ${DBUS_TEST_SERVICE_GDBUS}; do
+            run_matrix_pair "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}"
+            case $? in
+            0)  log "Finished matrix: contents_multiply_count=${CONTENTS_MULTIPLY_COUNT}" \
+                    "client=$(basename ${DBUS_PING}) service=$(basename ${DBUS_TEST_SERVICE})" \
+                    "msgs_per_second=${PAIR_MSGS_PER_SEC} latency_p50=${PAIR_LATENCY_P50}" ;;
+            2)  PAIR_MSGS_PER_SEC=-
+                PAIR_LATENCY_P50=- ;;
+            *)  log "Failed matrix: client=${DBUS_PING} service=${DBUS_TEST_SERVICE}"
+                PAIR_MSGS_PER_SEC=-
+                PAIR_LATENCY_P50=- ;;
+            esac
+
+            ROW="$ROW ${PAIR_MSGS_PER_SEC}/${PAIR_LATENCY_P50}"
+        done
+
+        TABLE="$TABLE
+$ROW"
+    done
+
+    # msgs_per_second/latency_p50, a slow column points at the service library, a slow row at the client's
+    echo "$TABLE" | awk '{ printf "%-20s %-20s %-20s %-20s\n", $1, $2, $3, $4 }' | while read LINE; do
+        log "$LINE"
+    done
+
+    return 0
+}
+
+# every client x service pair echoes the CONTENTS back under --verify, dbus-ping fails on any difference
+run_verify_case() {
+    local NAME=$1
+    local CONTENTS=$2
+    local DBUS_PING_ARGS="$3 --verify $CONTENTS"
+    local DBUS_DAEMON_ARGS=$4
+    local DBUS_PING_COUNT=$DBUS_PING_VERIFY_COUNT
+    local DBUS_PING DBUS_TEST_SERVICE
+    local FAILED=0
+
+    log "Starting verify: contents=${NAME}"
+
+    for DBUS_PING in dbus-ping ${DBUS_PING_SYSTEMD} ${DBUS_PING_GDBUS}; do
+        for DBUS_TEST_SERVICE in ${DBUS_TEST_SERVICE_LIBDBUS} ${DBUS_TEST_SERVICE_SYSTEMD} ${DBUS_TEST_SERVICE_GDBUS}; do
+            run_matrix_pair "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}"
+            case $? in
+            0)  log "Finished verify: contents=${NAME}" \
+                    "client=$(basename ${DBUS_PING}) service=$(basename ${DBUS_TEST_SERVICE})" ;;
+            2)  ;;
+            *)  log "Failed verify: contents=${NAME} client=${DBUS_PING} service=${DBUS_TEST_SERVICE}"
+                FAILED=1 ;;
+            esac
+        done
+    done
+
+    return $FAILED
+}
+
+run_p2p_case() {
+    local CONTENTS_MULTIPLY_COUNT=$1
+    local DBUS_PING_ARGS=$2
+    local DBUS_DAEMON_ARGS=$3
+
+    if [ $CONTENTS_MULTIPLY_COUNT -gt 0 ]; then
+        if [ $CONTENTS_MULTIPLY_COUNT -gt 1 ]; then
+            DBUS_PING_ARGS="$DBUS_PING_ARGS --contents-multiply $CONTENTS_MULTIPLY_COUNT"
+        fi
+        DBUS_PING_ARGS="$DBUS_PING_ARGS ${DBUS_TEST_DATA}"
+    fi
+
+    log "Starting peer-to-peer: contents_multiply_count=${CONTENTS_MULTIPLY_COUNT}"
+
+    # the listening service always runs the epoll loop, so does the bus one
+    run_ping_pong "${DBUS_PING_ARGS}" "${DBUS_DAEMON_ARGS}" "--main-loop epoll"
+    if [ $? -ne 0 ]; then
+        log "Failed peer-to-peer (bus)"
+        return 1
+    fi
+
+    local BUS_MSGS_PER_SEC=$DBUS_PING_MSGS_PER_SEC
+    local BUS_SEND_TIME=$DBUS_PING_SEND_TIME
+    local BUS_LATENCY_P50=$DBUS_PING_LATENCY_P50
+
+    run_peer_to_peer "${DBUS_PING_ARGS}"
+    if [ $? -ne 0 ]; then
+        log "Failed peer-to-peer (p2p)"
+        return 1
+    fi
+
+    # what the daemon's extra hop costs every round trip
+    local DAEMON_OVERHEAD=$(awk "BEGIN { printf \"%.2f\", ($BUS_SEND_TIME - $DBUS_PING_SEND_TIME) / $DBUS_PING_SENT }")
+
+    local BENCHMARK_RESULTS="bus_msgs_per_second=${BUS_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS p2p_msgs_per_second=${DBUS_PING_MSGS_PER_SEC}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS bus_latency_p50=${BUS_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS p2p_latency_p50=${DBUS_PING_LATENCY_P50}"
+    BENCHMARK_RESULTS="$BENCHMARK_RESULTS daemon_overhead_per_msg=${DAEMON_OVERHEAD}"
+    log "Finished peer-to-peer: contents_multiply_count=${CONTENTS_MULTIPLY_COUNT} ${BENCHMARK_RESULTS}"
+
+    return 0
+}
+
 
 ### main
 
 DBUS_DAEMON_ARGS=
 DBUS_PING_ARGS=
+BENCHMARK_WORKERS=
+BENCHMARK_LOAD=
+BENCHMARK_SIGNALS=
+BENCHMARK_MATCH_RULES=
+BENCHMARK_IDLE=
+BENCHMARK_CONNECT=
+BENCHMARK_ACTIVATION=
+BENCHMARK_P2P=
+BENCHMARK_PROPERTIES=
+BENCHMARK_MATRIX=
+BENCHMARK_VERIFY=
 
 # parse command line options
-while getopts a:v o; do
+while getopts a:vwufmicApPMVs: o; do
     case "$o" in
     a)    DBUS_DAEMON_ARGS="$DBUS_DAEMON_ARGS --address $OPTARG" ;;
     v)    DBUS_PING_ARGS="$DBUS_PING_ARGS -v" ;;
-    [?])  echo "Usage: $0 [-v] [-a dbus-daemon-address]" 1>&2
+    w)    BENCHMARK_WORKERS=1 ;;
+    u)    BENCHMARK_LOAD=1 ;;
+    f)    BENCHMARK_SIGNALS=1 ;;
+    m)    BENCHMARK_MATCH_RULES=1 ;;
+    i)    BENCHMARK_IDLE=1 ;;
+    c)    BENCHMARK_CONNECT=1 ;;
+    A)    BENCHMARK_ACTIVATION=1 ;;
+    p)    BENCHMARK_P2P=1 ;;
+    P)    BENCHMARK_PROPERTIES=1 ;;
+    M)    BENCHMARK_MATRIX=1 ;;
+    V)    BENCHMARK_VERIFY=1 ;;
+    s)    DBUS_TEST_SERVICE=$OPTARG ;;
+    [?])  echo "Usage: $0 [-v] [-w] [-u] [-f] [-m] [-i] [-c] [-A] [-p] [-P] [-M] [-V] [-s dbus-test-service] [-a dbus-daemon-address]" 1>&2
           exit 1 ;;
     esac
 done
@@ -116,8 +651,99 @@ done
 trap handle_sigint INT
 
 # do benchmarking
+if [ ! -z "${BENCHMARK_WORKERS}" ]; then
+    for main_loop in $DBUS_TEST_SERVICE_MAIN_LOOPS; do
+        for workers in $DBUS_TEST_SERVICE_WORKERS; do
+            run_worker_scaling_case $workers $main_loop "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS"
+        done
+        run_batching_case $main_loop "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_LOAD}" ]; then
+    for clients in $DBUS_TEST_SERVICE_LOAD_CLIENTS; do
+        run_handler_cost_case $clients "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_SIGNALS}" ]; then
+    for subscribers in $DBUS_TEST_SERVICE_SUBSCRIBERS; do
+        run_signal_fanout_case $subscribers "$DBUS_PING_ARGS" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_MATCH_RULES}" ]; then
+    for match_rules in $DBUS_PING_MATCH_RULES; do
+        run_match_rules_case $match_rules "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_IDLE}" ]; then
+    for idle_connections in $DBUS_PING_IDLE_CONNECTIONS; do
+        run_idle_connections_case $idle_connections "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_CONNECT}" ]; then
+    for address in $DBUS_PING_CONNECT_ADDRESSES; do
+        run_connect_case $address "$DBUS_PING_ARGS" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_ACTIVATION}" ]; then
+    run_activation_case "$DBUS_PING_ARGS" "$DBUS_DAEMON_ARGS"
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_PROPERTIES}" ]; then
+    for properties in $DBUS_TEST_SERVICE_PROPERTIES; do
+        for method in Get GetAll Set; do
+            run_properties_case $properties $method "$DBUS_PING_ARGS" "$DBUS_DAEMON_ARGS"
+        done
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_MATRIX}" ]; then
+    DBUS_TEST_SERVICE_LIBDBUS=$DBUS_TEST_SERVICE
+    for test_data_multiply_count in $DBUS_TEST_DATA_MULTIPLY; do
+        run_matrix_case $test_data_multiply_count "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
+if [ ! -z "${BENCHMARK_VERIFY}" ]; then
+    DBUS_TEST_SERVICE_LIBDBUS=$DBUS_TEST_SERVICE
+    VERIFY_RET=0
+    run_verify_case "plain" "int32:7 double:12.6 string:XXXXXXXXXXXXXXXXXXXX" "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS" || VERIFY_RET=1
+    run_verify_case "array" "array:int32:1,2,3,4 array:string:a,bb,ccc" "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS" || VERIFY_RET=1
+    run_verify_case "struct" "${DBUS_TEST_DATA}" "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS" || VERIFY_RET=1
+    run_verify_case "variant" "variant:int32:7 variant:string:XXXX" "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS" || VERIFY_RET=1
+    # the template is copied, --clone rebuilds every message from the CONTENTS
+    run_verify_case "struct-clone" "${DBUS_TEST_DATA}" "$DBUS_PING_ARGS --member getEcho --clone" "$DBUS_DAEMON_ARGS" || VERIFY_RET=1
+    # the first call is echoed, every later one gets the cached reply back
+    run_verify_case "struct-last-reply" "${DBUS_TEST_DATA}" "$DBUS_PING_ARGS --member getLastReply" "$DBUS_DAEMON_ARGS" || VERIFY_RET=1
+    exit $VERIFY_RET
+fi
+
+if [ ! -z "${BENCHMARK_P2P}" ]; then
+    for test_data_multiply_count in $DBUS_TEST_DATA_MULTIPLY; do
+        run_p2p_case $test_data_multiply_count "$DBUS_PING_ARGS --member getEcho" "$DBUS_DAEMON_ARGS"
+    done
+    exit 0
+fi
+
 for test_data_multiply_count in $DBUS_TEST_DATA_MULTIPLY; do
     run_benchmark_case "clone" $test_data_multiply_count "$DBUS_PING_ARGS --member getEcho --clone" "$DBUS_DAEMON_ARGS"
     run_benchmark_case "copy" $test_data_multiply_count "$DBUS_PING_ARGS --member getLastReply" "$DBUS_DAEMON_ARGS"
+    run_benchmark_case "fast-echo" $test_data_multiply_count "$DBUS_PING_ARGS --member getFastEcho" "$DBUS_DAEMON_ARGS"
+    run_benchmark_case "cached" $test_data_multiply_count "$DBUS_PING_ARGS --member getCachedReply" "$DBUS_DAEMON_ARGS"
+    run_benchmark_case "preallocated" $test_data_multiply_count "$DBUS_PING_ARGS --member getLastReply --preallocate 1" "$DBUS_DAEMON_ARGS"
 done
 
@@ -0,0 +1,362 @@
+#!/usr/bin/env python
+#
+# dbus-ping-codegen.py D-Bus benchmarking tools typed marshaler generator
+#
+# Copyright (C) 2013 BMW AG
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+#
+# Reads a list of message signatures, one per line, and writes the C source
+# of a read, append and free function for each of them to stdout, see
+# src/dbus-ping-typed.h. Every function is straight line code for its
+# signature, the only loops left are the ones over array elements.
+#
+
+import sys
+
+BASIC_TYPES = {
+	'y': ('unsigned char', 'DBUS_TYPE_BYTE'),
+	'b': ('dbus_bool_t', 'DBUS_TYPE_BOOLEAN'),
+	'n': ('dbus_int16_t', 'DBUS_TYPE_INT16'),
+	'q': ('dbus_uint16_t', 'DBUS_TYPE_UINT16'),
+	'i': ('dbus_int32_t', 'DBUS_TYPE_INT32'),
+	'u': ('dbus_uint32_t', 'DBUS_TYPE_UINT32'),
+	'x': ('dbus_int64_t', 'DBUS_TYPE_INT64'),
+	't': ('dbus_uint64_t', 'DBUS_TYPE_UINT64'),
+	'd': ('double', 'DBUS_TYPE_DOUBLE'),
+	's': ('const char *', 'DBUS_TYPE_STRING'),
+	'o': ('const char *', 'DBUS_TYPE_OBJECT_PATH'),
+	'g': ('const char *', 'DBUS_TYPE_SIGNATURE'),
+}
+
+# arrays of these are read and appended as a whole
+FIXED_TYPES = 'ybnqiuxtd'
+
+# '(' and '{' can't be part of a C name
+MANGLE = { '(': 'r', ')': 'R', '{': 'e', '}': 'E' }
+
+
+class CodegenError(Exception):
+	pass
+
+
+class Type(object):
+	def __init__(self, code, children=()):
+		self.code = code
+		self.children = list(children)
+
+	def signature(self):
+		if self.code == 'a':
+			return 'a' + self.children[0].signature()
+		if self.code == 'r':
+			return '(' + ''.join(c.signature() for c in self.children) + ')'
+		if self.code == 'e':
+			return '{' + ''.join(c.signature() for c in self.children) + '}'
+		return self.code
+
+	def is_fixed_array(self):
+		return self.code == 'a' and self.children[0].code in FIXED_TYPES
+
+	def needs_free(self):
+		if self.code == 'a':
+			return not self.is_fixed_array()
+		return any(c.needs_free() for c in self.children)
+
+
+def parse_type(signature, pos, in_array=False):
+	if pos >= len(signature):
+		raise CodegenError('incomplete type')
+
+	code = signature[pos]
+
+	if code in BASIC_TYPES:
+		return Type(code), pos + 1
+
+	if code == 'a':
+		child, pos = parse_type(signature, pos + 1, True)
+		return Type('a', [child]), pos
+
+	if code == '(':
+		children = []
+		pos += 1
+		while pos < len(signature) and signature[pos] != ')':
+			child, pos = parse_type(signature, pos)
+			children.append(child)
+		if pos >= len(signature) or not children:
+			raise CodegenError('malformed struct')
+		return Type('r', children), pos + 1
+
+	if code == '{':
+		if not in_array:
+			raise CodegenError('dict entry outside of an array')
+		key, pos = parse_type(signature, pos + 1)
+		value, pos = parse_type(signature, pos)
+		if key.code not in BASIC_TYPES or pos >= len(signature) or signature[pos] != '}':
+			raise CodegenError('malformed dict entry')
+		return Type('e', [key, value]), pos + 1
+
+	# a variant's type is only known at runtime, which is what this avoids
+	raise CodegenError("unsupported type '%s'" % code)
+
+
+def parse_signature(signature):
+	types = []
+	pos = 0
+
+	while pos < len(signature):
+		t, pos = parse_type(signature, pos)
+		types.append(t)
+
+	if not types:
+		raise CodegenError('empty signature')
+
+	return types
+
+
+def mangle(signature):
+	return ''.join(MANGLE.get(c, c) for c in signature)
+
+
+class Function(object):
+	"""The body of a generated function and the iterators and counters it needs."""
+
+	def __init__(self):
+		self.lines = []
+		self.iters = set()
+		self.counters = set()
+
+	def emit(self, depth, line):
+		self.lines.append('\t' * depth + line)
+
+	def sub_iter(self, depth):
+		self.iters.add(depth)
+		return 'sub%d' % depth
+
+	def counter(self, depth):
+		self.counters.add(depth)
+		return 'i%d' % depth
+
+	def declarations(self):
+		lines = []
+		if self.iters:
+			lines.append('\tDBusMessageIter %s;' % ', '.join('sub%d' % d for d in sorted(self.iters)))
+		if self.counters:
+			lines.append('\tint %s;' % ', '.join('i%d' % d for d in sorted(self.counters)))
+		return lines
+
+
+def declare(t, name, indent, pointer=False):
+	"""The member declaration of a value of type t."""
+	tabs = '\t' * indent
+	star = '*' if pointer else ''
+
+	if t.code in BASIC_TYPES:
+		ctype = BASIC_TYPES[t.code][0]
+		return ['%s%s%s%s%s;' % (tabs, ctype, '' if ctype.endswith('*') else ' ', star, name)]
+
+	lines = [tabs + 'struct {']
+	if t.code == 'a':
+		lines.append(tabs + '\tint count;')
+		lines += declare(t.children[0], 'items', indent + 1, True)
+	else:
+		for i, child in enumerate(t.children):
+			lines += declare(child, 'f%d' % i, indent + 1)
+	lines.append('%s} %s%s;' % (tabs, star, name))
+
+	return lines
+
+
+def gen_read(f, t, value, it, level, depth):
+	if t.code in BASIC_TYPES:
+		f.emit(level, 'dbus_message_iter_get_basic(%s, &%s);' % (it, value))
+	else:
+		sub = f.sub_iter(depth)
+		f.emit(level, 'dbus_message_iter_recurse(%s, &%s);' % (it, sub))
+
+		if t.is_fixed_array():
+			f.emit(level, 'dbus_message_iter_get_fixed_array(&%s, &%s.items, &%s.count);' % (sub, value, value))
+		elif t.code == 'a':
+			i = f.counter(depth)
+			f.emit(level, '%s.count = count_elements(&%s);' % (value, sub))
+			f.emit(level, '%s.items = malloc(%s.count * sizeof(*%s.items));' % (value, value, value))
+			f.emit(level, 'assert_error(!%s.count || %s.items != NULL, "Unable to read message (out of memory)");'
+					% (value, value))
+			f.emit(level, 'for (%s = 0; %s < %s.count; %s++) {' % (i, i, value, i))
+			gen_read(f, t.children[0], '%s.items[%s]' % (value, i), '&' + sub, level + 1, depth + 1)
+			f.emit(level, '}')
+		else:
+			for n, child in enumerate(t.children):
+				gen_read(f, child, '%s.f%d' % (value, n), '&' + sub, level, depth + 1)
+
+	f.emit(level, 'dbus_message_iter_next(%s);' % it)
+
+
+def gen_append(f, t, value, it, level, depth):
+	if t.code in BASIC_TYPES:
+		f.emit(level, 'dbus_message_iter_append_basic(%s, %s, &%s);' % (it, BASIC_TYPES[t.code][1], value))
+		return
+
+	sub = f.sub_iter(depth)
+
+	if t.code == 'a':
+		element = t.children[0]
+		f.emit(level, 'dbus_message_iter_open_container(%s, DBUS_TYPE_ARRAY, "%s", &%s);'
+				% (it, element.signature(), sub))
+
+		if t.is_fixed_array():
+			f.emit(level, 'dbus_message_iter_append_fixed_array(&%s, %s, &%s.items, %s.count);'
+					% (sub, BASIC_TYPES[element.code][1], value, value))
+		else:
+			i = f.counter(depth)
+			f.emit(level, 'for (%s = 0; %s < %s.count; %s++) {' % (i, i, value, i))
+			gen_append(f, element, '%s.items[%s]' % (value, i), '&' + sub, level + 1, depth + 1)
+			f.emit(level, '}')
+	else:
+		container = 'DBUS_TYPE_STRUCT' if t.code == 'r' else 'DBUS_TYPE_DICT_ENTRY'
+		f.emit(level, 'dbus_message_iter_open_container(%s, %s, NULL, &%s);' % (it, container, sub))
+		for n, child in enumerate(t.children):
+			gen_append(f, child, '%s.f%d' % (value, n), '&' + sub, level, depth + 1)
+
+	f.emit(level, 'dbus_message_iter_close_container(%s, &%s);' % (it, sub))
+
+
+def gen_free(f, t, value, level, depth):
+	if not t.needs_free():
+		return
+
+	if t.code == 'a':
+		if t.children[0].needs_free():
+			i = f.counter(depth)
+			f.emit(level, 'for (%s = 0; %s < %s.count; %s++) {' % (i, i, value, i))
+			gen_free(f, t.children[0], '%s.items[%s]' % (value, i), level + 1, depth + 1)
+			f.emit(level, '}')
+		f.emit(level, 'free(%s.items);' % value)
+	else:
+		for n, child in enumerate(t.children):
+			gen_free(f, child, '%s.f%d' % (value, n), level, depth + 1)
+
+
+def gen_function(out, prototype, cast, f):
+	out.append(prototype + ' {')
+	if f.lines:
+		out.append(cast)
+		out += f.declarations()
+		out.append('')
+		out += f.lines
+	out.append('}')
+	out.append('')
+
+
+def generate(signatures, source):
+	out = [
+		'/* Generated by dbus-ping-codegen.py from %s, do not edit */' % source,
+		'#include "dbus-ping-typed.h"',
+		'#include "dbus-ping-common.h"',
+		'',
+		'#include <stdlib.h>',
+		'#include <string.h>',
+		'',
+		'',
+		'static int count_elements(DBusMessageIter *iter) {',
+		'\tDBusMessageIter count_iter = *iter;',
+		'\tint count = 0;',
+		'',
+		'\twhile (dbus_message_iter_get_arg_type(&count_iter) != DBUS_TYPE_INVALID) {',
+		'\t\tcount++;',
+		'\t\tdbus_message_iter_next(&count_iter);',
+		'\t}',
+		'',
+		'\treturn count;',
+		'}',
+		'',
+	]
+
+	for signature in signatures:
+		types = parse_signature(signature)
+		name = mangle(signature)
+
+		out.append('/* %s */' % signature)
+		out.append('struct typed_%s {' % name)
+		for n, t in enumerate(types):
+			out += declare(t, 'a%d' % n, 1)
+		out.append('};')
+		out.append('')
+
+		cast = '\tstruct typed_%s *value = data;' % name
+
+		f = Function()
+		for n, t in enumerate(types):
+			gen_read(f, t, 'value->a%d' % n, 'iter', 1, 0)
+		gen_function(out, 'static void read_%s(DBusMessageIter *iter, void *data)' % name, cast, f)
+
+		f = Function()
+		for n, t in enumerate(types):
+			gen_append(f, t, 'value->a%d' % n, 'iter', 1, 0)
+		gen_function(out, 'static void append_%s(DBusMessageIter *iter, const void *data)' % name,
+				'\tconst ' + cast[1:], f)
+
+		f = Function()
+		for n, t in enumerate(types):
+			gen_free(f, t, 'value->a%d' % n, 1, 0)
+		gen_function(out, 'static void free_%s(void *data)' % name, cast, f)
+
+	out.append('static const struct typed_marshaler typed_marshalers[] = {')
+	for signature in signatures:
+		name = mangle(signature)
+		out.append('\t{ "%s", sizeof(struct typed_%s), read_%s, append_%s, free_%s },'
+				% (signature, name, name, name, name))
+	out.append('};')
+	out.append('')
+	out += [
+		'const struct typed_marshaler *typed_marshaler_find(const char *signature) {',
+		'\tint i;',
+		'',
+		'\tfor (i = 0; i < sizeof(typed_marshalers) / sizeof(typed_marshalers[0]); i++)',
+		'\t\tif (!strcmp(typed_marshalers[i].signature, signature))',
+		'\t\t\treturn &typed_marshalers[i];',
+		'',
+		'\treturn NULL;',
+		'}',
+	]
+
+	return '\n'.join(out) + '\n'
+
+
+def main(argv):
+	if len(argv) != 2:
+		sys.stderr.write('Usage: %s SIGNATURE_LIST\n' % argv[0])
+		return 1
+
+	signatures = []
+	with open(argv[1]) as f:
+		for number, line in enumerate(f, 1):
+			line = line.split('#', 1)[0].strip()
+			if not line:
+				continue
+			try:
+				parse_signature(line)
+			except CodegenError as e:
+				sys.stderr.write('%s:%d: %s: %s\n' % (argv[1], number, line, e))
+				return 1
+			if line not in signatures:
+				signatures.append(line)
+
+	sys.stdout.write(generate(signatures, argv[1].split('/')[-1]))
+
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
@@ -0,0 +1,166 @@
+/*
+ *
+ * dbus-marshal-bench-systemd.c D-Bus marshaling microbenchmark
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libsystemd-bus/sd-bus.h>
+#include <libsystemd-bus/bus-message.h>
+#include <libsystemd-bus/bus-type.h>
+
+#include "dbus-marshal-bench.h"
+#include "dbus-ping-common.h"
+#include "dbus-ping-systemd-common.h"
+
+/* the messages are never sent, sealing only writes the header and makes them readable */
+#define BENCH_SERIAL	1
+
+
+struct systemd_bench {
+	const struct bench_case *bench_case;
+	sd_bus_message *template;
+};
+
+
+/* keeps the compiler from dropping the reads */
+static volatile uint64_t sink;
+
+
+static sd_bus_message *message_new_nocontents(void) {
+	sd_bus_message *message;
+	int r;
+
+	r = sd_bus_message_new_method_call(NULL, BENCH_DESTINATION, BENCH_PATH, BENCH_INTERFACE, BENCH_MEMBER, &message);
+	assert_error(r >= 0, "Unable to allocate message: %s", strerror(-r));
+
+	return message;
+}
+
+static sd_bus_message *message_new(const struct bench_case *bench_case) {
+	sd_bus_message *message = message_new_nocontents();
+
+	systemd_message_append_contents(message, (char **) bench_case->inputs, bench_case->inputs_num,
+			bench_case->multiply);
+
+	return message;
+}
+
+static void message_seal(sd_bus_message *message) {
+	int r = bus_message_seal(message, BENCH_SERIAL);
+
+	assert_error(r >= 0, "Unable to seal message: %s", strerror(-r));
+}
+
+static int read_contents(sd_bus_message *message) {
+	const char *contents;
+	char type;
+	int r;
+
+	for (;;) {
+		r = sd_bus_message_peek_type(message, &type, &contents);
+		if (r <= 0)
+			return r;
+
+		if (bus_type_is_container(type)) {
+			r = sd_bus_message_enter_container(message, type, contents);
+			if (r < 0)
+				return r;
+
+			r = read_contents(message);
+			if (r < 0)
+				return r;
+
+			r = sd_bus_message_exit_container(message);
+			if (r < 0)
+				return r;
+		} else {
+			union {
+				uint64_t u64;
+				const char *string;
+			} value = { 0 };
+
+			r = sd_bus_message_read_basic(message, type, &value);
+			if (r < 0)
+				return r;
+
+			sink ^= value.u64;
+		}
+	}
+}
+
+static void systemd_create(void *data) {
+	struct systemd_bench *bench = data;
+
+	sd_bus_message_unref(message_new(bench->bench_case));
+}
+
+static void systemd_seal(void *data) {
+	struct systemd_bench *bench = data;
+	sd_bus_message *message = message_new(bench->bench_case);
+
+	message_seal(message);
+	sd_bus_message_unref(message);
+}
+
+/* what dbus-ping-systemd does instead of a copy */
+static void systemd_copy(void *data) {
+	struct systemd_bench *bench = data;
+	sd_bus_message *message = message_new_nocontents();
+	int r;
+
+	r = sd_bus_message_rewind(bench->template, true);
+	assert_error(r >= 0, "Unable to rewind message: %s", strerror(-r));
+
+	r = systemd_message_copy_contents(message, bench->template);
+	assert_error(r >= 0, "Unable to copy message: %s", strerror(-r));
+
+	sd_bus_message_unref(message);
+}
+
+static void systemd_read(void *data) {
+	struct systemd_bench *bench = data;
+	int r;
+
+	r = sd_bus_message_rewind(bench->template, true);
+	assert_error(r >= 0, "Unable to rewind message: %s", strerror(-r));
+
+	r = read_contents(bench->template);
+	assert_error(r >= 0, "Unable to read message: %s", strerror(-r));
+}
+
+void systemd_bench_run(const struct bench_case *bench_case) {
+	struct systemd_bench bench = {
+		.bench_case = bench_case,
+		.template = message_new(bench_case),
+	};
+	size_t bytes;
+
+	message_seal(bench.template);
+	bytes = BUS_MESSAGE_SIZE(bench.template);
+
+	bench_run("sd-bus", "create", bench_case, bytes, systemd_create, &bench);
+	bench_run("sd-bus", "create+seal", bench_case, bytes, systemd_seal, &bench);
+	bench_run("sd-bus", "copy", bench_case, bytes, systemd_copy, &bench);
+	bench_run("sd-bus", "read", bench_case, bytes, systemd_read, &bench);
+
+	sd_bus_message_unref(bench.template);
+}
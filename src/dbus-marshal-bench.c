@@ -0,0 +1,501 @@
+/*
+ *
+ * dbus-marshal-bench.c D-Bus marshaling microbenchmark
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <getopt.h>
+
+#include <dbus/dbus.h>
+
+#include "dbus-marshal-bench.h"
+#include "dbus-marshal-validate.h"
+#include "dbus-ping-cmdline.h"
+#include "dbus-ping-common.h"
+#include "dbus-ping-libdbus.h"
+#include "dbus-ping-typed.h"
+
+#define DEFAULT_SPREAD			1.0
+#define DEFAULT_BATCH_TIME		10
+#define MIN_BATCHES				5
+#define MAX_BATCHES				200
+#define MAX_INPUT_SIZE			256
+
+#define NSEC_PER_SEC			1000000000ULL
+
+
+struct bench_options {
+	double spread;
+	int batch_time;
+	const char *library;
+};
+
+/* the libdbus side of a case, everything but the timed operation is set up once */
+struct libdbus_bench {
+	const struct bench_case *bench_case;
+	struct gengetopt_args_info args_info;
+	char *inputs[MAX_BENCH_INPUTS];
+	char buffers[MAX_BENCH_INPUTS][MAX_INPUT_SIZE];
+	DBusMessage *template;
+	char *data;
+	int length;
+	const struct typed_marshaler *marshaler;
+	void *typed_contents;
+};
+
+
+static struct bench_options options = {
+	.spread = DEFAULT_SPREAD,
+	.batch_time = DEFAULT_BATCH_TIME,
+};
+
+/* the CONTENTS of each signature, every one is run with each of the multipliers */
+static const struct bench_case signatures[] = {
+	{ { "int32:7" }, 1 },
+	{ { "string:The quick brown fox jumps over the lazy dog and runs away again" }, 1 },
+	{ { "array:int32:1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16" }, 1 },
+	{ { "dict:string:int32:one,1,two,2,three,3,four,4" }, 1 },
+	{ { "struct:int32:7:string:hello:double:1.5:boolean:true" }, 1 },
+	{ { "variant:string:hello" }, 1 },
+	{ { "int32:7", "string:hello", "array:byte:1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16" }, 3 },
+};
+
+static const int multipliers[] = { 1, 16, 256 };
+
+/* what a library checks on reading a message: the string of the script's (idds) and longer ones */
+static const struct validate_case {
+	const char *name;
+	const char *operation;
+	const char *pattern;
+	size_t length;
+} validate_cases[] = {
+	{ "s (idds)", "utf8", "XXXXXXXXXXXXXXXXXXXX", 20 },
+	{ "s ascii", "utf8", "The quick brown fox jumps over the lazy dog. ", 4096 },
+	{ "s utf-8", "utf8", "Gr\xc3\xbc\xc3\x9f" "e aus M\xc3\xbcnchen, \xe6\x9d\xb1\xe4\xba\xac\xe3\x81\xb8. ", 4096 },
+	{ "o /com/bmw/Test", "path", "/com/bmw/Test", 13 },
+	{ "o long", "path", "/com/bmw/Test/element_0123", 256 },
+	{ "g a(idds)", "signature", "a(idds)", 7 },
+};
+
+struct validate_bench {
+	int (*check)(const char *s, size_t length);
+	char *text;
+	size_t length;
+};
+
+/* keeps the compiler from dropping the reads of the iteration */
+static volatile uint64_t sink;
+
+
+static inline uint64_t now_nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static uint64_t run_batch(void (*op)(void *data), void *data, long int iterations) {
+	uint64_t time = now_nsec();
+	long int i;
+
+	for (i = 0; i < iterations; i++)
+		op(data);
+
+	return now_nsec() - time;
+}
+
+static int compare_double(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double median(const double *values, int count) {
+	double sorted[MAX_BATCHES];
+
+	memcpy(sorted, values, count * sizeof(values[0]));
+	qsort(sorted, count, sizeof(sorted[0]), compare_double);
+
+	return count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+/*
+ * The 95% confidence interval of the median in percent of it, from the
+ * median absolute deviation. Unlike the standard deviation it is hardly
+ * moved by the odd batch that got preempted.
+ */
+static double median_spread(const double *values, int count, double center) {
+	double deviations[MAX_BATCHES];
+	int i;
+
+	for (i = 0; i < count; i++)
+		deviations[i] = values[i] > center ? values[i] - center : center - values[i];
+
+	return 100.0 * 1.96 * 1.253 * 1.4826 * median(deviations, count) / sqrt(count) / center;
+}
+
+void bench_run(const char *stack, const char *operation, const struct bench_case *bench_case, size_t bytes,
+               void (*op)(void *data), void *data) {
+	const uint64_t batch_time = options.batch_time * (NSEC_PER_SEC / 1000);
+	double values[MAX_BATCHES], ns_per_op = 0, spread = 0;
+	long int iterations = 1;
+	int batches = 0;
+
+	/* doubles as warm up of the allocator and the caches */
+	while (run_batch(op, data, iterations) < batch_time)
+		iterations *= 2;
+
+	while (batches < MAX_BATCHES) {
+		values[batches++] = (double) run_batch(op, data, iterations) / iterations;
+
+		if (batches < MIN_BATCHES)
+			continue;
+
+		ns_per_op = median(values, batches);
+		spread = median_spread(values, batches, ns_per_op);
+
+		if (spread <= options.spread)
+			break;
+	}
+
+	printf("%-8s %-12s %-18s %-9d %-9zu %-12.1f %-14.0f %.2f%s\n",
+			stack, operation, bench_case->signature, bench_case->multiply, bytes,
+			ns_per_op, bytes * NSEC_PER_SEC / ns_per_op, spread,
+			spread > options.spread ? " (unstable)" : "");
+	fflush(stdout);
+}
+
+/* get_next_data_item() cuts the CONTENTS arguments apart, every build starts from a fresh copy */
+static void libdbus_reset_inputs(struct libdbus_bench *bench) {
+	int i;
+
+	for (i = 0; i < bench->bench_case->inputs_num; i++)
+		strcpy(bench->buffers[i], bench->bench_case->inputs[i]);
+}
+
+static void libdbus_create(void *data) {
+	struct libdbus_bench *bench = data;
+
+	libdbus_reset_inputs(bench);
+	dbus_message_unref(message_create(&bench->args_info));
+}
+
+static void libdbus_copy(void *data) {
+	struct libdbus_bench *bench = data;
+
+	dbus_message_unref(dbus_message_copy(bench->template));
+}
+
+static void libdbus_clone(void *data) {
+	struct libdbus_bench *bench = data;
+
+	dbus_message_unref(dbus_message_clone(&bench->args_info, bench->template));
+}
+
+/* the generated counterparts of clone and iterate, read back from typed_contents */
+static void libdbus_clone_typed(void *data) {
+	struct libdbus_bench *bench = data;
+	DBusMessage *clone = message_create_nocontents(&bench->args_info);
+	DBusMessageIter append_iter;
+
+	dbus_message_iter_init_append(clone, &append_iter);
+	bench->marshaler->append(&append_iter, bench->typed_contents);
+
+	dbus_message_unref(clone);
+}
+
+static void libdbus_read_typed(void *data) {
+	struct libdbus_bench *bench = data;
+	DBusMessageIter iter;
+
+	/* what the last read allocated, so that typed_contents stays valid */
+	bench->marshaler->free(bench->typed_contents);
+
+	dbus_message_iter_init(bench->template, &iter);
+	bench->marshaler->read(&iter, bench->typed_contents);
+}
+
+static void libdbus_marshal(void *data) {
+	struct libdbus_bench *bench = data;
+	char *marshaled;
+	int length;
+
+	assert_error(dbus_message_marshal(bench->template, &marshaled, &length), "Unable to marshal message (out of memory)");
+	dbus_free(marshaled);
+}
+
+static void libdbus_demarshal(void *data) {
+	struct libdbus_bench *bench = data;
+	DBusMessage *message;
+	DBusError error;
+
+	dbus_error_init(&error);
+
+	message = dbus_message_demarshal(bench->data, bench->length, &error);
+	assert_error(message != NULL, "Unable to demarshal message: %s", error.message);
+
+	dbus_message_unref(message);
+}
+
+static void iterate_args(DBusMessageIter *iter) {
+	int type;
+
+	while ((type = dbus_message_iter_get_arg_type(iter)) != DBUS_TYPE_INVALID) {
+		if (dbus_type_is_container(type)) {
+			DBusMessageIter subiter;
+
+			dbus_message_iter_recurse(iter, &subiter);
+			iterate_args(&subiter);
+		} else {
+			uint64_t value = 0;
+
+			dbus_message_iter_get_basic(iter, &value);
+			sink ^= value;
+		}
+
+		dbus_message_iter_next(iter);
+	}
+}
+
+static void libdbus_iterate(void *data) {
+	struct libdbus_bench *bench = data;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init(bench->template, &iter);
+	iterate_args(&iter);
+}
+
+/* the template is built from the CONTENTS once, it also names the signature of the case */
+static void libdbus_bench_init(struct libdbus_bench *bench, struct bench_case *bench_case) {
+	int i;
+
+	memset(bench, 0, sizeof(*bench));
+	bench->bench_case = bench_case;
+
+	cmdline_parser_init(&bench->args_info);
+	bench->args_info.destination_arg = BENCH_DESTINATION;
+	bench->args_info.path_arg = BENCH_PATH;
+	bench->args_info.interface_arg = BENCH_INTERFACE;
+	bench->args_info.member_arg = BENCH_MEMBER;
+	bench->args_info.contents_multiply_arg = bench_case->multiply;
+	bench->args_info.inputs = bench->inputs;
+	bench->args_info.inputs_num = bench_case->inputs_num;
+
+	for (i = 0; i < bench_case->inputs_num; i++) {
+		assert_error(strlen(bench_case->inputs[i]) < MAX_INPUT_SIZE, "Input '%s' too long", bench_case->inputs[i]);
+		bench->inputs[i] = bench->buffers[i];
+	}
+
+	libdbus_reset_inputs(bench);
+	bench->template = message_create(&bench->args_info);
+
+	/* demarshaling checks the header, which wants a serial */
+	dbus_message_set_serial(bench->template, 1);
+	assert_error(dbus_message_marshal(bench->template, &bench->data, &bench->length),
+			"Unable to marshal message (out of memory)");
+
+	snprintf(bench_case->signature, sizeof(bench_case->signature), "%s", dbus_message_get_signature(bench->template));
+
+	bench->marshaler = typed_marshaler_find(bench_case->signature);
+	if (bench->marshaler) {
+		DBusMessageIter iter;
+
+		bench->typed_contents = calloc(1, bench->marshaler->size);
+		assert_error(bench->typed_contents != NULL, "Unable to allocate message contents (out of memory)");
+
+		dbus_message_iter_init(bench->template, &iter);
+		bench->marshaler->read(&iter, bench->typed_contents);
+	}
+}
+
+static void libdbus_bench_free(struct libdbus_bench *bench) {
+	if (bench->marshaler) {
+		bench->marshaler->free(bench->typed_contents);
+		free(bench->typed_contents);
+	}
+
+	dbus_free(bench->data);
+	dbus_message_unref(bench->template);
+}
+
+static void validate(void *data) {
+	struct validate_bench *bench = data;
+
+	sink ^= bench->check(bench->text, bench->length);
+}
+
+/*
+ * The pattern repeated up to the case's length, only ever cut between two
+ * repetitions. Object path patterns join up through their leading slash.
+ */
+static void validate_bench_init(struct validate_bench *bench, const struct validate_case *validate_case,
+                                const struct validator *validator) {
+	size_t pattern_length = strlen(validate_case->pattern);
+
+	bench->text = malloc(validate_case->length + 1);
+	assert_error(bench->text != NULL, "Unable to allocate text (out of memory)");
+
+	for (bench->length = 0; bench->length + pattern_length <= validate_case->length; bench->length += pattern_length)
+		memcpy(bench->text + bench->length, validate_case->pattern, pattern_length);
+	bench->text[bench->length] = '\0';
+
+	if (!strcmp(validate_case->operation, "utf8"))
+		bench->check = validator->utf8;
+	else if (!strcmp(validate_case->operation, "path"))
+		bench->check = validator->object_path;
+	else
+		bench->check = validator->signature;
+
+	assert_error(bench->check(bench->text, bench->length), "%s rejects the %s case", validator->name,
+			validate_case->name);
+}
+
+static void validate_bench_run(void) {
+	int i, j;
+
+	for (i = 0; i < sizeof(validate_cases) / sizeof(validate_cases[0]); i++)
+		for (j = 0; validators[j]; j++) {
+			struct bench_case bench_case = { .multiply = 1 };
+			struct validate_bench bench;
+
+			if (!validators[j]->supported())
+				continue;
+
+			snprintf(bench_case.signature, sizeof(bench_case.signature), "%s", validate_cases[i].name);
+			validate_bench_init(&bench, &validate_cases[i], validators[j]);
+
+			bench_run(validators[j]->name, validate_cases[i].operation, &bench_case, bench.length, validate, &bench);
+
+			free(bench.text);
+		}
+}
+
+static void libdbus_bench_run(struct libdbus_bench *bench) {
+	const struct bench_case *bench_case = bench->bench_case;
+
+	bench_run("libdbus", "create", bench_case, bench->length, libdbus_create, bench);
+	bench_run("libdbus", "copy", bench_case, bench->length, libdbus_copy, bench);
+	bench_run("libdbus", "clone", bench_case, bench->length, libdbus_clone, bench);
+	if (bench->marshaler)
+		bench_run("libdbus", "clone-typed", bench_case, bench->length, libdbus_clone_typed, bench);
+	bench_run("libdbus", "marshal", bench_case, bench->length, libdbus_marshal, bench);
+	bench_run("libdbus", "demarshal", bench_case, bench->length, libdbus_demarshal, bench);
+	bench_run("libdbus", "iterate", bench_case, bench->length, libdbus_iterate, bench);
+	if (bench->marshaler)
+		bench_run("libdbus", "read-typed", bench_case, bench->length, libdbus_read_typed, bench);
+}
+
+static void usage(const char *name) {
+	printf("Usage: %s [OPTIONS]...\n\n"
+			"Times building, copying, marshaling and reading D-Bus messages of a matrix\n"
+			"of signatures and sizes, without any I/O.\n\n"
+			"  -h, --help           Print help and exit\n"
+			"  -l, --library=NAME   Only run the libdbus, the sd-bus or the string\n"
+			"                       validation (validate) cases\n"
+			"  -s, --spread=PERCENT Repeat batches until the median time per operation\n"
+			"                       is known within this much (default %.0f)\n"
+			"  -t, --batch-time=MSEC\n"
+			"                       Minimum duration of a batch (default %d)\n",
+			name, DEFAULT_SPREAD, DEFAULT_BATCH_TIME);
+}
+
+static void parse_options(int argc, char *argv[]) {
+	static const struct option long_options[] = {
+		{ "help",		0, NULL, 'h' },
+		{ "library",	1, NULL, 'l' },
+		{ "spread",		1, NULL, 's' },
+		{ "batch-time",	1, NULL, 't' },
+		{ NULL,			0, NULL, 0 }
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "hl:s:t:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+
+		case 'l':
+			assert_error(!strcmp(optarg, "libdbus") || !strcmp(optarg, "sd-bus") || !strcmp(optarg, "validate"),
+					"Invalid library '%s'", optarg);
+			options.library = optarg;
+			break;
+
+		case 's':
+			options.spread = atof(optarg);
+			assert_error(options.spread > 0, "Invalid spread '%s'", optarg);
+			break;
+
+		case 't':
+			options.batch_time = atoi(optarg);
+			assert_error(options.batch_time > 0, "Invalid batch time '%s'", optarg);
+			break;
+
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+}
+
+/* every signature with every multiplier */
+static void matrix_run(void) {
+	int i, j;
+
+	for (i = 0; i < sizeof(signatures) / sizeof(signatures[0]); i++)
+		for (j = 0; j < sizeof(multipliers) / sizeof(multipliers[0]); j++) {
+			struct bench_case bench_case = signatures[i];
+			struct libdbus_bench bench;
+
+			/* the repetitions go into an array, which takes a single complete type */
+			if (bench_case.inputs_num > 1 && multipliers[j] > 1)
+				continue;
+
+			bench_case.multiply = multipliers[j];
+			libdbus_bench_init(&bench, &bench_case);
+
+			if (!options.library || !strcmp(options.library, "libdbus"))
+				libdbus_bench_run(&bench);
+
+			if (!options.library || !strcmp(options.library, "sd-bus"))
+				systemd_bench_run(&bench_case);
+
+			libdbus_bench_free(&bench);
+		}
+}
+
+int main(int argc, char *argv[]) {
+	parse_options(argc, argv);
+
+	printf("library  operation    signature          multiply  bytes     ns/op        bytes/sec      +/- (%%)\n");
+
+	if (!options.library || strcmp(options.library, "validate"))
+		matrix_run();
+
+	if (!options.library || !strcmp(options.library, "validate"))
+		validate_bench_run();
+
+	return 0;
+}
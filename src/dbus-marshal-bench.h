@@ -0,0 +1,56 @@
+/*
+ *
+ * dbus-marshal-bench.h D-Bus marshaling microbenchmark
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_MARSHAL_BENCH_H_
+#define DBUS_MARSHAL_BENCH_H_
+
+#include <stddef.h>
+
+#define MAX_BENCH_INPUTS	4
+
+/* the method call every case is built into */
+#define BENCH_DESTINATION	"com.bmw.Test"
+#define BENCH_PATH			"/com/bmw/Test"
+#define BENCH_INTERFACE		"com.bmw.Test"
+#define BENCH_MEMBER		"getEcho"
+
+
+/* one cell of the matrix: dbus-ping CONTENTS arguments and their --contents-multiply */
+struct bench_case {
+	const char *inputs[MAX_BENCH_INPUTS];
+	int inputs_num;
+	int multiply;
+	char signature[64];
+};
+
+/*
+ * Times op in batches until the per-operation time of the last batches
+ * settles, then prints a row of the report. bytes is the size of the
+ * marshaled message the operation works on.
+ */
+void bench_run(const char *stack, const char *operation, const struct bench_case *bench_case, size_t bytes,
+               void (*op)(void *data), void *data);
+
+/* the sd-bus half of the matrix */
+void systemd_bench_run(const struct bench_case *bench_case);
+
+#endif /* DBUS_MARSHAL_BENCH_H_ */
@@ -0,0 +1,55 @@
+/*
+ *
+ * dbus-marshal-validate-systemd.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/*
+ * libsystemd-bus runs these checks on every string, object path and signature
+ * it reads or appends. The binaries that link it are linked with
+ * -Wl,--wrap=<name>, which sends the calls from the other objects of the
+ * library to __wrap_<name>, so they end up in dbus-marshal-validate.c.
+ */
+#include "dbus-marshal-validate.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+bool __real_signature_is_valid(const char *s, bool allow_dict_entry);
+
+char *__wrap_utf8_is_valid(const char *s);
+bool __wrap_object_path_is_valid(const char *p);
+bool __wrap_signature_is_valid(const char *s, bool allow_dict_entry);
+
+
+char *__wrap_utf8_is_valid(const char *s) {
+	return validator_get()->utf8(s, strlen(s)) ? (char *) s : NULL;
+}
+
+bool __wrap_object_path_is_valid(const char *p) {
+	return validator_get()->object_path(p, strlen(p));
+}
+
+/* a dict entry on its own is sd-bus' business, the validators only know complete types */
+bool __wrap_signature_is_valid(const char *s, bool allow_dict_entry) {
+	if (allow_dict_entry)
+		return __real_signature_is_valid(s, allow_dict_entry);
+
+	return validator_get()->signature(s, strlen(s));
+}
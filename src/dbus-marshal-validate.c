@@ -0,0 +1,504 @@
+/*
+ *
+ * dbus-marshal-validate.c D-Bus marshaling microbenchmark
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-marshal-validate.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_VALIDATORS	1
+#endif
+
+#define MAX_SIGNATURE_LENGTH	255
+#define MAX_NESTING				32
+
+
+/* the length of the UTF-8 sequence at p, 0 if it's invalid */
+static size_t utf8_sequence(const unsigned char *p, size_t left) {
+	unsigned char c = p[0];
+
+	if (c < 0x80)
+		return c != '\0';
+
+	/* continuation bytes and the overlong two byte forms */
+	if (c < 0xc2)
+		return 0;
+
+	if (c < 0xe0)
+		return left >= 2 && (p[1] & 0xc0) == 0x80 ? 2 : 0;
+
+	if (c < 0xf0) {
+		if (left < 3 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80)
+			return 0;
+
+		/* overlong, surrogates */
+		if ((c == 0xe0 && p[1] < 0xa0) || (c == 0xed && p[1] >= 0xa0))
+			return 0;
+
+		return 3;
+	}
+
+	if (c < 0xf5) {
+		if (left < 4 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80 || (p[3] & 0xc0) != 0x80)
+			return 0;
+
+		/* overlong, beyond U+10FFFF */
+		if ((c == 0xf0 && p[1] < 0x90) || (c == 0xf4 && p[1] >= 0x90))
+			return 0;
+
+		return 4;
+	}
+
+	return 0;
+}
+
+/* validates from i up to at least stop, returns where it ended or 0 on an invalid sequence */
+static inline size_t utf8_scalar_until(const unsigned char *p, size_t length, size_t i, size_t stop) {
+	while (i < stop) {
+		size_t n = utf8_sequence(p + i, length - i);
+
+		if (!n)
+			return 0;
+
+		i += n;
+	}
+
+	return i;
+}
+
+static int is_path_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/* the checks of the object path that don't depend on its middle */
+static int object_path_bounds(const char *s, size_t length) {
+	if (!length || s[0] != '/')
+		return 0;
+
+	return length == 1 || s[length - 1] != '/';
+}
+
+/* elements [A-Za-z0-9_]+ separated by single slashes, starting at i > 0 */
+static int object_path_scalar_from(const char *s, size_t length, size_t i) {
+	for (; i < length; i++) {
+		if (s[i] == '/') {
+			if (s[i - 1] == '/')
+				return 0;
+		} else if (!is_path_char(s[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int scalar_supported(void) {
+	return 1;
+}
+
+static int utf8_scalar(const char *s, size_t length) {
+	return !length || utf8_scalar_until((const unsigned char *) s, length, 0, length);
+}
+
+static int object_path_scalar(const char *s, size_t length) {
+	return object_path_bounds(s, length) && object_path_scalar_from(s, length, 1);
+}
+
+/* the length of the complete type at pos, 0 if it's invalid */
+static size_t signature_type(const char *s, size_t length, size_t pos, int arrays, int structs) {
+	size_t start = pos, n;
+
+	switch (s[pos]) {
+	case 'y': case 'b': case 'n': case 'q': case 'i': case 'u': case 'x': case 't':
+	case 'd': case 's': case 'o': case 'g': case 'h': case 'v':
+		return 1;
+
+	case 'a':
+		if (++arrays > MAX_NESTING || ++pos >= length)
+			return 0;
+
+		if (s[pos] != '{') {
+			n = signature_type(s, length, pos, arrays, structs);
+			return n ? n + 1 : 0;
+		}
+
+		/* a dict entry, only allowed as an array element and with a basic key */
+		if (++structs > MAX_NESTING || ++pos >= length || !strchr("ybnqiuxtdsogh", s[pos]) || s[pos] == '\0')
+			return 0;
+
+		if (++pos >= length || !(n = signature_type(s, length, pos, arrays, structs)))
+			return 0;
+
+		pos += n;
+		return pos < length && s[pos] == '}' ? pos + 1 - start : 0;
+
+	case '(':
+		if (++structs > MAX_NESTING || ++pos >= length || s[pos] == ')')
+			return 0;
+
+		while (pos < length && s[pos] != ')') {
+			if (!(n = signature_type(s, length, pos, arrays, structs)))
+				return 0;
+			pos += n;
+		}
+
+		return pos < length ? pos + 1 - start : 0;
+
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Signatures are at most 255 bytes and every byte decides how the next ones
+ * are parsed, so there is nothing to vectorize: all validators share this.
+ */
+static int signature_scalar(const char *s, size_t length) {
+	size_t pos = 0, n;
+
+	if (length > MAX_SIGNATURE_LENGTH)
+		return 0;
+
+	while (pos < length) {
+		if (!(n = signature_type(s, length, pos, 0, 0)))
+			return 0;
+		pos += n;
+	}
+
+	return 1;
+}
+
+static const struct validator validator_scalar = {
+	.name = "scalar",
+	.supported = scalar_supported,
+	.utf8 = utf8_scalar,
+	.object_path = object_path_scalar,
+	.signature = signature_scalar,
+};
+
+#ifdef HAVE_X86_VALIDATORS
+
+/*
+ * The lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less Than
+ * One Instruction Per Byte": the high and low nibble of every byte and the
+ * high nibble of the byte after it index three tables of error bits, a pair
+ * is invalid when all three agree on one of them. Sequences longer than two
+ * bytes are checked on the bytes two and three positions after the lead.
+ */
+#define TOO_SHORT		(1 << 0)	/* lead byte not followed by a continuation byte */
+#define TOO_LONG		(1 << 1)	/* continuation byte after ASCII */
+#define OVERLONG_3		(1 << 2)
+#define TOO_LARGE		(1 << 3)	/* beyond U+10FFFF */
+#define SURROGATE		(1 << 4)
+#define OVERLONG_2		(1 << 5)
+#define TOO_LARGE_1000	(1 << 6)
+#define OVERLONG_4		(1 << 6)
+#define TWO_CONTS		(1 << 7)	/* continuation byte after a continuation byte */
+#define CARRY			(TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/* by the high nibble of the first byte */
+static const unsigned char utf8_byte_1_high[16] = {
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+	TOO_SHORT | OVERLONG_2,
+	TOO_SHORT,
+	TOO_SHORT | OVERLONG_3 | SURROGATE,
+	TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+/* by the low nibble of the first byte */
+static const unsigned char utf8_byte_1_low[16] = {
+	CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+	CARRY | OVERLONG_2,
+	CARRY,
+	CARRY,
+	CARRY | TOO_LARGE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+/* by the high nibble of the second byte */
+static const unsigned char utf8_byte_2_high[16] = {
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+};
+
+/* the bytes subtracted from the end of a block, anything left means its last sequence goes on */
+static const unsigned char utf8_incomplete[32] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1,
+};
+
+/* the error bits of a block, previous is the block before it */
+__attribute__((target("ssse3")))
+static inline __m128i utf8_block_ssse3(__m128i block, __m128i previous) {
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	__m128i prev1 = _mm_alignr_epi8(block, previous, 15);
+	__m128i prev2 = _mm_alignr_epi8(block, previous, 14);
+	__m128i prev3 = _mm_alignr_epi8(block, previous, 13);
+	__m128i byte_1_high = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) utf8_byte_1_high),
+	                                       _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+	__m128i byte_1_low = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) utf8_byte_1_low),
+	                                      _mm_and_si128(prev1, nibble));
+	__m128i byte_2_high = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) utf8_byte_2_high),
+	                                       _mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+	__m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+	/* the sign bit is set where a three or four byte lead asks for a continuation byte */
+	__m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80));
+	__m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80));
+	__m128i continuation = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(0x80));
+
+	/* TWO_CONTS is what such a continuation byte looks like, the expected ones cancel out */
+	return _mm_xor_si128(special, continuation);
+}
+
+/* the tail is padded with spaces, a sequence cut off by the end then is too short */
+__attribute__((target("ssse3")))
+static int utf8_ssse3(const char *s, size_t length) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i incomplete_max = _mm_loadu_si128((const __m128i *) (utf8_incomplete + 16));
+	__m128i previous = zero, incomplete = zero, error = zero;
+	unsigned char tail[16];
+	size_t i = 0;
+
+	while (i < length) {
+		__m128i block;
+
+		if (i + 16 <= length)
+			block = _mm_loadu_si128((const __m128i *) (s + i));
+		else {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, s + i, length - i);
+			block = _mm_loadu_si128((const __m128i *) tail);
+		}
+
+		error = _mm_or_si128(error, _mm_cmpeq_epi8(block, zero));
+
+		/* the sign bits are the non-ASCII bytes */
+		if (_mm_movemask_epi8(block)) {
+			error = _mm_or_si128(error, utf8_block_ssse3(block, previous));
+			incomplete = _mm_subs_epu8(block, incomplete_max);
+		} else
+			error = _mm_or_si128(error, incomplete);
+
+		previous = block;
+		i += 16;
+	}
+
+	error = _mm_or_si128(error, incomplete);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) == 0xffff;
+}
+
+/* 0xff for every byte of [A-Za-z0-9_/], bytes above 0x7f are negative and fall out of all ranges */
+__attribute__((target("sse2")))
+static __m128i path_chars_sse2(__m128i block) {
+	__m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+	                              _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+	                              _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), block));
+	__m128i other = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('_')),
+	                             _mm_cmpeq_epi8(block, _mm_set1_epi8('/')));
+
+	return _mm_or_si128(_mm_or_si128(alpha, digit), other);
+}
+
+/* from i > 0 on, after object_path_bounds() */
+__attribute__((target("sse2")))
+static int object_path_sse2_from(const char *s, size_t length, size_t i) {
+	const __m128i slash = _mm_set1_epi8('/');
+
+	for (; i + 16 <= length; i += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i *) (s + i));
+		__m128i previous = _mm_loadu_si128((const __m128i *) (s + i - 1));
+		__m128i double_slash = _mm_and_si128(_mm_cmpeq_epi8(block, slash), _mm_cmpeq_epi8(previous, slash));
+
+		if (_mm_movemask_epi8(path_chars_sse2(block)) != 0xffff || _mm_movemask_epi8(double_slash))
+			return 0;
+	}
+
+	return object_path_scalar_from(s, length, i);
+}
+
+__attribute__((target("sse2")))
+static int object_path_sse2(const char *s, size_t length) {
+	return object_path_bounds(s, length) && object_path_sse2_from(s, length, 1);
+}
+
+static int ssse3_supported(void) {
+	return __builtin_cpu_supports("ssse3");
+}
+
+/* the object path only needs SSE2, the UTF-8 tables need PSHUFB */
+static const struct validator validator_ssse3 = {
+	.name = "ssse3",
+	.supported = ssse3_supported,
+	.utf8 = utf8_ssse3,
+	.object_path = object_path_sse2,
+	.signature = signature_scalar,
+};
+
+/* the same on 32 bytes, the bytes before each lane come from the lane before it */
+__attribute__((target("avx2")))
+static inline __m256i utf8_block_avx2(__m256i block, __m256i previous) {
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i shifted = _mm256_permute2x128_si256(previous, block, 0x21);
+	__m256i prev1 = _mm256_alignr_epi8(block, shifted, 15);
+	__m256i prev2 = _mm256_alignr_epi8(block, shifted, 14);
+	__m256i prev3 = _mm256_alignr_epi8(block, shifted, 13);
+	__m256i byte_1_high = _mm256_shuffle_epi8(
+			_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) utf8_byte_1_high)),
+			_mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+	__m256i byte_1_low = _mm256_shuffle_epi8(
+			_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) utf8_byte_1_low)),
+			_mm256_and_si256(prev1, nibble));
+	__m256i byte_2_high = _mm256_shuffle_epi8(
+			_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) utf8_byte_2_high)),
+			_mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+	__m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+	__m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80));
+	__m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80));
+	__m256i continuation = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(0x80));
+
+	return _mm256_xor_si256(special, continuation);
+}
+
+__attribute__((target("avx2")))
+static int utf8_avx2(const char *s, size_t length) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i incomplete_max = _mm256_loadu_si256((const __m256i *) utf8_incomplete);
+	__m256i previous = zero, incomplete = zero, error = zero;
+	unsigned char tail[32];
+	size_t i = 0;
+
+	while (i < length) {
+		__m256i block;
+
+		if (i + 32 <= length)
+			block = _mm256_loadu_si256((const __m256i *) (s + i));
+		else {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, s + i, length - i);
+			block = _mm256_loadu_si256((const __m256i *) tail);
+		}
+
+		error = _mm256_or_si256(error, _mm256_cmpeq_epi8(block, zero));
+
+		if (_mm256_movemask_epi8(block)) {
+			error = _mm256_or_si256(error, utf8_block_avx2(block, previous));
+			incomplete = _mm256_subs_epu8(block, incomplete_max);
+		} else
+			error = _mm256_or_si256(error, incomplete);
+
+		previous = block;
+		i += 32;
+	}
+
+	error = _mm256_or_si256(error, incomplete);
+
+	return _mm256_testz_si256(error, error);
+}
+
+__attribute__((target("avx2")))
+static __m256i path_chars_avx2(__m256i block) {
+	__m256i lower = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+	__m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+	                                 _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+	__m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)),
+	                                 _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+	__m256i other = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('_')),
+	                                _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/')));
+
+	return _mm256_or_si256(_mm256_or_si256(alpha, digit), other);
+}
+
+__attribute__((target("avx2")))
+static int object_path_avx2(const char *s, size_t length) {
+	const __m256i slash = _mm256_set1_epi8('/');
+	size_t i = 1;
+
+	if (!object_path_bounds(s, length))
+		return 0;
+
+	for (; i + 32 <= length; i += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i *) (s + i));
+		__m256i previous = _mm256_loadu_si256((const __m256i *) (s + i - 1));
+		__m256i double_slash = _mm256_and_si256(_mm256_cmpeq_epi8(block, slash),
+		                                        _mm256_cmpeq_epi8(previous, slash));
+
+		if (~_mm256_movemask_epi8(path_chars_avx2(block)) || _mm256_movemask_epi8(double_slash))
+			return 0;
+	}
+
+	_mm256_zeroupper();
+	return object_path_sse2_from(s, length, i);
+}
+
+static int avx2_supported(void) {
+	return __builtin_cpu_supports("avx2");
+}
+
+static const struct validator validator_avx2 = {
+	.name = "avx2",
+	.supported = avx2_supported,
+	.utf8 = utf8_avx2,
+	.object_path = object_path_avx2,
+	.signature = signature_scalar,
+};
+
+#endif /* HAVE_X86_VALIDATORS */
+
+const struct validator * const validators[] = {
+	&validator_scalar,
+#ifdef HAVE_X86_VALIDATORS
+	&validator_ssse3,
+	&validator_avx2,
+#endif
+	NULL
+};
+
+const struct validator *validator_get(void) {
+	static const struct validator *validator;
+	int i;
+
+	if (validator)
+		return validator;
+
+	for (i = 0; validators[i]; i++)
+		if (validators[i]->supported())
+			validator = validators[i];
+
+	return validator;
+}
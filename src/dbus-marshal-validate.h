@@ -0,0 +1,49 @@
+/*
+ *
+ * dbus-marshal-validate.h D-Bus marshaling microbenchmark
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_MARSHAL_VALIDATE_H_
+#define DBUS_MARSHAL_VALIDATE_H_
+
+#include <stddef.h>
+
+
+/*
+ * The checks a D-Bus library runs on every string, object path and
+ * signature it reads off the wire. They take the length from the message
+ * and return 1 when the value is valid. Strings must be UTF-8 without NUL
+ * bytes and without surrogates or overlong forms.
+ */
+struct validator {
+	const char *name;
+	int (*supported)(void);
+	int (*utf8)(const char *s, size_t length);
+	int (*object_path)(const char *s, size_t length);
+	int (*signature)(const char *s, size_t length);
+};
+
+/* the scalar one first, NULL terminated; skip the ones this CPU doesn't support */
+extern const struct validator * const validators[];
+
+/* the fastest one this CPU supports, picked on the first call */
+const struct validator *validator_get(void);
+
+#endif /* DBUS_MARSHAL_VALIDATE_H_ */
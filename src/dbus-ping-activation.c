@@ -0,0 +1,217 @@
+/*
+ *
+ * dbus-ping-activation.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-ping-activation.h"
+#include "dbus-ping-common.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SERVICE_POLL_INTERVAL	(1 * USEC_PER_MSEC)
+
+
+enum activation_stage {
+	STAGE_ACTIVATION,		/* call sent until the service's main() */
+	STAGE_STARTUP,			/* main() until connected to the bus */
+	STAGE_REQUEST_NAME,		/* connected until the name is acquired */
+	STAGE_FIRST_REPLY,		/* name acquired until the reply arrived */
+	STAGE_TOTAL,
+	STAGE_COUNT,
+};
+
+static const char *stage_names[] = {
+	[STAGE_ACTIVATION] = "activation",
+	[STAGE_STARTUP] = "startup",
+	[STAGE_REQUEST_NAME] = "request_name",
+	[STAGE_FIRST_REPLY] = "first_reply",
+	[STAGE_TOTAL] = "total",
+};
+
+static struct histogram stage_latency[STAGE_COUNT];
+
+
+static pid_t get_connection_pid(DBusConnection *connection, const char *name) {
+	DBusMessage *message, *reply;
+	dbus_uint32_t pid = 0;
+
+	message = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS,
+	                                       "GetConnectionUnixProcessID");
+	assert_error(message != NULL, "Unable to allocate message (out of memory)");
+	dbus_message_append_args(message, DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID);
+
+	reply = dbus_connection_send_with_reply_and_block(connection, message, -1, NULL);
+	dbus_message_unref(message);
+
+	if (reply) {
+		dbus_message_get_args(reply, NULL, DBUS_TYPE_UINT32, &pid, DBUS_TYPE_INVALID);
+		dbus_message_unref(reply);
+	}
+
+	return pid;
+}
+
+static void sleep_for(usec_t duration) {
+	struct timespec ts = {
+		.tv_sec = duration / USEC_PER_SEC,
+		.tv_nsec = (duration % USEC_PER_SEC) * NSEC_PER_USEC,
+	};
+
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+}
+
+/* the next call has to find the name unowned, or nothing gets activated */
+static void stop_service(DBusConnection *connection, const struct gengetopt_args_info *args_info) {
+	const char *name = args_info->destination_arg;
+	usec_t deadline = time_now(CLOCK_MONOTONIC) + args_info->activation_timeout_arg * USEC_PER_MSEC;
+	int killed = 0;
+	DBusError error;
+
+	dbus_error_init(&error);
+
+	while (dbus_bus_name_has_owner(connection, name, &error)) {
+		if (!killed) {
+			pid_t pid = get_connection_pid(connection, name);
+
+			assert_error(pid > 0, "Unable to get the process of '%s'", name);
+			assert_error(kill(pid, SIGTERM) == 0 || errno == ESRCH, "Unable to stop '%s' (pid %d): %s",
+					name, (int) pid, strerror(errno));
+			killed = 1;
+		}
+
+		assert_error(time_now(CLOCK_MONOTONIC) < deadline, "'%s' did not exit in time", name);
+		sleep_for(SERVICE_POLL_INTERVAL);
+	}
+
+	assert_error(!dbus_error_is_set(&error), "Unable to look up '%s': %s", name, error.message);
+}
+
+static int activation_cycle(DBusConnection *connection, const struct gengetopt_args_info *args_info) {
+	dbus_uint64_t service_main, connected, name_acquired;
+	usec_t send_time, reply_time;
+	DBusMessage *message, *reply;
+	DBusError error;
+
+	stop_service(connection, args_info);
+
+	message = dbus_message_new_method_call(args_info->destination_arg, args_info->path_arg,
+	                                       args_info->interface_arg, STARTUP_TIMES_MEMBER);
+	assert_error(message != NULL, "Unable to allocate message (out of memory)");
+	dbus_message_set_auto_start(message, TRUE);
+	dbus_error_init(&error);
+
+	send_time = time_now(CLOCK_MONOTONIC);
+	reply = dbus_connection_send_with_reply_and_block(connection, message, args_info->reply_timeout_arg, &error);
+	reply_time = time_now(CLOCK_MONOTONIC);
+	dbus_message_unref(message);
+
+	if (!reply ||
+	    !dbus_message_get_args(reply, &error, DBUS_TYPE_UINT64, &service_main, DBUS_TYPE_UINT64, &connected,
+	                           DBUS_TYPE_UINT64, &name_acquired, DBUS_TYPE_INVALID)) {
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Activation error %s: %s\n", error.name, error.message);
+		dbus_error_free(&error);
+		if (reply)
+			dbus_message_unref(reply);
+		return 0;
+	}
+	dbus_message_unref(reply);
+
+	/* an instance that was not started for our call */
+	if (service_main < send_time || name_acquired > reply_time) {
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": '%s' was not activated by the call\n",
+				args_info->destination_arg);
+		return 0;
+	}
+
+	histogram_add(&stage_latency[STAGE_ACTIVATION], service_main - send_time);
+	histogram_add(&stage_latency[STAGE_STARTUP], connected - service_main);
+	histogram_add(&stage_latency[STAGE_REQUEST_NAME], name_acquired - connected);
+	histogram_add(&stage_latency[STAGE_FIRST_REPLY], reply_time - name_acquired);
+	histogram_add(&stage_latency[STAGE_TOTAL], reply_time - send_time);
+
+	return 1;
+}
+
+static void show_summary(long activations, long failures, const struct gengetopt_args_info *args_info) {
+	FILE *out = args_info->bash_given ? stderr : stdout;
+	int i;
+
+	if (args_info->bash_given) {
+		printf("DBUS_PING_ACTIVATIONS=%ld;\n"
+				"DBUS_PING_ACTIVATION_FAILURES=%ld;\n",
+				activations, failures);
+
+		for (i = 0; i < STAGE_COUNT; i++) {
+			char name[32];
+			int j;
+
+			for (j = 0; stage_names[i][j] && j < sizeof(name) - 1; j++)
+				name[j] = toupper(stage_names[i][j]);
+			name[j] = '\0';
+
+			printf("DBUS_PING_ACTIVATION_%s_P50=%llu;\n"
+					"DBUS_PING_ACTIVATION_%s_P99=%llu;\n"
+					"DBUS_PING_ACTIVATION_%s_MAX=%llu;\n",
+					name, (unsigned long long) histogram_percentile(&stage_latency[i], 50.0),
+					name, (unsigned long long) histogram_percentile(&stage_latency[i], 99.0),
+					name, (unsigned long long) stage_latency[i].max);
+		}
+	}
+
+	if (!args_info->bash_given || args_info->verbose_given) {
+		fprintf(out,
+				"activations  failures\n"
+				"%-12ld %ld\n",
+				activations, failures);
+
+		fprintf(out, "stage         p50          p90          p99          max (usec)\n");
+		for (i = 0; i < STAGE_COUNT; i++)
+			fprintf(out, "%-13s %-12llu %-12llu %-12llu %llu\n",
+					stage_names[i],
+					(unsigned long long) histogram_percentile(&stage_latency[i], 50.0),
+					(unsigned long long) histogram_percentile(&stage_latency[i], 90.0),
+					(unsigned long long) histogram_percentile(&stage_latency[i], 99.0),
+					(unsigned long long) stage_latency[i].max);
+	}
+
+	fflush(stdout);
+}
+
+int run_activation_cycles(DBusConnection *connection, const struct gengetopt_args_info *args_info) {
+	long cycle, activations = 0;
+
+	assert_error(args_info->destination_given, "'--destination' ('-d') option required for activation");
+
+	for (cycle = 0; cycle < args_info->count_arg; cycle++)
+		activations += activation_cycle(connection, args_info);
+
+	/* don't leave an instance behind that the next benchmark would talk to */
+	stop_service(connection, args_info);
+
+	show_summary(activations, args_info->count_arg - activations, args_info);
+
+	return activations == args_info->count_arg ? 0 : -1;
+}
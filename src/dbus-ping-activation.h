@@ -0,0 +1,40 @@
+/*
+ *
+ * dbus-ping-activation.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_ACTIVATION_H_
+#define DBUS_PING_ACTIVATION_H_
+
+#include <dbus/dbus.h>
+
+#include "dbus-ping-cmdline.h"
+
+#define STARTUP_TIMES_MEMBER	"getStartupTimes"
+
+
+/*
+ * Stops the --destination service if it is running, has the daemon activate
+ * it with a getStartupTimes call and breaks the time until the reply down
+ * into the activation stages, --count times.
+ */
+int run_activation_cycles(DBusConnection *connection, const struct gengetopt_args_info *args_info);
+
+#endif /* DBUS_PING_ACTIVATION_H_ */
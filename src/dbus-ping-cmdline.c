@@ -40,17 +40,38 @@ const char *gengetopt_args_info_help[] = {
   "      --session                 send to the session message bus",
   "      --system                  send to the system message bus",
   "  -a, --address=ADDRESS         specify the address of the message bus",
+  "      --p2p                     talk to the peer at --address directly, without \n                                  a bus daemon",
+  "      --backend=NAME            D-Bus library to send with, the -systemd and \n                                  -gdbus builds default to theirs  (possible \n                                  values=\"libdbus\", \"sd-bus\", \"gdbus\")",
   "\nMessage:",
   "  -t, --type=STRING             message type  (possible values=\"method_call\", \n                                  \"signal\" default=`method_call')",
   "  -d, --destination=BUS_NAME    bus name of the destination",
   "  -p, --path=OBJECT_PATH        target object's path (mandatory)",
   "  -i, --interface=NAME          interface of the target object",
-  "  -m, --member=NAME             member of the target object (mandatory)",
+  "  -m, --member=NAME             member of the target object (mandatory for \n                                  sending)",
   "  -x, --contents-multiply=COUNT append message contents clone  (default=`0')",
   "\nSend:",
   "  -c, --count=LONGLONG          number of times the message will be sent  \n                                  (default=`1')",
   "      --clone                   intensively rebuild the message before sending \n                                  (default is copy)",
+  "      --generic-marshal         clone through the generic type switch even if a \n                                  generated marshaler fits the CONTENTS",
   "      --reply-timeout=MSEC      reply message timeout  (default=`-1')",
+  "      --window=COUNT            keep COUNT asynchronous calls in flight  \n                                  (default=`1')",
+  "      --preallocate=COUNT       send through a pool of COUNT preallocated send \n                                  resources  (default=`0')",
+  "      --match-rules=COUNT       install COUNT match rules the messages never \n                                  match before sending  (default=`0')",
+  "      --match-connections=COUNT spread the match rules over COUNT extra \n                                  connections  (default=`1')",
+  "      --idle-connections=COUNT  keep COUNT idle connections to the bus open \n                                  while sending  (default=`0')",
+  "      --idle-names              let every idle connection own a well-known name",
+  "      --verify                  check that every reply echoes the message sent, \n                                  the summary shows what that cost",
+  "\nBaseline:",
+  "      --raw                     echo the marshaled message over a socketpair to \n                                  a forked peer, no D-Bus involved",
+  "\nConnection setup:",
+  "      --connect                 open and close --count private connections \n                                  instead of sending",
+  "      --connect-name            request a well-known name on every connection",
+  "\nActivation:",
+  "      --activation              have the destination activated --count times, \n                                  stopping it in between",
+  "      --activation-timeout=MSEC how long to wait for the running service to \n                                  exit  (default=`5000')",
+  "\nSignals:",
+  "      --subscribers=COUNT       let the service emit COUNT signals to this many \n                                  subscriber connections  (default=`0')",
+  "      --signal-rate=RATE        signals per second emitted by the service (0 is \n                                  unlimited)  (default=`0')",
     0
 };
 
@@ -72,6 +93,7 @@ cmdline_parser_internal (int argc, char **argv, struct gengetopt_args_info *args
 static int
 cmdline_parser_required2 (struct gengetopt_args_info *args_info, const char *prog_name, const char *additional_error);
 
+const char *cmdline_parser_backend_values[] = {"libdbus", "sd-bus", "gdbus", 0}; /*< Possible values for backend. */
 const char *cmdline_parser_type_values[] = {"method_call", "signal", 0}; /*< Possible values for type. */
 
 static char *
@@ -87,6 +109,8 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->session_given = 0 ;
   args_info->system_given = 0 ;
   args_info->address_given = 0 ;
+  args_info->p2p_given = 0 ;
+  args_info->backend_given = 0 ;
   args_info->type_given = 0 ;
   args_info->destination_given = 0 ;
   args_info->path_given = 0 ;
@@ -95,7 +119,22 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->contents_multiply_given = 0 ;
   args_info->count_given = 0 ;
   args_info->clone_given = 0 ;
+  args_info->generic_marshal_given = 0 ;
   args_info->reply_timeout_given = 0 ;
+  args_info->window_given = 0 ;
+  args_info->preallocate_given = 0 ;
+  args_info->match_rules_given = 0 ;
+  args_info->match_connections_given = 0 ;
+  args_info->idle_connections_given = 0 ;
+  args_info->idle_names_given = 0 ;
+  args_info->verify_given = 0 ;
+  args_info->raw_given = 0 ;
+  args_info->connect_given = 0 ;
+  args_info->connect_name_given = 0 ;
+  args_info->activation_given = 0 ;
+  args_info->activation_timeout_given = 0 ;
+  args_info->subscribers_given = 0 ;
+  args_info->signal_rate_given = 0 ;
   args_info->Connection_group_counter = 0 ;
 }
 
@@ -105,6 +144,8 @@ void clear_args (struct gengetopt_args_info *args_info)
   FIX_UNUSED (args_info);
   args_info->address_arg = NULL;
   args_info->address_orig = NULL;
+  args_info->backend_arg = NULL;
+  args_info->backend_orig = NULL;
   args_info->type_arg = gengetopt_strdup ("method_call");
   args_info->type_orig = NULL;
   args_info->destination_arg = NULL;
@@ -121,6 +162,22 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->count_orig = NULL;
   args_info->reply_timeout_arg = -1;
   args_info->reply_timeout_orig = NULL;
+  args_info->window_arg = 1;
+  args_info->window_orig = NULL;
+  args_info->preallocate_arg = 0;
+  args_info->preallocate_orig = NULL;
+  args_info->match_rules_arg = 0;
+  args_info->match_rules_orig = NULL;
+  args_info->match_connections_arg = 1;
+  args_info->match_connections_orig = NULL;
+  args_info->idle_connections_arg = 0;
+  args_info->idle_connections_orig = NULL;
+  args_info->activation_timeout_arg = 5000;
+  args_info->activation_timeout_orig = NULL;
+  args_info->subscribers_arg = 0;
+  args_info->subscribers_orig = NULL;
+  args_info->signal_rate_arg = 0;
+  args_info->signal_rate_orig = NULL;
   
 }
 
@@ -136,15 +193,32 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->session_help = gengetopt_args_info_help[5] ;
   args_info->system_help = gengetopt_args_info_help[6] ;
   args_info->address_help = gengetopt_args_info_help[7] ;
-  args_info->type_help = gengetopt_args_info_help[9] ;
-  args_info->destination_help = gengetopt_args_info_help[10] ;
-  args_info->path_help = gengetopt_args_info_help[11] ;
-  args_info->interface_help = gengetopt_args_info_help[12] ;
-  args_info->member_help = gengetopt_args_info_help[13] ;
-  args_info->contents_multiply_help = gengetopt_args_info_help[14] ;
-  args_info->count_help = gengetopt_args_info_help[16] ;
-  args_info->clone_help = gengetopt_args_info_help[17] ;
-  args_info->reply_timeout_help = gengetopt_args_info_help[18] ;
+  args_info->p2p_help = gengetopt_args_info_help[8] ;
+  args_info->backend_help = gengetopt_args_info_help[9] ;
+  args_info->type_help = gengetopt_args_info_help[11] ;
+  args_info->destination_help = gengetopt_args_info_help[12] ;
+  args_info->path_help = gengetopt_args_info_help[13] ;
+  args_info->interface_help = gengetopt_args_info_help[14] ;
+  args_info->member_help = gengetopt_args_info_help[15] ;
+  args_info->contents_multiply_help = gengetopt_args_info_help[16] ;
+  args_info->count_help = gengetopt_args_info_help[18] ;
+  args_info->clone_help = gengetopt_args_info_help[19] ;
+  args_info->generic_marshal_help = gengetopt_args_info_help[20] ;
+  args_info->reply_timeout_help = gengetopt_args_info_help[21] ;
+  args_info->window_help = gengetopt_args_info_help[22] ;
+  args_info->preallocate_help = gengetopt_args_info_help[23] ;
+  args_info->match_rules_help = gengetopt_args_info_help[24] ;
+  args_info->match_connections_help = gengetopt_args_info_help[25] ;
+  args_info->idle_connections_help = gengetopt_args_info_help[26] ;
+  args_info->idle_names_help = gengetopt_args_info_help[27] ;
+  args_info->verify_help = gengetopt_args_info_help[28] ;
+  args_info->raw_help = gengetopt_args_info_help[30] ;
+  args_info->connect_help = gengetopt_args_info_help[32] ;
+  args_info->connect_name_help = gengetopt_args_info_help[33] ;
+  args_info->activation_help = gengetopt_args_info_help[35] ;
+  args_info->activation_timeout_help = gengetopt_args_info_help[36] ;
+  args_info->subscribers_help = gengetopt_args_info_help[38] ;
+  args_info->signal_rate_help = gengetopt_args_info_help[39] ;
   
 }
 
@@ -230,6 +304,8 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   unsigned int i;
   free_string_field (&(args_info->address_arg));
   free_string_field (&(args_info->address_orig));
+  free_string_field (&(args_info->backend_arg));
+  free_string_field (&(args_info->backend_orig));
   free_string_field (&(args_info->type_arg));
   free_string_field (&(args_info->type_orig));
   free_string_field (&(args_info->destination_arg));
@@ -243,6 +319,14 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->contents_multiply_orig));
   free_string_field (&(args_info->count_orig));
   free_string_field (&(args_info->reply_timeout_orig));
+  free_string_field (&(args_info->window_orig));
+  free_string_field (&(args_info->preallocate_orig));
+  free_string_field (&(args_info->match_rules_orig));
+  free_string_field (&(args_info->match_connections_orig));
+  free_string_field (&(args_info->idle_connections_orig));
+  free_string_field (&(args_info->activation_timeout_orig));
+  free_string_field (&(args_info->subscribers_orig));
+  free_string_field (&(args_info->signal_rate_orig));
   
   
   for (i = 0; i < args_info->inputs_num; ++i)
@@ -333,6 +417,10 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "system", 0, 0 );
   if (args_info->address_given)
     write_into_file(outfile, "address", args_info->address_orig, 0);
+  if (args_info->p2p_given)
+    write_into_file(outfile, "p2p", 0, 0 );
+  if (args_info->backend_given)
+    write_into_file(outfile, "backend", args_info->backend_orig, cmdline_parser_backend_values);
   if (args_info->type_given)
     write_into_file(outfile, "type", args_info->type_orig, cmdline_parser_type_values);
   if (args_info->destination_given)
@@ -349,8 +437,38 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "count", args_info->count_orig, 0);
   if (args_info->clone_given)
     write_into_file(outfile, "clone", 0, 0 );
+  if (args_info->generic_marshal_given)
+    write_into_file(outfile, "generic-marshal", 0, 0 );
   if (args_info->reply_timeout_given)
     write_into_file(outfile, "reply-timeout", args_info->reply_timeout_orig, 0);
+  if (args_info->window_given)
+    write_into_file(outfile, "window", args_info->window_orig, 0);
+  if (args_info->preallocate_given)
+    write_into_file(outfile, "preallocate", args_info->preallocate_orig, 0);
+  if (args_info->match_rules_given)
+    write_into_file(outfile, "match-rules", args_info->match_rules_orig, 0);
+  if (args_info->match_connections_given)
+    write_into_file(outfile, "match-connections", args_info->match_connections_orig, 0);
+  if (args_info->idle_connections_given)
+    write_into_file(outfile, "idle-connections", args_info->idle_connections_orig, 0);
+  if (args_info->idle_names_given)
+    write_into_file(outfile, "idle-names", 0, 0 );
+  if (args_info->verify_given)
+    write_into_file(outfile, "verify", 0, 0 );
+  if (args_info->raw_given)
+    write_into_file(outfile, "raw", 0, 0 );
+  if (args_info->connect_given)
+    write_into_file(outfile, "connect", 0, 0 );
+  if (args_info->connect_name_given)
+    write_into_file(outfile, "connect-name", 0, 0 );
+  if (args_info->activation_given)
+    write_into_file(outfile, "activation", 0, 0 );
+  if (args_info->activation_timeout_given)
+    write_into_file(outfile, "activation-timeout", args_info->activation_timeout_orig, 0);
+  if (args_info->subscribers_given)
+    write_into_file(outfile, "subscribers", args_info->subscribers_orig, 0);
+  if (args_info->signal_rate_given)
+    write_into_file(outfile, "signal-rate", args_info->signal_rate_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -488,12 +606,6 @@ cmdline_parser_required2 (struct gengetopt_args_info *args_info, const char *pro
       error = 1;
     }
   
-  if (! args_info->member_given)
-    {
-      fprintf (stderr, "%s: '--member' ('-m') option required%s\n", prog_name, (additional_error ? additional_error : ""));
-      error = 1;
-    }
-  
   
   /* checks for dependences among options */
 
@@ -676,6 +788,8 @@ cmdline_parser_internal (
         { "session",	0, NULL, 0 },
         { "system",	0, NULL, 0 },
         { "address",	1, NULL, 'a' },
+        { "p2p",	0, NULL, 0 },
+        { "backend",	1, NULL, 0 },
         { "type",	1, NULL, 't' },
         { "destination",	1, NULL, 'd' },
         { "path",	1, NULL, 'p' },
@@ -684,7 +798,22 @@ cmdline_parser_internal (
         { "contents-multiply",	1, NULL, 'x' },
         { "count",	1, NULL, 'c' },
         { "clone",	0, NULL, 0 },
+        { "generic-marshal",	0, NULL, 0 },
         { "reply-timeout",	1, NULL, 0 },
+        { "window",	1, NULL, 0 },
+        { "preallocate",	1, NULL, 0 },
+        { "match-rules",	1, NULL, 0 },
+        { "match-connections",	1, NULL, 0 },
+        { "idle-connections",	1, NULL, 0 },
+        { "idle-names",	0, NULL, 0 },
+        { "verify",	0, NULL, 0 },
+        { "raw",	0, NULL, 0 },
+        { "connect",	0, NULL, 0 },
+        { "connect-name",	0, NULL, 0 },
+        { "activation",	0, NULL, 0 },
+        { "activation-timeout",	1, NULL, 0 },
+        { "subscribers",	1, NULL, 0 },
+        { "signal-rate",	1, NULL, 0 },
         { 0,  0, 0, 0 }
       };
 
@@ -779,7 +908,7 @@ cmdline_parser_internal (
             goto failure;
         
           break;
-        case 'm':	/* member of the target object.  */
+        case 'm':	/* member of the target object (mandatory for sending).  */
         
         
           if (update_arg( (void *)&(args_info->member_arg), 
@@ -864,6 +993,34 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* talk to the peer at --address directly, without a bus daemon.  */
+          else if (strcmp (long_options[option_index].name, "p2p") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->p2p_given),
+                &(local_args_info.p2p_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "p2p", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* D-Bus library to send with, the -systemd and -gdbus builds default to theirs.  */
+          else if (strcmp (long_options[option_index].name, "backend") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->backend_arg), 
+                 &(args_info->backend_orig), &(args_info->backend_given),
+                &(local_args_info.backend_given), optarg, cmdline_parser_backend_values, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "backend", '-',
+                additional_error))
+              goto failure;
+          
           }
           /* intensively rebuild the message before sending (default is copy).  */
           else if (strcmp (long_options[option_index].name, "clone") == 0)
@@ -878,6 +1035,20 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* clone through the generic type switch even if a generated marshaler fits the CONTENTS.  */
+          else if (strcmp (long_options[option_index].name, "generic-marshal") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->generic_marshal_given),
+                &(local_args_info.generic_marshal_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "generic-marshal", '-',
+                additional_error))
+              goto failure;
+          
           }
           /* reply message timeout.  */
           else if (strcmp (long_options[option_index].name, "reply-timeout") == 0)
@@ -892,6 +1063,202 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* keep COUNT asynchronous calls in flight.  */
+          else if (strcmp (long_options[option_index].name, "window") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->window_arg), 
+                 &(args_info->window_orig), &(args_info->window_given),
+                &(local_args_info.window_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "window", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* send through a pool of COUNT preallocated send resources.  */
+          else if (strcmp (long_options[option_index].name, "preallocate") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->preallocate_arg), 
+                 &(args_info->preallocate_orig), &(args_info->preallocate_given),
+                &(local_args_info.preallocate_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "preallocate", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* install COUNT match rules the messages never match before sending.  */
+          else if (strcmp (long_options[option_index].name, "match-rules") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->match_rules_arg), 
+                 &(args_info->match_rules_orig), &(args_info->match_rules_given),
+                &(local_args_info.match_rules_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "match-rules", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* spread the match rules over COUNT extra connections.  */
+          else if (strcmp (long_options[option_index].name, "match-connections") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->match_connections_arg), 
+                 &(args_info->match_connections_orig), &(args_info->match_connections_given),
+                &(local_args_info.match_connections_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "match-connections", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* keep COUNT idle connections to the bus open while sending.  */
+          else if (strcmp (long_options[option_index].name, "idle-connections") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->idle_connections_arg), 
+                 &(args_info->idle_connections_orig), &(args_info->idle_connections_given),
+                &(local_args_info.idle_connections_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "idle-connections", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* let every idle connection own a well-known name.  */
+          else if (strcmp (long_options[option_index].name, "idle-names") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->idle_names_given),
+                &(local_args_info.idle_names_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "idle-names", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* check that every reply echoes the message sent, the summary shows what that cost.  */
+          else if (strcmp (long_options[option_index].name, "verify") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->verify_given),
+                &(local_args_info.verify_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "verify", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* echo the marshaled message over a socketpair to a forked peer, no D-Bus involved.  */
+          else if (strcmp (long_options[option_index].name, "raw") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->raw_given),
+                &(local_args_info.raw_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "raw", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* open and close --count private connections instead of sending.  */
+          else if (strcmp (long_options[option_index].name, "connect") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->connect_given),
+                &(local_args_info.connect_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "connect", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* request a well-known name on every connection.  */
+          else if (strcmp (long_options[option_index].name, "connect-name") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->connect_name_given),
+                &(local_args_info.connect_name_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "connect-name", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* have the destination activated --count times, stopping it in between.  */
+          else if (strcmp (long_options[option_index].name, "activation") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->activation_given),
+                &(local_args_info.activation_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "activation", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* how long to wait for the running service to exit.  */
+          else if (strcmp (long_options[option_index].name, "activation-timeout") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->activation_timeout_arg), 
+                 &(args_info->activation_timeout_orig), &(args_info->activation_timeout_given),
+                &(local_args_info.activation_timeout_given), optarg, 0, "5000", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "activation-timeout", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* let the service emit COUNT signals to this many subscriber connections.  */
+          else if (strcmp (long_options[option_index].name, "subscribers") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->subscribers_arg), 
+                 &(args_info->subscribers_orig), &(args_info->subscribers_given),
+                &(local_args_info.subscribers_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "subscribers", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* signals per second emitted by the service (0 is unlimited).  */
+          else if (strcmp (long_options[option_index].name, "signal-rate") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->signal_rate_arg), 
+                 &(args_info->signal_rate_orig), &(args_info->signal_rate_given),
+                &(local_args_info.signal_rate_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "signal-rate", '-',
+                additional_error))
+              goto failure;
+          
           }
           
           break;
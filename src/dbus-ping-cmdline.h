@@ -50,6 +50,10 @@ struct gengetopt_args_info
   char * address_arg;	/**< @brief specify the address of the message bus.  */
   char * address_orig;	/**< @brief specify the address of the message bus original value given at command line.  */
   const char *address_help; /**< @brief specify the address of the message bus help description.  */
+  const char *p2p_help; /**< @brief talk to the peer at --address directly, without a bus daemon help description.  */
+  char * backend_arg;	/**< @brief D-Bus library to send with, the -systemd and -gdbus builds default to theirs.  */
+  char * backend_orig;	/**< @brief D-Bus library to send with, the -systemd and -gdbus builds default to theirs original value given at command line.  */
+  const char *backend_help; /**< @brief D-Bus library to send with, the -systemd and -gdbus builds default to theirs help description.  */
   char * type_arg;	/**< @brief message type (default='method_call').  */
   char * type_orig;	/**< @brief message type original value given at command line.  */
   const char *type_help; /**< @brief message type help description.  */
@@ -62,9 +66,9 @@ struct gengetopt_args_info
   char * interface_arg;	/**< @brief interface of the target object.  */
   char * interface_orig;	/**< @brief interface of the target object original value given at command line.  */
   const char *interface_help; /**< @brief interface of the target object help description.  */
-  char * member_arg;	/**< @brief member of the target object.  */
-  char * member_orig;	/**< @brief member of the target object original value given at command line.  */
-  const char *member_help; /**< @brief member of the target object help description.  */
+  char * member_arg;	/**< @brief member of the target object (mandatory for sending).  */
+  char * member_orig;	/**< @brief member of the target object (mandatory for sending) original value given at command line.  */
+  const char *member_help; /**< @brief member of the target object (mandatory for sending) help description.  */
   int contents_multiply_arg;	/**< @brief append message contents clone (default='0').  */
   char * contents_multiply_orig;	/**< @brief append message contents clone original value given at command line.  */
   const char *contents_multiply_help; /**< @brief append message contents clone help description.  */
@@ -76,9 +80,40 @@ struct gengetopt_args_info
   char * count_orig;	/**< @brief number of times the message will be sent original value given at command line.  */
   const char *count_help; /**< @brief number of times the message will be sent help description.  */
   const char *clone_help; /**< @brief intensively rebuild the message before sending (default is copy) help description.  */
+  const char *generic_marshal_help; /**< @brief clone through the generic type switch even if a generated marshaler fits the CONTENTS help description.  */
   int reply_timeout_arg;	/**< @brief reply message timeout (default='-1').  */
   char * reply_timeout_orig;	/**< @brief reply message timeout original value given at command line.  */
   const char *reply_timeout_help; /**< @brief reply message timeout help description.  */
+  int window_arg;	/**< @brief keep COUNT asynchronous calls in flight (default='1').  */
+  char * window_orig;	/**< @brief keep COUNT asynchronous calls in flight original value given at command line.  */
+  const char *window_help; /**< @brief keep COUNT asynchronous calls in flight help description.  */
+  int preallocate_arg;	/**< @brief send through a pool of COUNT preallocated send resources (default='0').  */
+  char * preallocate_orig;	/**< @brief send through a pool of COUNT preallocated send resources original value given at command line.  */
+  const char *preallocate_help; /**< @brief send through a pool of COUNT preallocated send resources help description.  */
+  int match_rules_arg;	/**< @brief install COUNT match rules the messages never match before sending (default='0').  */
+  char * match_rules_orig;	/**< @brief install COUNT match rules the messages never match before sending original value given at command line.  */
+  const char *match_rules_help; /**< @brief install COUNT match rules the messages never match before sending help description.  */
+  int match_connections_arg;	/**< @brief spread the match rules over COUNT extra connections (default='1').  */
+  char * match_connections_orig;	/**< @brief spread the match rules over COUNT extra connections original value given at command line.  */
+  const char *match_connections_help; /**< @brief spread the match rules over COUNT extra connections help description.  */
+  int idle_connections_arg;	/**< @brief keep COUNT idle connections to the bus open while sending (default='0').  */
+  char * idle_connections_orig;	/**< @brief keep COUNT idle connections to the bus open while sending original value given at command line.  */
+  const char *idle_connections_help; /**< @brief keep COUNT idle connections to the bus open while sending help description.  */
+  const char *idle_names_help; /**< @brief let every idle connection own a well-known name help description.  */
+  const char *verify_help; /**< @brief check that every reply echoes the message sent, the summary shows what that cost help description.  */
+  const char *raw_help; /**< @brief echo the marshaled message over a socketpair to a forked peer, no D-Bus involved help description.  */
+  const char *connect_help; /**< @brief open and close --count private connections instead of sending help description.  */
+  const char *connect_name_help; /**< @brief request a well-known name on every connection help description.  */
+  const char *activation_help; /**< @brief have the destination activated --count times, stopping it in between help description.  */
+  int activation_timeout_arg;	/**< @brief how long to wait for the running service to exit (default='5000').  */
+  char * activation_timeout_orig;	/**< @brief how long to wait for the running service to exit original value given at command line.  */
+  const char *activation_timeout_help; /**< @brief how long to wait for the running service to exit help description.  */
+  int subscribers_arg;	/**< @brief let the service emit COUNT signals to this many subscriber connections (default='0').  */
+  char * subscribers_orig;	/**< @brief let the service emit COUNT signals to this many subscriber connections original value given at command line.  */
+  const char *subscribers_help; /**< @brief let the service emit COUNT signals to this many subscriber connections help description.  */
+  int signal_rate_arg;	/**< @brief signals per second emitted by the service (0 is unlimited) (default='0').  */
+  char * signal_rate_orig;	/**< @brief signals per second emitted by the service (0 is unlimited) original value given at command line.  */
+  const char *signal_rate_help; /**< @brief signals per second emitted by the service (0 is unlimited) help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int version_given ;	/**< @brief Whether version was given.  */
@@ -87,6 +122,8 @@ struct gengetopt_args_info
   unsigned int session_given ;	/**< @brief Whether session was given.  */
   unsigned int system_given ;	/**< @brief Whether system was given.  */
   unsigned int address_given ;	/**< @brief Whether address was given.  */
+  unsigned int p2p_given ;	/**< @brief Whether p2p was given.  */
+  unsigned int backend_given ;	/**< @brief Whether backend was given.  */
   unsigned int type_given ;	/**< @brief Whether type was given.  */
   unsigned int destination_given ;	/**< @brief Whether destination was given.  */
   unsigned int path_given ;	/**< @brief Whether path was given.  */
@@ -95,7 +132,22 @@ struct gengetopt_args_info
   unsigned int contents_multiply_given ;	/**< @brief Whether contents-multiply was given.  */
   unsigned int count_given ;	/**< @brief Whether count was given.  */
   unsigned int clone_given ;	/**< @brief Whether clone was given.  */
+  unsigned int generic_marshal_given ;	/**< @brief Whether generic-marshal was given.  */
   unsigned int reply_timeout_given ;	/**< @brief Whether reply-timeout was given.  */
+  unsigned int window_given ;	/**< @brief Whether window was given.  */
+  unsigned int preallocate_given ;	/**< @brief Whether preallocate was given.  */
+  unsigned int match_rules_given ;	/**< @brief Whether match-rules was given.  */
+  unsigned int match_connections_given ;	/**< @brief Whether match-connections was given.  */
+  unsigned int idle_connections_given ;	/**< @brief Whether idle-connections was given.  */
+  unsigned int idle_names_given ;	/**< @brief Whether idle-names was given.  */
+  unsigned int verify_given ;	/**< @brief Whether verify was given.  */
+  unsigned int raw_given ;	/**< @brief Whether raw was given.  */
+  unsigned int connect_given ;	/**< @brief Whether connect was given.  */
+  unsigned int connect_name_given ;	/**< @brief Whether connect-name was given.  */
+  unsigned int activation_given ;	/**< @brief Whether activation was given.  */
+  unsigned int activation_timeout_given ;	/**< @brief Whether activation-timeout was given.  */
+  unsigned int subscribers_given ;	/**< @brief Whether subscribers was given.  */
+  unsigned int signal_rate_given ;	/**< @brief Whether signal-rate was given.  */
 
   char **inputs ; /**< @brief unamed options (options without names) */
   unsigned inputs_num ; /**< @brief unamed options number */
@@ -221,6 +273,7 @@ void cmdline_parser_free (struct gengetopt_args_info *args_info);
 int cmdline_parser_required (struct gengetopt_args_info *args_info,
   const char *prog_name);
 
+extern const char *cmdline_parser_backend_values[];  /**< @brief Possible values for backend. */
 extern const char *cmdline_parser_type_values[];  /**< @brief Possible values for type. */
 
 
@@ -58,6 +58,151 @@ const char *get_next_data_item(char **items) {
 	return item;
 }
 
+#define HASH64_PRIME1	0x9E3779B185EBCA87ULL
+#define HASH64_PRIME2	0xC2B2AE3D27D4EB4FULL
+#define HASH64_PRIME3	0x165667B19E3779F9ULL
+#define HASH64_PRIME4	0x85EBCA77C2B2AE63ULL
+#define HASH64_PRIME5	0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t hash64_round(uint64_t acc, uint64_t input) {
+	acc += input * HASH64_PRIME2;
+	return rotl64(acc, 31) * HASH64_PRIME1;
+}
+
+static inline uint64_t hash64_merge(uint64_t acc, uint64_t v) {
+	acc ^= hash64_round(0, v);
+	return acc * HASH64_PRIME1 + HASH64_PRIME4;
+}
+
+/* XXH64, the result depends on the host byte order */
+uint64_t hash64(const void *data, size_t length, uint64_t seed) {
+	const unsigned char *p = data;
+	const unsigned char *end = p + length;
+	uint64_t h;
+
+	if (length >= 32) {
+		const unsigned char *limit = end - 32;
+		uint64_t v1 = seed + HASH64_PRIME1 + HASH64_PRIME2;
+		uint64_t v2 = seed + HASH64_PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - HASH64_PRIME1;
+
+		do {
+			v1 = hash64_round(v1, read64(p));
+			v2 = hash64_round(v2, read64(p + 8));
+			v3 = hash64_round(v3, read64(p + 16));
+			v4 = hash64_round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = hash64_merge(h, v1);
+		h = hash64_merge(h, v2);
+		h = hash64_merge(h, v3);
+		h = hash64_merge(h, v4);
+	} else
+		h = seed + HASH64_PRIME5;
+
+	h += length;
+
+	for (; p + 8 <= end; p += 8)
+		h = rotl64(h ^ hash64_round(0, read64(p)), 27) * HASH64_PRIME1 + HASH64_PRIME4;
+
+	if (p + 4 <= end) {
+		h = rotl64(h ^ (read32(p) * HASH64_PRIME1), 23) * HASH64_PRIME2 + HASH64_PRIME3;
+		p += 4;
+	}
+
+	for (; p < end; p++)
+		h = rotl64(h ^ (*p * HASH64_PRIME5), 11) * HASH64_PRIME1;
+
+	h ^= h >> 33;
+	h *= HASH64_PRIME2;
+	h ^= h >> 29;
+	h *= HASH64_PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+static int histogram_bucket(usec_t value) {
+	int exponent;
+
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return value;
+
+	exponent = 63 - __builtin_clzll(value);
+	return (exponent - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS
+			+ ((value >> (exponent - HISTOGRAM_SUB_BUCKET_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/* the largest value that falls into the bucket */
+static usec_t histogram_bucket_value(int bucket) {
+	int exponent = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKET_BITS - 1;
+	usec_t sub_bucket = bucket % HISTOGRAM_SUB_BUCKETS;
+
+	if (bucket < HISTOGRAM_SUB_BUCKETS)
+		return bucket;
+
+	return ((HISTOGRAM_SUB_BUCKETS + sub_bucket + 1) << (exponent - HISTOGRAM_SUB_BUCKET_BITS)) - 1;
+}
+
+void histogram_add(struct histogram *histogram, usec_t value) {
+	histogram->counts[histogram_bucket(value)]++;
+	histogram->total++;
+
+	if (value > histogram->max)
+		histogram->max = value;
+}
+
+void histogram_merge(struct histogram *histogram, const struct histogram *other) {
+	int i;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+		histogram->counts[i] += other->counts[i];
+	histogram->total += other->total;
+
+	if (other->max > histogram->max)
+		histogram->max = other->max;
+}
+
+usec_t histogram_percentile(const struct histogram *histogram, double percentile) {
+	unsigned long rank = (unsigned long) (histogram->total * percentile / 100.0 + 0.5);
+	unsigned long count = 0;
+	int i;
+
+	if (!histogram->total)
+		return 0;
+
+	if (rank < 1)
+		rank = 1;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		count += histogram->counts[i];
+		if (count >= rank)
+			break;
+	}
+
+	return i < HISTOGRAM_BUCKETS && histogram_bucket_value(i) < histogram->max ?
+			histogram_bucket_value(i) : histogram->max;
+}
+
 int type_from_name(const char *arg) {
 	if (!strcmp(arg, "string"))			return 's';
 	else if (!strcmp(arg, "int16"))		return 'n';
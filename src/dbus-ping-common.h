@@ -33,6 +33,7 @@
 void assert_error(int expression, const char *fmt, ...);
 const char *get_next_data_item(char **items);
 int type_from_name(const char *arg);
+uint64_t hash64(const void *data, size_t length, uint64_t seed);
 
 
 #define USEC_PER_SEC  1000000ULL
@@ -47,4 +48,22 @@ static inline usec_t time_now(clockid_t clock_id) {
 	return (usec_t) ts.tv_sec * USEC_PER_SEC + (usec_t) ts.tv_nsec / NSEC_PER_USEC;
 }
 
+/*
+ * Log-linear latency histogram: every power of two is split into
+ * HISTOGRAM_SUB_BUCKETS linear buckets, so percentiles are within ~6%.
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS	4
+#define HISTOGRAM_SUB_BUCKETS		(1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS			((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct histogram {
+	unsigned long counts[HISTOGRAM_BUCKETS];
+	unsigned long total;
+	usec_t max;
+};
+
+void histogram_add(struct histogram *histogram, usec_t value);
+void histogram_merge(struct histogram *histogram, const struct histogram *other);
+usec_t histogram_percentile(const struct histogram *histogram, double percentile);
+
 #endif /* DBUS_PING_COMMON_H_ */
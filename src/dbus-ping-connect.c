@@ -0,0 +1,211 @@
+/*
+ *
+ * dbus-ping-connect.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-ping-connect.h"
+#include "dbus-ping-common.h"
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbus/dbus.h>
+
+#define DEFAULT_SYSTEM_BUS_ADDRESS	"unix:path=/var/run/dbus/system_bus_socket"
+#define CONNECT_NAME_PREFIX			"com.bmw.Test.Connect"
+
+
+enum connect_step {
+	STEP_CONNECT,
+	STEP_AUTH,
+	STEP_HELLO,
+	STEP_REQUEST_NAME,
+	STEP_CLOSE,
+	STEP_TOTAL,
+	STEP_COUNT,
+};
+
+static const char *step_names[] = {
+	[STEP_CONNECT] = "connect",
+	[STEP_AUTH] = "auth",
+	[STEP_HELLO] = "hello",
+	[STEP_REQUEST_NAME] = "request_name",
+	[STEP_CLOSE] = "close",
+	[STEP_TOTAL] = "total",
+};
+
+static struct histogram step_latency[STEP_COUNT];
+
+
+/* dbus_bus_get_private() would hide the steps, so the bus is opened by address */
+static const char *get_bus_address(const struct gengetopt_args_info *args_info) {
+	const char *address;
+
+	if (args_info->address_given)
+		return args_info->address_arg;
+
+	if (args_info->system_given) {
+		address = getenv("DBUS_SYSTEM_BUS_ADDRESS");
+		return address ? address : DEFAULT_SYSTEM_BUS_ADDRESS;
+	}
+
+	address = getenv("DBUS_SESSION_BUS_ADDRESS");
+	assert_error(address != NULL, "DBUS_SESSION_BUS_ADDRESS is not set, use --address");
+
+	return address;
+}
+
+static void step_end(enum connect_step step, usec_t *time) {
+	usec_t now = time_now(CLOCK_MONOTONIC);
+
+	histogram_add(&step_latency[step], now - *time);
+	*time = now;
+}
+
+static int connect_cycle(const char *address, long cycle, const struct gengetopt_args_info *args_info) {
+	usec_t start = time_now(CLOCK_MONOTONIC), time = start;
+	DBusConnection *connection;
+	DBusError error;
+
+	dbus_error_init(&error);
+
+	/* connects the socket, nothing has been sent yet */
+	connection = dbus_connection_open_private(address, &error);
+	if (!connection)
+		goto fail;
+	step_end(STEP_CONNECT, &time);
+
+	/* libdbus authenticates lazily, drive the handshake on its own */
+	while (!dbus_connection_get_is_authenticated(connection))
+		if (!dbus_connection_read_write(connection, -1)) {
+			dbus_set_error(&error, DBUS_ERROR_AUTH_FAILED, "Disconnected during authentication");
+			goto fail;
+		}
+	step_end(STEP_AUTH, &time);
+
+	if (!dbus_bus_register(connection, &error))
+		goto fail;
+	step_end(STEP_HELLO, &time);
+
+	if (args_info->connect_name_given) {
+		char name[64];
+
+		/* the daemon may not have noticed yet that the previous owner is gone */
+		snprintf(name, sizeof(name), CONNECT_NAME_PREFIX "%ld", cycle);
+		if (dbus_bus_request_name(connection, name, DBUS_NAME_FLAG_DO_NOT_QUEUE, &error) < 0)
+			goto fail;
+		step_end(STEP_REQUEST_NAME, &time);
+	}
+
+	dbus_connection_close(connection);
+	dbus_connection_unref(connection);
+	step_end(STEP_CLOSE, &time);
+
+	histogram_add(&step_latency[STEP_TOTAL], time - start);
+
+	return 1;
+
+fail:
+	fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Connect error %s: %s\n", error.name, error.message);
+	dbus_error_free(&error);
+
+	if (connection) {
+		dbus_connection_close(connection);
+		dbus_connection_unref(connection);
+	}
+
+	return 0;
+}
+
+static void show_summary(long connections, long failures, usec_t elapsed_time,
+                         const struct gengetopt_args_info *args_info) {
+	FILE *out = args_info->bash_given ? stderr : stdout;
+	/* usec_t is only unsigned long on 64 bit */
+	unsigned long long connect_time = elapsed_time;
+	unsigned long long connects_per_sec = elapsed_time > 0 ? USEC_PER_SEC * connections / elapsed_time : 0;
+	int i;
+
+	if (args_info->bash_given) {
+		printf("DBUS_PING_CONNECTIONS=%ld;\n"
+				"DBUS_PING_CONNECT_FAILURES=%ld;\n"
+				"DBUS_PING_CONNECT_TIME=%llu;\n"
+				"DBUS_PING_CONNECTS_PER_SEC=%llu;\n",
+				connections, failures, connect_time, connects_per_sec);
+
+		for (i = 0; i < STEP_COUNT; i++) {
+			char name[32];
+			int j;
+
+			if (!step_latency[i].total)
+				continue;
+
+			for (j = 0; step_names[i][j] && j < sizeof(name) - 1; j++)
+				name[j] = toupper(step_names[i][j]);
+			name[j] = '\0';
+
+			printf("DBUS_PING_SETUP_%s_P50=%llu;\n"
+					"DBUS_PING_SETUP_%s_P99=%llu;\n"
+					"DBUS_PING_SETUP_%s_MAX=%llu;\n",
+					name, (unsigned long long) histogram_percentile(&step_latency[i], 50.0),
+					name, (unsigned long long) histogram_percentile(&step_latency[i], 99.0),
+					name, (unsigned long long) step_latency[i].max);
+		}
+	}
+
+	if (!args_info->bash_given || args_info->verbose_given) {
+		fprintf(out,
+				"connections  failures   time (usec)   connects/sec\n"
+				"%-12ld %-10ld %-13llu %llu\n",
+				connections, failures, connect_time, connects_per_sec);
+
+		fprintf(out, "step          p50          p90          p99          max (usec)\n");
+		for (i = 0; i < STEP_COUNT; i++)
+			if (step_latency[i].total)
+				fprintf(out, "%-13s %-12llu %-12llu %-12llu %llu\n",
+						step_names[i],
+						(unsigned long long) histogram_percentile(&step_latency[i], 50.0),
+						(unsigned long long) histogram_percentile(&step_latency[i], 90.0),
+						(unsigned long long) histogram_percentile(&step_latency[i], 99.0),
+						(unsigned long long) step_latency[i].max);
+	}
+
+	fflush(stdout);
+}
+
+int run_connect_cycles(const struct gengetopt_args_info *args_info) {
+	const char *address = get_bus_address(args_info);
+	long cycle, connections = 0;
+	usec_t start_time;
+
+	start_time = time_now(CLOCK_MONOTONIC);
+
+	/* a failure is a setup problem, e.g. an auth mechanism the daemon does not accept */
+	for (cycle = 0; cycle < args_info->count_arg; cycle++) {
+		if (!connect_cycle(address, cycle, args_info))
+			break;
+		connections++;
+	}
+
+	show_summary(connections, cycle - connections, time_now(CLOCK_MONOTONIC) - start_time,
+	             args_info);
+
+	return connections == args_info->count_arg ? 0 : -1;
+}
@@ -0,0 +1,378 @@
+/*
+ *
+ * dbus-ping-driver.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-ping-driver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* the slot is reused once its reply arrived */
+struct dbus_ping_call {
+	usec_t time;
+};
+
+struct call_window {
+	struct dbus_ping_call *calls;
+	int *free_calls;
+	int free_count;
+	long int completed;
+};
+
+
+/* --verify: the template's hash and what checking the replies against it cost */
+struct reply_verify {
+	const struct dbus_ping_backend *backend;
+	void *state;
+	uint64_t expected;
+	long int checked;
+	long int mismatches;
+	usec_t time;
+};
+
+
+static usec_t start_time;
+static usec_t message_duplicate_time;
+static usec_t message_send_time;
+static struct histogram send_latency;
+static struct call_window window;
+static struct reply_verify verify;
+static long int failed_calls;
+
+
+const struct dbus_ping_backend *dbus_ping_backend_find(const struct dbus_ping_backend * const *backends,
+                                                       const struct gengetopt_args_info *args_info) {
+	/* the first one is the binary's default */
+	if (!args_info->backend_given)
+		return backends[0];
+
+	for (; *backends; backends++)
+		if (!strcmp((*backends)->name, args_info->backend_arg))
+			return *backends;
+
+	return NULL;
+}
+
+void dbus_ping_driver_reject_modes(const struct gengetopt_args_info *args_info) {
+	const struct {
+		int given;
+		const char *name;
+	} modes[] = {
+		{ args_info->raw_given, "raw" },
+		{ args_info->connect_given, "connect" },
+		{ args_info->connect_name_given, "connect-name" },
+		{ args_info->activation_given, "activation" },
+		{ args_info->activation_timeout_given, "activation-timeout" },
+		{ args_info->subscribers_given, "subscribers" },
+		{ args_info->signal_rate_given, "signal-rate" },
+		{ args_info->match_rules_given, "match-rules" },
+		{ args_info->match_connections_given, "match-connections" },
+		{ args_info->idle_connections_given, "idle-connections" },
+		{ args_info->idle_names_given, "idle-names" },
+	};
+	int i;
+
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+		assert_error(!modes[i].given, "'--%s' is only implemented by the libdbus build of " CMDLINE_PARSER_PACKAGE,
+				modes[i].name);
+}
+
+void dbus_ping_driver_start(void) {
+	start_time = time_now(CLOCK_MONOTONIC);
+}
+
+void dbus_ping_driver_record(usec_t time) {
+	message_send_time += time;
+	histogram_add(&send_latency, time);
+}
+
+void dbus_ping_driver_update_progress(long int count, const struct gengetopt_args_info *args_info) {
+	static usec_t last_update_time;
+	usec_t elapsed_time = time_now(CLOCK_MONOTONIC) - start_time;
+
+	if (!args_info->verbose_given)
+		return;
+
+	if (last_update_time > 0) {
+		if (elapsed_time - last_update_time < 2 * USEC_PER_SEC)
+			return;
+
+		fprintf(stderr, "Sent %ld message%s in %llu seconds (%llu msgs/sec, %u%% done)\n",
+				count, count != 1 ? "s" : "",
+				elapsed_time / USEC_PER_SEC,
+				elapsed_time > 0 ? count * USEC_PER_SEC / elapsed_time : 0,
+				(unsigned int) ((100 * count) / args_info->count_arg));
+	}
+
+	last_update_time = elapsed_time;
+}
+
+static void *message_duplicate(const struct dbus_ping_backend *backend, void *state,
+                               const struct gengetopt_args_info *args_info, void *template) {
+	usec_t time = time_now(CLOCK_MONOTONIC);
+	void *message = backend->duplicate(state, args_info, template);
+
+	message_duplicate_time += time_now(CLOCK_MONOTONIC) - time;
+
+	return message;
+}
+
+/* a failed call is no round trip, it is neither timed nor counted as received */
+static void call_failed(void) {
+	if (!failed_calls++)
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Call failed\n");
+}
+
+void dbus_ping_call_complete(struct dbus_ping_call *call, int success) {
+	if (success)
+		dbus_ping_driver_record(time_now(CLOCK_MONOTONIC) - call->time);
+	else
+		call_failed();
+
+	window.free_calls[window.free_count++] = call - window.calls;
+	window.completed++;
+}
+
+void dbus_ping_driver_verify(void *reply) {
+	usec_t time;
+
+	if (!verify.backend)
+		return;
+
+	time = time_now(CLOCK_MONOTONIC);
+
+	if (verify.backend->hash(verify.state, reply) != verify.expected && !verify.mismatches++)
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Reply %ld differs from the message sent\n", verify.checked);
+	verify.checked++;
+
+	verify.time += time_now(CLOCK_MONOTONIC) - time;
+}
+
+long int dbus_ping_driver_mismatches(void) {
+	return verify.mismatches;
+}
+
+static void verify_init(const struct dbus_ping_backend *backend, void *state,
+                        const struct gengetopt_args_info *args_info, void *template) {
+	assert_error(backend->hash != NULL, "The %s backend can't verify replies", backend->name);
+	assert_error(!strcmp(args_info->type_arg, "method_call"), "Only the replies to method calls can be verified");
+
+	verify.backend = backend;
+	verify.state = state;
+	verify.expected = backend->hash(state, template);
+}
+
+/* a call that failed or never got its reply didn't echo the message either */
+static void verify_finish(const struct gengetopt_args_info *args_info) {
+	long int unchecked = args_info->count_arg - verify.checked;
+
+	if (unchecked <= 0)
+		return;
+
+	fprintf(stderr, CMDLINE_PARSER_PACKAGE ": %ld of %ld calls got no reply to verify\n",
+			unchecked, args_info->count_arg);
+	verify.mismatches += unchecked;
+}
+
+/* one blocking round trip after the other */
+static long int run_blocking(const struct dbus_ping_backend *backend, void *state,
+                             const struct gengetopt_args_info *args_info, void *template) {
+	long int count;
+
+	for (count = 0; count < args_info->count_arg; count++) {
+		usec_t time, verify_time = verify.time;
+		void *message;
+
+		if (backend->prepare)
+			backend->prepare(state);
+
+		message = message_duplicate(backend, state, args_info, template);
+		time = time_now(CLOCK_MONOTONIC);
+
+		if (backend->send(state, args_info, message, NULL))
+			/* the reply was checked inside send(), that isn't the round trip's */
+			dbus_ping_driver_record(time_now(CLOCK_MONOTONIC) - time - (verify.time - verify_time));
+		else
+			call_failed();
+
+		dbus_ping_driver_update_progress(count, args_info);
+	}
+
+	return count - failed_calls;
+}
+
+/*
+ * Keeps --window calls in flight: whenever a reply frees a slot the next
+ * call goes out, the backend only waits when there is nothing to dispatch.
+ */
+static long int run_window(const struct dbus_ping_backend *backend, void *state,
+                           const struct gengetopt_args_info *args_info, void *template) {
+	long int sent = 0;
+	int i;
+
+	memset(&window, 0, sizeof(window));
+	window.calls = calloc(args_info->window_arg, sizeof(*window.calls));
+	window.free_calls = calloc(args_info->window_arg, sizeof(*window.free_calls));
+	assert_error(window.calls != NULL && window.free_calls != NULL, "Unable to allocate call window (out of memory)");
+
+	for (i = args_info->window_arg - 1; i >= 0; i--)
+		window.free_calls[window.free_count++] = i;
+
+	while (window.completed < args_info->count_arg) {
+		while (window.free_count > 0 && sent < args_info->count_arg) {
+			struct dbus_ping_call *call = &window.calls[window.free_calls[--window.free_count]];
+			void *message = message_duplicate(backend, state, args_info, template);
+
+			call->time = time_now(CLOCK_MONOTONIC);
+			if (!backend->send(state, args_info, message, call))
+				goto end;
+
+			sent++;
+			dbus_ping_driver_update_progress(sent, args_info);
+		}
+
+		if (!backend->receive(state))
+			break;
+	}
+
+end:
+	if (window.completed < args_info->count_arg)
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Call window failed after %ld replies\n", window.completed);
+
+	free(window.free_calls);
+	free(window.calls);
+
+	return window.completed - failed_calls;
+}
+
+long int dbus_ping_driver_run(const struct dbus_ping_backend *backend, void *state,
+                              const struct gengetopt_args_info *args_info, void *template) {
+	long int count;
+
+	assert_error(args_info->window_arg > 0, "Invalid window size %d", args_info->window_arg);
+	assert_error(args_info->window_arg == 1 || !strcmp(args_info->type_arg, "method_call"),
+			"Only method calls can be pipelined");
+
+	if (args_info->verify_given)
+		verify_init(backend, state, args_info, template);
+
+	dbus_ping_driver_start();
+
+	if (args_info->window_arg > 1) {
+		count = run_window(backend, state, args_info, template);
+
+		/* the calls overlap, so only the wall clock time counts */
+		message_send_time = time_now(CLOCK_MONOTONIC) - start_time - message_duplicate_time - verify.time;
+	} else
+		count = run_blocking(backend, state, args_info, template);
+
+	if (failed_calls > 0)
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": %ld of %ld calls failed\n", failed_calls, args_info->count_arg);
+
+	if (verify.backend)
+		verify_finish(args_info);
+
+	return count;
+}
+
+long int dbus_ping_driver_failures(void) {
+	return failed_calls;
+}
+
+void dbus_ping_driver_show_summary(const char *prefix, const struct dbus_ping_backend *backend, void *state,
+                                   int sent, int received, const struct gengetopt_args_info *args_info) {
+	FILE *out = args_info->bash_given ? stderr : stdout;
+	/* what is printed, usec_t is only unsigned long on 64 bit */
+	unsigned long long elapsed_time = time_now(CLOCK_MONOTONIC) - start_time;
+	unsigned long long elapsed_time_sec = elapsed_time / USEC_PER_SEC;
+	int total = sent + received;
+	unsigned long long msgs_per_sec = elapsed_time > 0 ? total * USEC_PER_SEC / elapsed_time : total;
+	unsigned long long duplicate_time = message_duplicate_time, send_time = message_send_time;
+	unsigned long long p50 = histogram_percentile(&send_latency, 50.0);
+	unsigned long long p90 = histogram_percentile(&send_latency, 90.0);
+	unsigned long long p99 = histogram_percentile(&send_latency, 99.0);
+	unsigned long long max = send_latency.max;
+	/* what --verify costs per reply, and as a share of the run */
+	unsigned long long verify_time = verify.time;
+	unsigned long long verify_nsec = verify.checked > 0 ? verify.time * NSEC_PER_USEC / verify.checked : 0;
+	double verify_share = elapsed_time > 0 ? 100.0 * verify.time / elapsed_time : 0;
+
+	if (args_info->bash_given)
+		printf("%1$s_SENT=%2$d;\n"
+				"%1$s_RECEIVED=%3$d;\n"
+				"%1$s_TOTAL=%4$d;\n"
+				"%1$s_TIME=%5$llu;\n"
+				"%1$s_TIME_SEC=%6$llu;\n"
+				"%1$s_MSGS_PER_SEC=%7$llu;\n"
+				"%1$s_DUPLICATE_TIME=%8$llu;\n"
+				"%1$s_SEND_TIME=%9$llu;\n"
+				"%1$s_BACKEND=%10$s;\n"
+				"%1$s_WINDOW=%11$d;\n"
+				"%1$s_LATENCY_P50=%12$llu;\n"
+				"%1$s_LATENCY_P90=%13$llu;\n"
+				"%1$s_LATENCY_P99=%14$llu;\n"
+				"%1$s_LATENCY_MAX=%15$llu;\n",
+				prefix, sent, received, total,
+				elapsed_time, elapsed_time_sec,
+				msgs_per_sec,
+				duplicate_time,
+				send_time,
+				backend ? backend->name : "none", args_info->window_arg,
+				p50, p90, p99, max);
+
+	if (args_info->bash_given && verify.backend)
+		printf("%1$s_VERIFIED=%2$ld;\n"
+				"%1$s_MISMATCHES=%3$ld;\n"
+				"%1$s_VERIFY_TIME=%4$llu;\n"
+				"%1$s_VERIFY_NSEC_PER_REPLY=%5$llu;\n",
+				prefix, verify.checked, verify.mismatches, verify_time, verify_nsec);
+
+	if (!args_info->bash_given || args_info->verbose_given) {
+		fprintf(out,
+				"sent       received   total      "
+				"time (sec)   time (usec)   msgs/sec (total) "
+				"duplicate time  send time\n"
+				"%-10d %-10d %-10d "
+				"%-12llu %-13llu %-16llu "
+				"%-15llu %llu\n",
+				sent, received, total,
+				elapsed_time_sec, elapsed_time, msgs_per_sec,
+				duplicate_time, send_time);
+
+		fprintf(out,
+				"backend    window     latency p50  p90          p99          max (usec)\n"
+				"%-10s %-10d %-12llu %-12llu %-12llu %llu\n",
+				backend ? backend->name : "none", args_info->window_arg,
+				p50, p90, p99, max);
+
+		if (verify.backend)
+			fprintf(out,
+					"verified   mismatches verify time (usec)  per reply (nsec)  share (%%)\n"
+					"%-10ld %-10ld %-19llu %-17llu %.2f\n",
+					verify.checked, verify.mismatches, verify_time, verify_nsec, verify_share);
+	}
+
+	if (backend && backend->show_summary)
+		backend->show_summary(state, prefix, args_info);
+
+	fflush(stdout);
+}
@@ -0,0 +1,110 @@
+/*
+ *
+ * dbus-ping-driver.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_DRIVER_H_
+#define DBUS_PING_DRIVER_H_
+
+#include "dbus-ping-cmdline.h"
+#include "dbus-ping-common.h"
+
+
+/* a call in flight, handed to the backend's asynchronous send */
+struct dbus_ping_call;
+
+/*
+ * The library specific part of the client. The driver owns the workload,
+ * the timing, the histograms and the output, a backend only moves messages.
+ * Messages are opaque to the driver. Only the ping loop runs through a
+ * backend, dbus-ping's other modes (--raw, --connect, --subscribers,
+ * --activation, idle connections and match rules) use libdbus directly.
+ */
+struct dbus_ping_backend {
+	const char *name;
+
+	/* opens the connection, returns the backend's state */
+	void *(*connect)(const struct gengetopt_args_info *args_info);
+	void (*disconnect)(void *backend);
+
+	/* builds the template from CONTENTS once, untimed */
+	void *(*build)(void *backend, const struct gengetopt_args_info *args_info);
+	/* the message that is actually sent, a copy of the template or rebuilt with --clone */
+	void *(*duplicate)(void *backend, const struct gengetopt_args_info *args_info, void *template);
+	void (*free_message)(void *backend, void *message);
+
+	/*
+	 * Sends the message and takes it over. Without a call it blocks until
+	 * the reply arrived, otherwise the backend reports the reply through
+	 * dbus_ping_call_complete() from receive(). Returns 0 on failure.
+	 */
+	int (*send)(void *backend, const struct gengetopt_args_info *args_info, void *message,
+	            struct dbus_ping_call *call);
+	/* dispatches whatever arrived, waits if there is nothing, returns 0 on failure */
+	int (*receive)(void *backend);
+
+	/*
+	 * optional: a hash of the message's arguments for --verify. A reply
+	 * that echoes them hashes the same as the template.
+	 */
+	uint64_t (*hash)(void *backend, void *message);
+
+	/* optional: called outside of the timed section before every send */
+	void (*prepare)(void *backend);
+	/* optional: backend specific lines of the summary */
+	void (*show_summary)(void *backend, const char *prefix, const struct gengetopt_args_info *args_info);
+};
+
+/*
+ * For the binaries that only ping: rejects the options of the modes that
+ * dbus-ping runs next to the driver, e.g. --raw or --subscribers.
+ */
+void dbus_ping_driver_reject_modes(const struct gengetopt_args_info *args_info);
+
+/* looks up --backend, NULL if this binary has no backend of that name */
+const struct dbus_ping_backend *dbus_ping_backend_find(const struct dbus_ping_backend * const *backends,
+                                                       const struct gengetopt_args_info *args_info);
+
+/* for the backends, once per reply to an asynchronous send */
+void dbus_ping_call_complete(struct dbus_ping_call *call, int success);
+/* for the backends, once per reply before they release it; only hashes it under --verify */
+void dbus_ping_driver_verify(void *reply);
+/* the replies --verify found to differ from the template */
+long int dbus_ping_driver_mismatches(void);
+/* the calls that got an error or no reply at all */
+long int dbus_ping_driver_failures(void);
+
+/*
+ * Sends --count messages built from the template, one at a time or with
+ * --window calls in flight, and returns how many round trips succeeded.
+ */
+long int dbus_ping_driver_run(const struct dbus_ping_backend *backend, void *state,
+                              const struct gengetopt_args_info *args_info, void *template);
+
+/* for the modes that time themselves, e.g. the raw baseline */
+void dbus_ping_driver_start(void);
+void dbus_ping_driver_record(usec_t time);
+void dbus_ping_driver_update_progress(long int count, const struct gengetopt_args_info *args_info);
+
+/* the bash variables are named <prefix>_SENT etc. */
+void dbus_ping_driver_show_summary(const char *prefix, const struct dbus_ping_backend *backend, void *state,
+                                   int sent, int received, const struct gengetopt_args_info *args_info);
+
+#endif /* DBUS_PING_DRIVER_H_ */
@@ -0,0 +1,349 @@
+/*
+ *
+ * dbus-ping-gdbus.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "dbus-ping-cmdline.h"
+#include "dbus-ping-common.h"
+#include "dbus-ping-driver.h"
+#include "dbus-ping-libdbus.h"
+
+
+static GVariant *variant_from_value(char type, const char *value) {
+	switch (type) {
+	case 'y':
+		return g_variant_new_byte(strtoul(value, NULL, 0));
+	case 'b':
+		assert_error(!strcmp(value, "true") || !strcmp(value, "false"),
+				"Expected 'true' or 'false' instead of '%s'", value);
+		return g_variant_new_boolean(!strcmp(value, "true"));
+	case 'n':
+		return g_variant_new_int16(strtol(value, NULL, 0));
+	case 'q':
+		return g_variant_new_uint16(strtoul(value, NULL, 0));
+	case 'i':
+		return g_variant_new_int32(strtol(value, NULL, 0));
+	case 'u':
+		return g_variant_new_uint32(strtoul(value, NULL, 0));
+	case 'x':
+		return g_variant_new_int64(strtoll(value, NULL, 0));
+	case 't':
+		return g_variant_new_uint64(strtoull(value, NULL, 0));
+	case 'd':
+		return g_variant_new_double(strtod(value, NULL));
+	case 's':
+		return g_variant_new_string(value);
+	case 'o':
+		assert_error(g_variant_is_object_path(value), "Invalid object path '%s'", value);
+		return g_variant_new_object_path(value);
+	default:
+		assert_error(0, "Unsupported data type %c", type);
+		return NULL;
+	}
+}
+
+static GVariant *variant_from_struct(char *expr) {
+	GVariantBuilder builder;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_TUPLE);
+
+	while (*expr != '\0') {
+		char type = type_from_name(get_next_data_item(&expr));
+		const char *value = *expr != '\0' ? get_next_data_item(&expr) : "";
+
+		g_variant_builder_add_value(&builder, variant_from_value(type, value));
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+/* V1,V2,... or K1,V1,K2,V2,... with a value type */
+static GVariant *variant_from_list(char keytype, char valtype, const char *value) {
+	char element[] = { keytype, '\0' };
+	char entry[] = { '{', keytype, valtype, '}', '\0' };
+	char *copy = strdup(value);
+	GVariantBuilder builder;
+	GVariantType *type;
+	const char *val;
+
+	assert_error(copy != NULL, "Unable to parse list (out of memory)");
+
+	/* an empty array still needs its element type */
+	type = g_variant_type_new_array(G_VARIANT_TYPE(valtype ? entry : element));
+	g_variant_builder_init(&builder, type);
+	g_variant_type_free(type);
+
+	for (val = strtok(copy, ","); val != NULL; val = strtok(NULL, ",")) {
+		GVariant *key = variant_from_value(keytype, val);
+
+		if (!valtype) {
+			g_variant_builder_add_value(&builder, key);
+			continue;
+		}
+
+		val = strtok(NULL, ",");
+		assert_error(val != NULL, "Malformed dictionary");
+		g_variant_builder_add_value(&builder, g_variant_new_dict_entry(key, variant_from_value(valtype, val)));
+	}
+
+	free(copy);
+
+	return g_variant_builder_end(&builder);
+}
+
+static char container_subtype(char **arg) {
+	return **arg == '\0' ? 's' : type_from_name(get_next_data_item(arg));
+}
+
+static GVariant *variant_from_input(const char *input) {
+	char *copy = strdup(input), *arg = copy;
+	char type, keytype;
+	GVariant *variant;
+
+	assert_error(copy != NULL, "Unable to parse contents (out of memory)");
+
+	type = type_from_name(get_next_data_item(&arg));
+
+	switch (type) {
+	case 'r':
+		variant = variant_from_struct(arg);
+		break;
+	case 'e':
+		keytype = container_subtype(&arg);
+		variant = variant_from_list(keytype, type_from_name(get_next_data_item(&arg)), arg);
+		break;
+	case 'a':
+		variant = variant_from_list(container_subtype(&arg), 0, arg);
+		break;
+	case 'v':
+		keytype = container_subtype(&arg);
+		variant = g_variant_new_variant(variant_from_value(keytype, arg));
+		break;
+	default:
+		variant = variant_from_value(type, arg);
+		break;
+	}
+
+	free(copy);
+
+	return variant;
+}
+
+/*
+ * The CONTENTS arguments as the parameter tuple of a call. A GVariant array
+ * needs a single complete element type, so with --contents-multiply and more
+ * than one argument every repetition becomes a struct of them.
+ */
+static GVariant *variant_from_contents(const struct gengetopt_args_info *args_info) {
+	GVariantBuilder builder, array;
+	int i, j;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_TUPLE);
+
+	if (args_info->contents_multiply_arg <= 1 || !args_info->inputs_num) {
+		for (i = 0; i < args_info->inputs_num; i++)
+			g_variant_builder_add_value(&builder, variant_from_input(args_info->inputs[i]));
+
+		return g_variant_ref_sink(g_variant_builder_end(&builder));
+	}
+
+	g_variant_builder_init(&array, G_VARIANT_TYPE_ARRAY);
+
+	for (j = 0; j < args_info->contents_multiply_arg; j++) {
+		if (args_info->inputs_num == 1) {
+			g_variant_builder_add_value(&array, variant_from_input(args_info->inputs[0]));
+			continue;
+		}
+
+		g_variant_builder_open(&array, G_VARIANT_TYPE_TUPLE);
+		for (i = 0; i < args_info->inputs_num; i++)
+			g_variant_builder_add_value(&array, variant_from_input(args_info->inputs[i]));
+		g_variant_builder_close(&array);
+	}
+
+	g_variant_builder_add_value(&builder, g_variant_builder_end(&array));
+
+	return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static void *backend_connect(const struct gengetopt_args_info *args_info) {
+	GDBusConnection *connection;
+	GError *error = NULL;
+
+	assert_error(!args_info->preallocate_arg, "'--preallocate' is libdbus only");
+
+	if (args_info->address_given)
+		connection = g_dbus_connection_new_for_address_sync(args_info->address_arg,
+				G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+				(args_info->p2p_given ? 0 : G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+				NULL, NULL, &error);
+	else
+		connection = g_bus_get_sync(args_info->system_given ? G_BUS_TYPE_SYSTEM : G_BUS_TYPE_SESSION,
+				NULL, &error);
+	assert_error(connection != NULL, "Failed to open connection: %s", error ? error->message : "unknown error");
+
+	return connection;
+}
+
+static void backend_disconnect(void *connection) {
+	g_dbus_connection_flush_sync(connection, NULL, NULL);
+	g_object_unref(connection);
+}
+
+static void *backend_build(void *connection, const struct gengetopt_args_info *args_info) {
+	assert_error(strcmp(args_info->type_arg, "signal") || args_info->interface_given,
+			"GDBus needs an '--interface' to emit signals");
+
+	return variant_from_contents(args_info);
+}
+
+/* GVariants are immutable and GDBus serializes the parameters of every call, a reference is the copy */
+static void *backend_duplicate(void *connection, const struct gengetopt_args_info *args_info, void *template) {
+	return args_info->clone_given ? variant_from_contents(args_info) : g_variant_ref(template);
+}
+
+static void backend_free_message(void *connection, void *message) {
+	g_variant_unref(message);
+}
+
+static void handle_reply(GObject *source, GAsyncResult *result, gpointer data) {
+	GError *error = NULL;
+	GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+
+	dbus_ping_call_complete(data, reply != NULL);
+
+	if (reply) {
+		dbus_ping_driver_verify(reply);
+		g_variant_unref(reply);
+	} else
+		g_error_free(error);
+}
+
+static int backend_send(void *connection, const struct gengetopt_args_info *args_info, void *message,
+                        struct dbus_ping_call *call) {
+	GError *error = NULL;
+	GVariant *reply;
+	int ret = 1;
+
+	/* the replies come back through the main context of this thread */
+	if (call)
+		g_dbus_connection_call(connection, args_info->destination_arg, args_info->path_arg,
+				args_info->interface_arg, args_info->member_arg, message, NULL,
+				G_DBUS_CALL_FLAGS_NONE, args_info->reply_timeout_arg, NULL, handle_reply, call);
+	else if (!strcmp(args_info->type_arg, "signal"))
+		ret = g_dbus_connection_emit_signal(connection, NULL, args_info->path_arg,
+				args_info->interface_arg, args_info->member_arg, message, &error);
+	else {
+		reply = g_dbus_connection_call_sync(connection, args_info->destination_arg, args_info->path_arg,
+				args_info->interface_arg, args_info->member_arg, message, NULL,
+				G_DBUS_CALL_FLAGS_NONE, args_info->reply_timeout_arg, NULL, &error);
+		ret = reply != NULL;
+		if (reply) {
+			dbus_ping_driver_verify(reply);
+			g_variant_unref(reply);
+		}
+	}
+
+	if (error) {
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Send error: %s\n", error->message);
+		g_error_free(error);
+	}
+
+	g_variant_unref(message);
+
+	return ret;
+}
+
+static int backend_receive(void *connection) {
+	g_main_context_iteration(NULL, TRUE);
+
+	return 1;
+}
+
+/* the parameters and the reply are both tuples of the same type, so they serialize the same */
+static uint64_t backend_hash(void *connection, void *message) {
+	const gchar *type = g_variant_get_type_string(message);
+
+	return hash64(g_variant_get_data(message), g_variant_get_size(message), hash64(type, strlen(type), 0));
+}
+
+static const struct dbus_ping_backend gdbus_backend = {
+	.name = "gdbus",
+	.connect = backend_connect,
+	.disconnect = backend_disconnect,
+	.build = backend_build,
+	.duplicate = backend_duplicate,
+	.free_message = backend_free_message,
+	.send = backend_send,
+	.receive = backend_receive,
+	.hash = backend_hash,
+};
+
+/* GDBus first, the libdbus backend runs the very same workload for comparison */
+static const struct dbus_ping_backend * const backends[] = {
+	&gdbus_backend,
+	&libdbus_backend,
+	NULL
+};
+
+int main(int argc, char *argv[]) {
+	struct gengetopt_args_info args_info;
+	const struct dbus_ping_backend *backend;
+	void *state, *template;
+	long int count;
+
+	if (cmdline_parser(argc, argv, &args_info) != 0)
+		return -1;
+
+	assert_error(args_info.member_given, "'--member' ('-m') option required");
+	dbus_ping_driver_reject_modes(&args_info);
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+	g_type_init();
+#endif
+
+	backend = dbus_ping_backend_find(backends, &args_info);
+	assert_error(backend != NULL, "Backend '%s' is not built into " CMDLINE_PARSER_PACKAGE "-gdbus",
+			args_info.backend_arg);
+
+	state = backend->connect(&args_info);
+	template = backend->build(state, &args_info);
+
+	if (args_info.verbose_given && backend == &gdbus_backend) {
+		gchar *text = g_variant_print(template, TRUE);
+
+		fprintf(stderr, "%s\n", text);
+		g_free(text);
+	}
+
+	count = dbus_ping_driver_run(backend, state, &args_info, template);
+	/* a failed call was sent but nothing came back */
+	dbus_ping_driver_show_summary("DBUS_PING_GDBUS", backend, state, count + dbus_ping_driver_failures(), count, &args_info);
+
+	backend->free_message(state, template);
+	backend->disconnect(state);
+
+	return dbus_ping_driver_mismatches() || dbus_ping_driver_failures() ? -1 : 0;
+}
@@ -0,0 +1,663 @@
+/*
+ *
+ * dbus-ping-libdbus.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-ping-libdbus.h"
+#include "dbus-ping-marshal.h"
+#include "dbus-ping-typed.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef union {
+	dbus_int16_t i16;
+	dbus_uint16_t u16;
+	dbus_int32_t i32;
+	dbus_uint32_t u32;
+	dbus_int64_t i64;
+	dbus_uint64_t u64;
+	double dbl;
+	unsigned char byt;
+	char *str;
+} DBusBasicValue;
+
+
+struct send_pool {
+	DBusPreallocatedSend **items;
+	int count;
+	int size;
+};
+
+struct libdbus_backend {
+	DBusConnection *connection;
+	struct send_pool send_pool;
+	/* set when --clone goes through a generated marshaler */
+	const struct typed_marshaler *marshaler;
+	void *typed_contents;
+};
+
+
+static void append_arg(DBusMessageIter *iter, int type, const char *value) {
+	dbus_uint16_t uint16;
+	dbus_int16_t int16;
+	dbus_uint32_t uint32;
+	dbus_int32_t int32;
+	dbus_uint64_t uint64;
+	dbus_int64_t int64;
+	double d;
+	unsigned char byte;
+	dbus_bool_t v_BOOLEAN;
+
+	/* FIXME - we are ignoring OOM returns on all these functions */
+	switch (type) {
+	case DBUS_TYPE_BYTE:
+		byte = strtoul(value, NULL, 0);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_BYTE, &byte);
+		break;
+
+	case DBUS_TYPE_DOUBLE:
+		d = strtod(value, NULL);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_DOUBLE, &d);
+		break;
+
+	case DBUS_TYPE_INT16:
+		int16 = strtol(value, NULL, 0);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_INT16, &int16);
+		break;
+
+	case DBUS_TYPE_UINT16:
+		uint16 = strtoul(value, NULL, 0);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT16, &uint16);
+		break;
+
+	case DBUS_TYPE_INT32:
+		int32 = strtol(value, NULL, 0);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_INT32, &int32);
+		break;
+
+	case DBUS_TYPE_UINT32:
+		uint32 = strtoul(value, NULL, 0);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32, &uint32);
+		break;
+
+	case DBUS_TYPE_INT64:
+		int64 = strtoll(value, NULL, 0);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_INT64, &int64);
+		break;
+
+	case DBUS_TYPE_UINT64:
+		uint64 = strtoull(value, NULL, 0);
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &uint64);
+		break;
+
+	case DBUS_TYPE_STRING:
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &value);
+		break;
+
+	case DBUS_TYPE_OBJECT_PATH:
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_OBJECT_PATH, &value);
+		break;
+
+	case DBUS_TYPE_BOOLEAN:
+		assert_error(!strcmp(value, "true") || !strcmp(value, "false"),
+				"Expected 'true' or 'false' instead of '%s'", value);
+		v_BOOLEAN = !strcmp(value, "true") ? TRUE : FALSE;
+		dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN, &v_BOOLEAN);
+		break;
+
+	default:
+		assert_error(FALSE, "Unsupported data type %c", (char) type);
+		break;
+	}
+}
+
+static void append_array(DBusMessageIter *iter, int type, const char *value) {
+	const char *val;
+	char *dupval = strdup(value);
+
+	val = strtok(dupval, ",");
+	while (val != NULL) {
+		append_arg(iter, type, val);
+		val = strtok(NULL, ",");
+	}
+	free(dupval);
+}
+
+static void append_struct(DBusMessageIter *iter, char *expr) {
+	while (*expr != '\0') {
+		int type = type_from_name(get_next_data_item(&expr));
+		const char *value = *expr != '\0' ? get_next_data_item(&expr) : "";
+
+		append_arg(iter, type, value);
+	}
+}
+
+static void append_dict(DBusMessageIter *iter, int keytype, int valtype, const char *value) {
+	const char *val;
+	char *dupval = strdup(value);
+
+	val = strtok(dupval, ",");
+	while (val != NULL) {
+		DBusMessageIter subiter;
+
+		dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL, &subiter);
+
+		append_arg(&subiter, keytype, val);
+		val = strtok(NULL, ",");
+		assert_error(val != NULL, "Malformed dictionary");
+		append_arg(&subiter, valtype, val);
+
+		dbus_message_iter_close_container(iter, &subiter);
+		val = strtok(NULL, ",");
+	}
+	free(dupval);
+}
+
+void message_append_args(DBusMessageIter *iter, DBusMessageIter *append_iter) {
+	do {
+		int type = dbus_message_iter_get_arg_type(iter);
+		if (type == DBUS_TYPE_INVALID)
+			break;
+
+		if (dbus_type_is_basic(type)) {
+			DBusBasicValue value;
+
+			dbus_message_iter_get_basic(iter, &value);
+			dbus_message_iter_append_basic(append_iter, type, &value);
+
+		} else { // container type
+			char *signature = NULL;
+			DBusMessageIter subiter, append_subiter;
+
+			dbus_message_iter_recurse (iter, &subiter);
+			if (type != DBUS_TYPE_DICT_ENTRY && type != DBUS_TYPE_STRUCT)
+				signature = dbus_message_iter_get_signature(&subiter);
+			dbus_message_iter_open_container(append_iter, type, signature, &append_subiter);
+
+			switch (type) {
+			case DBUS_TYPE_DICT_ENTRY:
+			case DBUS_TYPE_VARIANT:
+				message_append_args(&subiter, &append_subiter);
+
+				if (type == DBUS_TYPE_DICT_ENTRY) {
+					dbus_message_iter_next(&subiter);
+					message_append_args(&subiter, &append_subiter);
+				}
+				break;
+
+			default:
+				while ((type = dbus_message_iter_get_arg_type(&subiter)) != DBUS_TYPE_INVALID) {
+					message_append_args(&subiter, &append_subiter);
+					dbus_message_iter_next(&subiter);
+				}
+				break;
+			}
+
+			dbus_message_iter_close_container(append_iter, &append_subiter);
+		}
+	} while (dbus_message_iter_next(iter));
+}
+
+static DBusMessage *dbus_message_clone_header(DBusMessage *message) {
+	const int type = dbus_message_get_type(message);
+	const char *path = dbus_message_get_path(message);
+	const char *interface = dbus_message_get_interface(message);
+	const char *member = dbus_message_get_member(message);
+	const char *bus_name = (type == DBUS_MESSAGE_TYPE_METHOD_CALL) ? dbus_message_get_destination(message) : NULL;
+	DBusMessage *clone;
+
+	clone = (type == DBUS_MESSAGE_TYPE_METHOD_CALL) ?
+			dbus_message_new_method_call(bus_name, path, interface, member) :
+			dbus_message_new_signal(path, interface, member);
+	assert_error(clone != NULL, "Unable to create message clone (out of memory)");
+
+	return clone;
+}
+
+static DBusMessage *message_multiply_contents(DBusMessage *old_message, int count) {
+	DBusMessage *message = dbus_message_clone_header(old_message);
+	const char *signature = dbus_message_get_signature(old_message);
+	DBusMessageIter append_iter, append_array_iter;
+
+	dbus_message_iter_init_append(message, &append_iter);
+	dbus_message_iter_open_container(&append_iter, DBUS_TYPE_ARRAY, signature, &append_array_iter);
+
+	while (count-- > 0) {
+		DBusMessageIter iter;
+
+		dbus_message_iter_init(old_message, &iter);
+		message_append_args(&iter, &append_array_iter);
+	}
+
+	dbus_message_iter_close_container(&append_iter, &append_array_iter);
+
+	return message;
+}
+
+static DBusMessage *message_create_contents(const struct gengetopt_args_info *args_info, DBusMessage *message) {
+	int i;
+	DBusMessageIter message_iter;
+
+	dbus_message_iter_init_append(message, &message_iter);
+
+	for (i = 0; i < args_info->inputs_num; i++) {
+		/* the items are cut out of the argument in place, it has to survive for the next message */
+		char *input = strdup(args_info->inputs[i]), *arg = input;
+		int type;
+
+		assert_error(input != NULL, "Unable to copy contents (out of memory)");
+
+		type = type_from_name(get_next_data_item(&arg));
+		if (dbus_type_is_container(type)) {
+			int container_type = type;
+			DBusMessageIter container_iter;
+
+			if (container_type == DBUS_TYPE_STRUCT) {
+				dbus_message_iter_open_container(&message_iter, DBUS_TYPE_STRUCT, 0, &container_iter);
+				append_struct(&container_iter, arg);
+			} else {
+				type = arg[0] == 0 ? DBUS_TYPE_STRING : type_from_name(get_next_data_item(&arg));
+
+				if (container_type == DBUS_TYPE_DICT_ENTRY) {
+					int secondary_type = type_from_name(get_next_data_item(&arg));
+					char sig[] = { DBUS_DICT_ENTRY_BEGIN_CHAR, type, secondary_type, DBUS_DICT_ENTRY_END_CHAR, '\0' };
+
+					dbus_message_iter_open_container(&message_iter, DBUS_TYPE_ARRAY, sig, &container_iter);
+					append_dict(&container_iter, type, secondary_type, arg);
+				} else {
+					char sig[2] = { type, '\0' };
+
+					dbus_message_iter_open_container(&message_iter, container_type, sig, &container_iter);
+
+					if (container_type == DBUS_TYPE_ARRAY)
+						append_array(&container_iter, type, arg);
+					else
+						append_arg(&container_iter, type, arg);
+				}
+			}
+
+			dbus_message_iter_close_container(&message_iter, &container_iter);
+		} else
+			append_arg(&message_iter, type, arg);
+
+		free(input);
+	}
+
+	if (args_info->contents_multiply_arg > 1) {
+		DBusMessage *old_message = message;
+		message = message_multiply_contents(old_message, args_info->contents_multiply_arg);
+		dbus_message_unref(old_message);
+	}
+
+	return message;
+}
+
+DBusMessage *message_create_nocontents(const struct gengetopt_args_info *args_info) {
+    int type = DBUS_MESSAGE_TYPE_METHOD_CALL;
+    DBusMessage *message;
+
+    if (args_info->type_given) {
+        type = dbus_message_type_from_string(args_info->type_arg);
+        assert_error(type == DBUS_MESSAGE_TYPE_METHOD_CALL || type == DBUS_MESSAGE_TYPE_SIGNAL,
+                     "Message type '%s' is not supported\n",
+                     args_info->type_arg);
+    }
+
+    message = (type == DBUS_MESSAGE_TYPE_METHOD_CALL) ?
+                    dbus_message_new_method_call(
+                                    args_info->destination_arg,
+                                    args_info->path_arg,
+                                    args_info->interface_arg,
+                                    args_info->member_arg) :
+                    dbus_message_new_signal(args_info->path_arg, args_info->interface_arg, args_info->member_arg);
+    assert_error(message != NULL, "Unable to allocate message (out of memory)");
+
+    return message;
+}
+
+DBusMessage *message_create(const struct gengetopt_args_info *args_info) {
+    DBusMessage* message = message_create_nocontents(args_info);
+	return message_create_contents(args_info, message);
+}
+
+DBusConnection *dbus_connect(const struct gengetopt_args_info *args_info, dbus_bool_t private) {
+	DBusBusType type = args_info->system_given ? DBUS_BUS_SYSTEM : DBUS_BUS_SESSION;
+	DBusConnection *connection;
+	DBusError error;
+
+	dbus_error_init (&error);
+
+	if (private)
+		connection = args_info->address_given ?
+				dbus_connection_open_private(args_info->address_arg, &error) :
+				dbus_bus_get_private(type, &error);
+	else
+		connection = args_info->address_given ?
+				dbus_connection_open(args_info->address_arg, &error) :
+				dbus_bus_get(type, &error);
+	assert_error(!dbus_error_is_set(&error), "Failed to open connection to '%s' message bus: %s",
+			args_info->address_given ? args_info->address_arg : (type == DBUS_BUS_SYSTEM) ? "system" : "session",
+			error.message);
+
+	/* a peer has no bus driver to say Hello to */
+	if (!args_info->p2p_given)
+		assert_error(dbus_bus_register(connection, &error), "Unable to register bus connection");
+
+	return connection;
+}
+
+static void send_pool_init(struct send_pool *send_pool, int size) {
+	send_pool->items = calloc(size, sizeof(*send_pool->items));
+	assert_error(send_pool->items != NULL, "Unable to allocate send pool (out of memory)");
+	send_pool->size = size;
+}
+
+static void send_pool_refill(struct send_pool *send_pool, DBusConnection *connection) {
+	while (send_pool->count < send_pool->size) {
+		DBusPreallocatedSend *preallocated = dbus_connection_preallocate_send(connection);
+
+		assert_error(preallocated != NULL, "Unable to preallocate send (out of memory)");
+		send_pool->items[send_pool->count++] = preallocated;
+	}
+}
+
+static void send_pool_free(struct send_pool *send_pool, DBusConnection *connection) {
+	while (send_pool->count > 0)
+		dbus_connection_free_preallocated_send(connection, send_pool->items[--send_pool->count]);
+
+	free(send_pool->items);
+}
+
+/*
+ * Same as dbus_connection_send_with_reply_and_block(), but without the pending
+ * call and its timeout, which are allocated for every message.
+ */
+static DBusMessage *send_preallocated_with_reply_and_block(struct send_pool *send_pool, DBusConnection *connection,
+                                                           DBusMessage *message, int timeout_milliseconds,
+                                                           DBusError *error) {
+	usec_t deadline = timeout_milliseconds >= 0 ?
+			time_now(CLOCK_MONOTONIC) + (usec_t) timeout_milliseconds * USEC_PER_MSEC : 0;
+	dbus_uint32_t serial;
+
+	assert_error(send_pool->count > 0, "Send pool is empty");
+	dbus_connection_send_preallocated(connection, send_pool->items[--send_pool->count], message, &serial);
+
+	for (;;) {
+		DBusMessage *reply;
+		int timeout = -1;
+
+		while ((reply = dbus_connection_pop_message(connection)) != NULL) {
+			if (dbus_message_get_reply_serial(reply) == serial) {
+				if (dbus_set_error_from_message(error, reply)) {
+					dbus_message_unref(reply);
+					return NULL;
+				}
+				return reply;
+			}
+
+			/* e.g. NameAcquired */
+			dbus_message_unref(reply);
+		}
+
+		if (deadline) {
+			usec_t now = time_now(CLOCK_MONOTONIC);
+
+			if (now >= deadline) {
+				dbus_set_error(error, DBUS_ERROR_NO_REPLY, "Did not receive a reply in time");
+				return NULL;
+			}
+			timeout = (deadline - now + USEC_PER_MSEC - 1) / USEC_PER_MSEC;
+		}
+
+		if (!dbus_connection_read_write(connection, timeout)) {
+			dbus_set_error(error, DBUS_ERROR_DISCONNECTED, "Connection was disconnected");
+			return NULL;
+		}
+	}
+}
+
+DBusMessage *dbus_message_clone(const struct gengetopt_args_info *args_info, DBusMessage *message) {
+	DBusMessage *clone = message_create_nocontents(args_info);
+	DBusMessageIter iter, append_iter;
+
+    if (args_info->inputs_num) {
+        dbus_message_iter_init(message, &iter);
+        dbus_message_iter_init_append(clone, &append_iter);
+
+        message_append_args(&iter, &append_iter);
+    }
+
+	return clone;
+}
+
+static void *backend_connect(const struct gengetopt_args_info *args_info) {
+	struct libdbus_backend *backend = calloc(1, sizeof(*backend));
+
+	assert_error(backend != NULL, "Unable to allocate backend (out of memory)");
+	backend->connection = dbus_connect(args_info, FALSE);
+
+	if (args_info->preallocate_arg > 0) {
+		assert_error(args_info->window_arg == 1, "'--preallocate' can't be combined with '--window'");
+		send_pool_init(&backend->send_pool, args_info->preallocate_arg);
+		send_pool_refill(&backend->send_pool, backend->connection);
+	}
+
+	return backend;
+}
+
+static void backend_disconnect(void *data) {
+	struct libdbus_backend *backend = data;
+
+	if (backend->send_pool.size > 0)
+		send_pool_free(&backend->send_pool, backend->connection);
+
+	if (backend->marshaler) {
+		backend->marshaler->free(backend->typed_contents);
+		free(backend->typed_contents);
+	}
+
+	dbus_connection_unref(backend->connection);
+	free(backend);
+}
+
+DBusConnection *libdbus_backend_get_connection(void *data) {
+	struct libdbus_backend *backend = data;
+
+	return backend->connection;
+}
+
+/* --clone without the type switch: the template's arguments are read into a struct once and appended from there */
+static DBusMessage *dbus_message_clone_typed(struct libdbus_backend *backend, const struct gengetopt_args_info *args_info) {
+	DBusMessage *clone = message_create_nocontents(args_info);
+	DBusMessageIter append_iter;
+
+	dbus_message_iter_init_append(clone, &append_iter);
+	backend->marshaler->append(&append_iter, backend->typed_contents);
+
+	return clone;
+}
+
+static void *backend_build(void *data, const struct gengetopt_args_info *args_info) {
+	struct libdbus_backend *backend = data;
+	DBusMessage *template = message_create(args_info);
+	DBusMessageIter iter;
+
+	/* --clone goes through a generated marshaler if there is one for the CONTENTS */
+	if (!args_info->clone_given || args_info->generic_marshal_given)
+		return template;
+
+	backend->marshaler = typed_marshaler_find(dbus_message_get_signature(template));
+	if (backend->marshaler) {
+		backend->typed_contents = calloc(1, backend->marshaler->size);
+		assert_error(backend->typed_contents != NULL, "Unable to allocate message contents (out of memory)");
+
+		dbus_message_iter_init(template, &iter);
+		backend->marshaler->read(&iter, backend->typed_contents);
+	}
+
+	return template;
+}
+
+static void *backend_duplicate(void *data, const struct gengetopt_args_info *args_info, void *template) {
+	struct libdbus_backend *backend = data;
+
+	if (!args_info->clone_given)
+		return dbus_message_copy(template);
+
+	return backend->marshaler ? dbus_message_clone_typed(backend, args_info) : dbus_message_clone(args_info, template);
+}
+
+static void backend_free_message(void *data, void *message) {
+	dbus_message_unref(message);
+}
+
+static void handle_reply(DBusPendingCall *pending, void *data) {
+	DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+	dbus_ping_call_complete(data, reply && dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_ERROR);
+
+	if (reply) {
+		dbus_ping_driver_verify(reply);
+		dbus_message_unref(reply);
+	}
+	dbus_pending_call_unref(pending);
+}
+
+static int send_async(struct libdbus_backend *backend, const struct gengetopt_args_info *args_info,
+                      DBusMessage *message, struct dbus_ping_call *call) {
+	DBusPendingCall *pending = NULL;
+
+	if (!dbus_connection_send_with_reply(backend->connection, message, &pending, args_info->reply_timeout_arg) ||
+	    !pending) {
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Send error: out of memory or disconnected\n");
+		dbus_message_unref(message);
+		return 0;
+	}
+
+	/* the reply may have been read already, the notify function is then called right away */
+	assert_error(dbus_pending_call_set_notify(pending, handle_reply, call, NULL),
+			"Unable to set reply handler (out of memory)");
+	dbus_message_unref(message);
+
+	return 1;
+}
+
+static int backend_send(void *data, const struct gengetopt_args_info *args_info, void *message,
+                        struct dbus_ping_call *call) {
+	struct libdbus_backend *backend = data;
+	struct send_pool *send_pool = &backend->send_pool;
+	int ret = 1;
+	DBusMessage *reply;
+	DBusError error;
+
+	dbus_message_set_auto_start(message, TRUE);
+
+	if (call)
+		return send_async(backend, args_info, message, call);
+
+	dbus_error_init(&error);
+
+    reply = send_pool->size > 0 ?
+            send_preallocated_with_reply_and_block(send_pool, backend->connection, message,
+                                                   args_info->reply_timeout_arg, &error) :
+            dbus_connection_send_with_reply_and_block(backend->connection, message,
+                                                      args_info->reply_timeout_arg, &error);
+    if (dbus_error_is_set(&error)) {
+        fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Send error %s: %s\n", error.name, error.message);
+        dbus_error_free(&error);
+        ret = 0;
+    }
+
+	if (reply) {
+		dbus_ping_driver_verify(reply);
+		dbus_message_unref(reply);
+	}
+
+	dbus_message_unref(message);
+
+	return ret;
+}
+
+static int backend_receive(void *data) {
+	struct libdbus_backend *backend = data;
+
+	return dbus_connection_read_write_dispatch(backend->connection, -1);
+}
+
+/*
+ * The marshaled body is the same bytes in the call and in its echo, whatever
+ * the header says. One copy of the message, then XXH64 over the body.
+ */
+static uint64_t backend_hash(void *data, void *message) {
+	const char *signature = dbus_message_get_signature(message);
+	const char *body;
+	int body_length;
+	char *blob;
+	uint64_t hash;
+
+	blob = message_marshal_body(message, &body, &body_length);
+	assert_error(blob != NULL, "Unable to marshal message (out of memory)");
+
+	hash = hash64(body, body_length, hash64(signature, strlen(signature), 0));
+	dbus_free(blob);
+
+	return hash;
+}
+
+/* called outside of the timed section, so no allocation is left in the send path */
+static void backend_prepare(void *data) {
+	struct libdbus_backend *backend = data;
+
+	if (backend->send_pool.size > 0)
+		send_pool_refill(&backend->send_pool, backend->connection);
+}
+
+static void backend_show_summary(void *data, const char *prefix, const struct gengetopt_args_info *args_info) {
+	struct libdbus_backend *backend = data;
+
+	const char *marshal = !args_info->clone_given ? "copy" : backend->marshaler ? "typed" : "generic";
+
+	if (args_info->bash_given)
+		printf("%1$s_PREALLOCATE=%2$d;\n"
+				"%1$s_MARSHAL=%3$s;\n",
+				prefix, backend->send_pool.size, marshal);
+
+	if (!args_info->bash_given || args_info->verbose_given)
+		fprintf(args_info->bash_given ? stderr : stdout,
+				"preallocate marshal\n"
+				"%-11d %s\n",
+				backend->send_pool.size, marshal);
+}
+
+const struct dbus_ping_backend libdbus_backend = {
+	.name = "libdbus",
+	.connect = backend_connect,
+	.disconnect = backend_disconnect,
+	.build = backend_build,
+	.duplicate = backend_duplicate,
+	.free_message = backend_free_message,
+	.send = backend_send,
+	.receive = backend_receive,
+	.hash = backend_hash,
+	.prepare = backend_prepare,
+	.show_summary = backend_show_summary,
+};
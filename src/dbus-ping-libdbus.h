@@ -0,0 +1,46 @@
+/*
+ *
+ * dbus-ping-libdbus.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_LIBDBUS_H_
+#define DBUS_PING_LIBDBUS_H_
+
+#include <dbus/dbus.h>
+
+#include "dbus-ping-driver.h"
+
+
+/* the backend's state is the connection of --session, --system or --address */
+extern const struct dbus_ping_backend libdbus_backend;
+
+DBusConnection *libdbus_backend_get_connection(void *backend);
+
+DBusConnection *dbus_connect(const struct gengetopt_args_info *args_info, dbus_bool_t private);
+
+/* a method call or signal as given by --type, --destination, --path etc. */
+DBusMessage *message_create_nocontents(const struct gengetopt_args_info *args_info);
+/* the same with the CONTENTS arguments, repeated --contents-multiply times */
+DBusMessage *message_create(const struct gengetopt_args_info *args_info);
+void message_append_args(DBusMessageIter *iter, DBusMessageIter *append_iter);
+/* what --clone sends: a fresh message with the arguments of the template appended one by one */
+DBusMessage *dbus_message_clone(const struct gengetopt_args_info *args_info, DBusMessage *message);
+
+#endif /* DBUS_PING_LIBDBUS_H_ */
@@ -0,0 +1,43 @@
+/*
+ *
+ * dbus-ping-marshal.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_MARSHAL_H_
+#define DBUS_PING_MARSHAL_H_
+
+#include <dbus/dbus.h>
+
+
+/*
+ * Marshals the message and locates the body inside the returned blob, which
+ * must be released with dbus_free().
+ */
+char *message_marshal_body(DBusMessage *message, const char **body, int *body_length);
+
+/*
+ * Builds the method return for a call by writing a fresh header right in front
+ * of the call's marshaled body, in the same buffer. The arguments are not
+ * iterated, but libdbus validates them again while demarshaling the result.
+ * The reply carries the given serial, which libdbus keeps when sending it.
+ */
+DBusMessage *message_new_method_return_with_body(DBusMessage *method_call, dbus_uint32_t serial);
+
+#endif /* DBUS_PING_MARSHAL_H_ */
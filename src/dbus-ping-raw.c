@@ -0,0 +1,152 @@
+/*
+ *
+ * dbus-ping-raw.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-ping-raw.h"
+#include "dbus-ping-common.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#define ECHO_BUFFER_SIZE	65536
+
+
+struct raw_peer {
+	int fd;
+	pid_t pid;
+	char *buffer;
+	int buffer_size;
+};
+
+
+static int write_all(int fd, const char *data, int length) {
+	while (length > 0) {
+		ssize_t n = write(fd, data, length);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+
+		data += n;
+		length -= n;
+	}
+
+	return 1;
+}
+
+static void run_echo(int fd) {
+	char buffer[ECHO_BUFFER_SIZE];
+	ssize_t n;
+
+	for (;;) {
+		n = read(fd, buffer, sizeof(buffer));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0 || !write_all(fd, buffer, n))
+			break;
+	}
+
+	close(fd);
+	_exit(0);
+}
+
+struct raw_peer *raw_peer_start(void) {
+	struct raw_peer *peer;
+	int fds[2];
+
+	peer = calloc(1, sizeof(*peer));
+	assert_error(peer != NULL, "Unable to allocate raw peer (out of memory)");
+
+	assert_error(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0,
+			"Unable to create socketpair: %s", strerror(errno));
+
+	peer->pid = fork();
+	assert_error(peer->pid >= 0, "Unable to fork echo peer: %s", strerror(errno));
+
+	if (!peer->pid) {
+		close(fds[0]);
+		run_echo(fds[1]);
+	}
+
+	close(fds[1]);
+	peer->fd = fds[0];
+
+	return peer;
+}
+
+void raw_peer_stop(struct raw_peer *peer) {
+	/* the peer exits on end of file */
+	close(peer->fd);
+	while (waitpid(peer->pid, NULL, 0) < 0 && errno == EINTR)
+		;
+
+	free(peer->buffer);
+	free(peer);
+}
+
+int raw_peer_ping(struct raw_peer *peer, const char *data, int length) {
+	struct pollfd pfd = { .fd = peer->fd, .events = POLLIN | POLLOUT };
+	int sent = 0, received = 0;
+	ssize_t n;
+
+	if (peer->buffer_size < length) {
+		free(peer->buffer);
+		peer->buffer = malloc(length);
+		assert_error(peer->buffer != NULL, "Unable to allocate raw peer buffer (out of memory)");
+		peer->buffer_size = length;
+	}
+
+	/* large messages don't fit into the socket buffers, the echo is read while writing */
+	while (received < length) {
+		int progress = 0;
+
+		if (sent < length) {
+			n = send(peer->fd, data + sent, length - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (n < 0 && errno != EAGAIN && errno != EINTR)
+				return 0;
+			if (n > 0) {
+				sent += n;
+				progress = 1;
+			}
+		}
+
+		/* blocks once everything is written */
+		n = recv(peer->fd, peer->buffer + received, length - received, sent < length ? MSG_DONTWAIT : 0);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+			return 0;
+		if (n > 0) {
+			received += n;
+			progress = 1;
+		}
+
+		if (!progress && sent < length && poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			return 0;
+	}
+
+	return 1;
+}
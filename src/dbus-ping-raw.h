@@ -0,0 +1,40 @@
+/*
+ *
+ * dbus-ping-raw.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_RAW_H_
+#define DBUS_PING_RAW_H_
+
+
+struct raw_peer;
+
+/*
+ * Forks a peer that echoes everything it reads from its end of a Unix stream
+ * socketpair, the same kind of socket the unix: transport uses. There is no
+ * framing, no authentication and nobody in between.
+ */
+struct raw_peer *raw_peer_start(void);
+void raw_peer_stop(struct raw_peer *peer);
+
+/* Writes length bytes and waits until they came back, returns 0 on failure */
+int raw_peer_ping(struct raw_peer *peer, const char *data, int length);
+
+#endif /* DBUS_PING_RAW_H_ */
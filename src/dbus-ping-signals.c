@@ -0,0 +1,303 @@
+/*
+ *
+ * dbus-ping-signals.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-ping-signals.h"
+#include "dbus-ping-common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifndef DBUS_TIMEOUT_INFINITE
+#define DBUS_TIMEOUT_INFINITE		((int) 0x7fffffff)
+#endif
+
+/* how long the subscribers wait for stragglers once the service is done emitting */
+#define SUBSCRIBER_IDLE_TIMEOUT		(2 * USEC_PER_SEC)
+#define SUBSCRIBER_POLL_TIMEOUT		100	/* msec */
+
+
+struct subscriber {
+	DBusConnection *connection;
+	pthread_t thread;
+
+	/* by sequence number, 0 for the signals that never arrived */
+	usec_t *receive_times;
+	unsigned long received;
+	usec_t last_receive_time;
+	struct histogram latency;
+};
+
+
+static unsigned long signal_count;
+static usec_t emission_end_time;
+
+
+static DBusConnection *subscriber_connect(const struct gengetopt_args_info *args_info) {
+	DBusBusType type = args_info->system_given ? DBUS_BUS_SYSTEM : DBUS_BUS_SESSION;
+	DBusConnection *connection;
+	DBusError error;
+
+	dbus_error_init(&error);
+
+	/* a shared connection would be the same for all subscribers */
+	connection = args_info->address_given ?
+			dbus_connection_open_private(args_info->address_arg, &error) :
+			dbus_bus_get_private(type, &error);
+	assert_error(!dbus_error_is_set(&error), "Failed to open subscriber connection: %s", error.message);
+
+	dbus_connection_set_exit_on_disconnect(connection, FALSE);
+	if (args_info->address_given)
+		assert_error(dbus_bus_register(connection, &error), "Unable to register subscriber connection");
+
+	return connection;
+}
+
+static void subscriber_add_match(struct subscriber *subscriber, const struct gengetopt_args_info *args_info) {
+	char rule[1024];
+	DBusError error;
+
+	snprintf(rule, sizeof(rule), "type='signal',interface='%s',member='%s',path='%s'%s%s%s",
+			TEST_SIGNAL_INTERFACE, TEST_SIGNAL_MEMBER, args_info->path_arg,
+			args_info->destination_arg ? ",sender='" : "",
+			args_info->destination_arg ? args_info->destination_arg : "",
+			args_info->destination_arg ? "'" : "");
+
+	dbus_error_init(&error);
+	dbus_bus_add_match(subscriber->connection, rule, &error);
+	assert_error(!dbus_error_is_set(&error), "Unable to add match rule '%s': %s", rule, error.message);
+}
+
+static void subscriber_receive(struct subscriber *subscriber, DBusMessage *message) {
+	usec_t now = time_now(CLOCK_MONOTONIC);
+	dbus_uint32_t sequence;
+	dbus_uint64_t time;
+
+	if (!dbus_message_is_signal(message, TEST_SIGNAL_INTERFACE, TEST_SIGNAL_MEMBER) ||
+	    !dbus_message_get_args(message, NULL, DBUS_TYPE_UINT32, &sequence, DBUS_TYPE_UINT64, &time,
+	                           DBUS_TYPE_INVALID))
+		return;
+
+	/* the service stamps the signals with the same monotonic clock */
+	histogram_add(&subscriber->latency, now > time ? now - time : 0);
+
+	if (sequence < signal_count && !subscriber->receive_times[sequence]) {
+		subscriber->receive_times[sequence] = now;
+		subscriber->received++;
+		subscriber->last_receive_time = now;
+	}
+}
+
+static void *subscriber_run(void *data) {
+	struct subscriber *subscriber = data;
+
+	while (subscriber->received < signal_count) {
+		DBusMessage *message;
+		usec_t end_time;
+
+		while ((message = dbus_connection_pop_message(subscriber->connection)) != NULL) {
+			subscriber_receive(subscriber, message);
+			dbus_message_unref(message);
+		}
+
+		end_time = __atomic_load_n(&emission_end_time, __ATOMIC_ACQUIRE);
+		if (end_time) {
+			usec_t idle_since = subscriber->last_receive_time > end_time ? subscriber->last_receive_time : end_time;
+
+			if (time_now(CLOCK_MONOTONIC) - idle_since >= SUBSCRIBER_IDLE_TIMEOUT)
+				break;
+		}
+
+		if (!dbus_connection_read_write(subscriber->connection, SUBSCRIBER_POLL_TIMEOUT))
+			break;
+	}
+
+	return NULL;
+}
+
+static void show_summary(struct subscriber *subscribers, int count, dbus_uint32_t emitted,
+                         usec_t start_time, const struct gengetopt_args_info *args_info) {
+	FILE *out = args_info->bash_given ? stderr : stdout;
+	struct histogram latency, skew;
+	unsigned long delivered = 0, lost;
+	usec_t last_receive_time = 0;
+	/* what is printed, usec_t is only unsigned long on 64 bit */
+	unsigned long long emit_time = emission_end_time - start_time, delivery_time;
+	unsigned long long delivered_per_sec, slowest_p99 = 0;
+	unsigned long long latency_p50, latency_p99, skew_p50, skew_p99;
+	unsigned long sequence;
+	int i;
+
+	memset(&latency, 0, sizeof(latency));
+	memset(&skew, 0, sizeof(skew));
+
+	for (i = 0; i < count; i++) {
+		usec_t p99 = histogram_percentile(&subscribers[i].latency, 99.0);
+
+		histogram_merge(&latency, &subscribers[i].latency);
+		delivered += subscribers[i].received;
+
+		if (subscribers[i].last_receive_time > last_receive_time)
+			last_receive_time = subscribers[i].last_receive_time;
+		if (p99 > slowest_p99)
+			slowest_p99 = p99;
+	}
+
+	/* how far apart the first and the last subscriber saw the same signal */
+	for (sequence = 0; sequence < emitted && sequence < signal_count; sequence++) {
+		usec_t first = 0, last = 0;
+
+		for (i = 0; i < count; i++) {
+			usec_t time = subscribers[i].receive_times[sequence];
+
+			if (!time)
+				continue;
+			if (!first || time < first)
+				first = time;
+			if (time > last)
+				last = time;
+		}
+
+		if (first)
+			histogram_add(&skew, last - first);
+	}
+
+	lost = (unsigned long) emitted * count - delivered;
+	delivery_time = last_receive_time > start_time ? last_receive_time - start_time : 0;
+	delivered_per_sec = delivery_time > 0 ? USEC_PER_SEC * delivered / delivery_time : 0;
+
+	latency_p50 = histogram_percentile(&latency, 50.0);
+	latency_p99 = histogram_percentile(&latency, 99.0);
+	skew_p50 = histogram_percentile(&skew, 50.0);
+	skew_p99 = histogram_percentile(&skew, 99.0);
+
+	if (args_info->bash_given)
+		printf("DBUS_PING_SUBSCRIBERS=%d;\n"
+				"DBUS_PING_MATCH_RULES=%d;\n"
+				"DBUS_PING_SIGNALS_EMITTED=%u;\n"
+				"DBUS_PING_SIGNALS_DELIVERED=%lu;\n"
+				"DBUS_PING_SIGNALS_LOST=%lu;\n"
+				"DBUS_PING_EMIT_TIME=%llu;\n"
+				"DBUS_PING_DELIVERY_TIME=%llu;\n"
+				"DBUS_PING_DELIVERED_PER_SEC=%llu;\n"
+				"DBUS_PING_SIGNAL_LATENCY_P50=%llu;\n"
+				"DBUS_PING_SIGNAL_LATENCY_P99=%llu;\n"
+				"DBUS_PING_SIGNAL_LATENCY_MAX=%llu;\n"
+				"DBUS_PING_SLOWEST_SUBSCRIBER_P99=%llu;\n"
+				"DBUS_PING_SIGNAL_SKEW_P50=%llu;\n"
+				"DBUS_PING_SIGNAL_SKEW_P99=%llu;\n"
+				"DBUS_PING_SIGNAL_SKEW_MAX=%llu;\n",
+				count, args_info->match_rules_arg, emitted, delivered, lost,
+				emit_time, delivery_time, delivered_per_sec,
+				latency_p50, latency_p99, (unsigned long long) latency.max,
+				slowest_p99,
+				skew_p50, skew_p99, (unsigned long long) skew.max);
+
+	if (!args_info->bash_given || args_info->verbose_given) {
+		fprintf(out,
+				"subscribers  emitted    delivered  lost       "
+				"emit time (usec)  delivery time (usec)  delivered/sec\n"
+				"%-12d %-10u %-10lu %-10lu %-17llu %-21llu %llu\n",
+				count, emitted, delivered, lost, emit_time, delivery_time, delivered_per_sec);
+
+		fprintf(out,
+				"             p50          p99          max (usec)\n"
+				"latency      %-12llu %-12llu %llu\n"
+				"skew         %-12llu %-12llu %llu\n",
+				latency_p50, latency_p99, (unsigned long long) latency.max,
+				skew_p50, skew_p99, (unsigned long long) skew.max);
+
+		fprintf(out, "subscriber   received   latency p50  p99          max (usec)\n");
+		for (i = 0; i < count; i++)
+			fprintf(out, "%-12d %-10lu %-12llu %-12llu %llu\n",
+					i, subscribers[i].received,
+					(unsigned long long) histogram_percentile(&subscribers[i].latency, 50.0),
+					(unsigned long long) histogram_percentile(&subscribers[i].latency, 99.0),
+					(unsigned long long) subscribers[i].latency.max);
+	}
+
+	fflush(stdout);
+}
+
+int run_signal_subscribers(DBusConnection *connection, DBusMessage *emit_message,
+                           const struct gengetopt_args_info *args_info) {
+	int timeout = args_info->reply_timeout_arg >= 0 ? args_info->reply_timeout_arg : DBUS_TIMEOUT_INFINITE;
+	int count = args_info->subscribers_arg;
+	struct subscriber *subscribers;
+	dbus_uint32_t emitted = 0;
+	DBusMessage *reply;
+	DBusError error;
+	usec_t start_time;
+	int i, ret = 0;
+
+	signal_count = args_info->count_arg;
+
+	subscribers = calloc(count, sizeof(*subscribers));
+	assert_error(subscribers != NULL, "Unable to allocate subscribers (out of memory)");
+
+	/* all match rules are in place before the first signal is emitted */
+	for (i = 0; i < count; i++) {
+		subscribers[i].receive_times = calloc(signal_count, sizeof(usec_t));
+		assert_error(subscribers[i].receive_times != NULL, "Unable to allocate subscribers (out of memory)");
+
+		subscribers[i].connection = subscriber_connect(args_info);
+		subscriber_add_match(&subscribers[i], args_info);
+	}
+
+	for (i = 0; i < count; i++)
+		assert_error(pthread_create(&subscribers[i].thread, NULL, subscriber_run, &subscribers[i]) == 0,
+				"Unable to create subscriber thread");
+
+	dbus_error_init(&error);
+	start_time = time_now(CLOCK_MONOTONIC);
+
+	reply = dbus_connection_send_with_reply_and_block(connection, emit_message, timeout, &error);
+	if (dbus_error_is_set(&error)) {
+		fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Send error %s: %s\n", error.name, error.message);
+		dbus_error_free(&error);
+		ret = -1;
+	} else {
+		if (!dbus_message_get_args(reply, &error, DBUS_TYPE_UINT32, &emitted, DBUS_TYPE_INVALID)) {
+			fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Unexpected reply: %s\n", error.message);
+			dbus_error_free(&error);
+			ret = -1;
+		}
+		dbus_message_unref(reply);
+	}
+
+	__atomic_store_n(&emission_end_time, time_now(CLOCK_MONOTONIC), __ATOMIC_RELEASE);
+
+	for (i = 0; i < count; i++)
+		pthread_join(subscribers[i].thread, NULL);
+
+	if (!ret)
+		show_summary(subscribers, count, emitted, start_time, args_info);
+
+	for (i = 0; i < count; i++) {
+		dbus_connection_close(subscribers[i].connection);
+		dbus_connection_unref(subscribers[i].connection);
+		free(subscribers[i].receive_times);
+	}
+	free(subscribers);
+
+	return ret;
+}
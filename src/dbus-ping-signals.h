@@ -0,0 +1,43 @@
+/*
+ *
+ * dbus-ping-signals.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_SIGNALS_H_
+#define DBUS_PING_SIGNALS_H_
+
+#include <dbus/dbus.h>
+
+#include "dbus-ping-cmdline.h"
+
+#define EMIT_SIGNALS_MEMBER		"EmitSignals"
+#define TEST_SIGNAL_INTERFACE	"com.bmw.Test"
+#define TEST_SIGNAL_MEMBER		"TestSignal"
+
+
+/*
+ * Opens --subscribers private connections, each with a match rule for the
+ * service's TestSignal, sends emit_message (an EmitSignals call) on the given
+ * connection and reports how the broadcast was delivered to the subscribers.
+ */
+int run_signal_subscribers(DBusConnection *connection, DBusMessage *emit_message,
+                           const struct gengetopt_args_info *args_info);
+
+#endif /* DBUS_PING_SIGNALS_H_ */
@@ -0,0 +1,341 @@
+/*
+ *
+ * dbus-ping-systemd-common.c D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-ping-systemd-common.h"
+#include "dbus-ping-common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libsystemd-bus/bus-type.h>
+
+#define MAX_SIGNATURE_SIZE	256
+
+
+union basic_value {
+	uint8_t u8;
+	int boolean;
+	int16_t s16;
+	uint16_t u16;
+	int32_t s32;
+	uint32_t u32;
+	int64_t s64;
+	uint64_t u64;
+	double d64;
+	const char *string;
+};
+
+
+static void append_arg(sd_bus_message *message, char type, const char *value) {
+	union basic_value v;
+	int r;
+
+	switch (type) {
+	case SD_BUS_TYPE_BYTE:
+		v.u8 = strtoul(value, NULL, 0);
+		break;
+	case SD_BUS_TYPE_BOOLEAN:
+		assert_error(!strcmp(value, "true") || !strcmp(value, "false"),
+				"Expected 'true' or 'false' instead of '%s'", value);
+		v.boolean = !strcmp(value, "true");
+		break;
+	case SD_BUS_TYPE_INT16:
+		v.s16 = strtol(value, NULL, 0);
+		break;
+	case SD_BUS_TYPE_UINT16:
+		v.u16 = strtoul(value, NULL, 0);
+		break;
+	case SD_BUS_TYPE_INT32:
+		v.s32 = strtol(value, NULL, 0);
+		break;
+	case SD_BUS_TYPE_UINT32:
+		v.u32 = strtoul(value, NULL, 0);
+		break;
+	case SD_BUS_TYPE_INT64:
+		v.s64 = strtoll(value, NULL, 0);
+		break;
+	case SD_BUS_TYPE_UINT64:
+		v.u64 = strtoull(value, NULL, 0);
+		break;
+	case SD_BUS_TYPE_DOUBLE:
+		v.d64 = strtod(value, NULL);
+		break;
+	case SD_BUS_TYPE_STRING:
+	case SD_BUS_TYPE_OBJECT_PATH:
+		/* sd-bus takes strings by value, everything else by reference */
+		r = sd_bus_message_append_basic(message, type, value);
+		assert_error(r >= 0, "Unable to append '%s': %s", value, strerror(-r));
+		return;
+	default:
+		assert_error(0, "Unsupported data type %c", type);
+		return;
+	}
+
+	r = sd_bus_message_append_basic(message, type, &v);
+	assert_error(r >= 0, "Unable to append '%s': %s", value, strerror(-r));
+}
+
+static void open_container(sd_bus_message *message, char type, const char *contents) {
+	int r = sd_bus_message_open_container(message, type, contents);
+	assert_error(r >= 0, "Unable to open container '%c%s': %s", type, contents, strerror(-r));
+}
+
+static void close_container(sd_bus_message *message) {
+	int r = sd_bus_message_close_container(message);
+	assert_error(r >= 0, "Unable to close container: %s", strerror(-r));
+}
+
+/* the type names of TYPE:VALUE:TYPE:VALUE..., sd-bus needs them before the first member */
+static void struct_signature(const char *expr, char *signature, size_t size) {
+	char *copy = strdup(expr), *items = copy;
+	size_t length = 0;
+
+	assert_error(copy != NULL, "Unable to parse struct (out of memory)");
+
+	while (*items != '\0') {
+		assert_error(length < size - 1, "Struct '%s' has too many members", expr);
+		signature[length++] = type_from_name(get_next_data_item(&items));
+		if (*items != '\0')
+			get_next_data_item(&items);
+	}
+
+	signature[length] = '\0';
+	free(copy);
+}
+
+static void append_struct(sd_bus_message *message, char *expr) {
+	while (*expr != '\0') {
+		char type = type_from_name(get_next_data_item(&expr));
+		const char *value = *expr != '\0' ? get_next_data_item(&expr) : "";
+
+		append_arg(message, type, value);
+	}
+}
+
+static void append_list(sd_bus_message *message, char keytype, char valtype, const char *value) {
+	char signature[] = { keytype, valtype, '\0' };
+	char *copy = strdup(value);
+	const char *val;
+
+	assert_error(copy != NULL, "Unable to parse list (out of memory)");
+
+	for (val = strtok(copy, ","); val != NULL; val = strtok(NULL, ",")) {
+		if (!valtype) {
+			append_arg(message, keytype, val);
+			continue;
+		}
+
+		open_container(message, SD_BUS_TYPE_DICT_ENTRY, signature);
+		append_arg(message, keytype, val);
+		val = strtok(NULL, ",");
+		assert_error(val != NULL, "Malformed dictionary");
+		append_arg(message, valtype, val);
+		close_container(message);
+	}
+
+	free(copy);
+}
+
+static char container_subtype(char **arg) {
+	return **arg == '\0' ? SD_BUS_TYPE_STRING : type_from_name(get_next_data_item(arg));
+}
+
+/* what the argument looks like on the wire, without appending it */
+static void input_signature(const char *input, char *signature, size_t size) {
+	char *copy = strdup(input), *arg = copy;
+	char type, subtype, contents[MAX_SIGNATURE_SIZE];
+
+	assert_error(copy != NULL, "Unable to parse contents (out of memory)");
+
+	type = type_from_name(get_next_data_item(&arg));
+
+	switch (type) {
+	case SD_BUS_TYPE_STRUCT:
+		struct_signature(arg, contents, sizeof(contents));
+		snprintf(signature, size, "(%s)", contents);
+		break;
+	case SD_BUS_TYPE_DICT_ENTRY:
+		subtype = container_subtype(&arg);
+		snprintf(signature, size, "a{%c%c}", subtype, type_from_name(get_next_data_item(&arg)));
+		break;
+	case SD_BUS_TYPE_ARRAY:
+		snprintf(signature, size, "a%c", container_subtype(&arg));
+		break;
+	default:
+		snprintf(signature, size, "%c", type);
+		break;
+	}
+
+	free(copy);
+}
+
+static void append_input(sd_bus_message *message, const char *input) {
+	char *copy = strdup(input), *arg = copy;
+	char type, keytype, subtype, contents[MAX_SIGNATURE_SIZE];
+
+	assert_error(copy != NULL, "Unable to parse contents (out of memory)");
+
+	type = type_from_name(get_next_data_item(&arg));
+
+	switch (type) {
+	case SD_BUS_TYPE_STRUCT:
+		struct_signature(arg, contents, sizeof(contents));
+		open_container(message, type, contents);
+		append_struct(message, arg);
+		close_container(message);
+		break;
+
+	case SD_BUS_TYPE_DICT_ENTRY:
+		keytype = container_subtype(&arg);
+		subtype = type_from_name(get_next_data_item(&arg));
+		snprintf(contents, sizeof(contents), "{%c%c}", keytype, subtype);
+		open_container(message, SD_BUS_TYPE_ARRAY, contents);
+		append_list(message, keytype, subtype, arg);
+		close_container(message);
+		break;
+
+	case SD_BUS_TYPE_ARRAY:
+	case SD_BUS_TYPE_VARIANT:
+		subtype = container_subtype(&arg);
+		snprintf(contents, sizeof(contents), "%c", subtype);
+		open_container(message, type, contents);
+		if (type == SD_BUS_TYPE_ARRAY)
+			append_list(message, subtype, 0, arg);
+		else
+			append_arg(message, subtype, arg);
+		close_container(message);
+		break;
+
+	default:
+		append_arg(message, type, arg);
+		break;
+	}
+
+	free(copy);
+}
+
+void systemd_message_append_contents(sd_bus_message *message, char **inputs, int inputs_num, int multiply) {
+	char signature[MAX_SIGNATURE_SIZE] = "", arg_signature[MAX_SIGNATURE_SIZE];
+	int i, j;
+
+	if (multiply <= 1) {
+		for (i = 0; i < inputs_num; i++)
+			append_input(message, inputs[i]);
+		return;
+	}
+
+	for (i = 0; i < inputs_num; i++) {
+		input_signature(inputs[i], arg_signature, sizeof(arg_signature));
+		assert_error(strlen(signature) + strlen(arg_signature) < sizeof(signature), "Contents signature too long");
+		strcat(signature, arg_signature);
+	}
+
+	open_container(message, SD_BUS_TYPE_ARRAY, signature);
+	for (j = 0; j < multiply; j++)
+		for (i = 0; i < inputs_num; i++)
+			append_input(message, inputs[i]);
+	close_container(message);
+}
+
+int systemd_message_copy_contents(sd_bus_message *message, sd_bus_message *source) {
+	const char *contents;
+	char type;
+	int r;
+
+	for (;;) {
+		r = sd_bus_message_peek_type(source, &type, &contents);
+		if (r <= 0)
+			return r;
+
+		if (bus_type_is_container(type)) {
+			r = sd_bus_message_enter_container(source, type, contents);
+			if (r < 0)
+				return r;
+
+			r = sd_bus_message_open_container(message, type, contents);
+			if (r < 0)
+				return r;
+
+			r = systemd_message_copy_contents(message, source);
+			if (r < 0)
+				return r;
+
+			r = sd_bus_message_close_container(message);
+			if (r < 0)
+				return r;
+
+			r = sd_bus_message_exit_container(source);
+			if (r < 0)
+				return r;
+		} else {
+			union basic_value v;
+
+			r = sd_bus_message_read_basic(source, type, &v);
+			if (r < 0)
+				return r;
+
+			r = sd_bus_message_append_basic(message, type,
+					bus_type_is_trivial(type) ? (const void *) &v : (const void *) v.string);
+			if (r < 0)
+				return r;
+		}
+	}
+}
+
+int systemd_message_hash_contents(sd_bus_message *message, uint64_t *hash) {
+	const char *contents;
+	char type;
+	int r;
+
+	for (;;) {
+		r = sd_bus_message_peek_type(message, &type, &contents);
+		if (r <= 0)
+			return r;
+
+		/* the type codes keep e.g. ai and (ii) with the same values apart */
+		*hash = hash64(&type, 1, *hash);
+
+		if (bus_type_is_container(type)) {
+			r = sd_bus_message_enter_container(message, type, contents);
+			if (r < 0)
+				return r;
+
+			r = systemd_message_hash_contents(message, hash);
+			if (r < 0)
+				return r;
+
+			r = sd_bus_message_exit_container(message);
+			if (r < 0)
+				return r;
+		} else {
+			union basic_value v;
+
+			memset(&v, 0, sizeof(v));
+			r = sd_bus_message_read_basic(message, type, &v);
+			if (r < 0)
+				return r;
+
+			*hash = bus_type_is_trivial(type) ? hash64(&v, sizeof(v), *hash) :
+			                                    hash64(v.string, strlen(v.string), *hash);
+		}
+	}
+}
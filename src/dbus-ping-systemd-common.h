@@ -0,0 +1,53 @@
+/*
+ *
+ * dbus-ping-systemd-common.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_SYSTEMD_COMMON_H_
+#define DBUS_PING_SYSTEMD_COMMON_H_
+
+#include <stdint.h>
+
+#include <libsystemd-bus/sd-bus.h>
+
+
+/*
+ * Appends the CONTENTS arguments of dbus-ping (TYPE:VALUE, array:TYPE:V1,V2,
+ * dict:KTYPE:VTYPE:K1,V1,..., struct:TYPE:VALUE:..., variant:TYPE:VALUE).
+ * With multiply > 1 they are repeated multiply times inside an array, just
+ * like --contents-multiply does with libdbus.
+ */
+void systemd_message_append_contents(sd_bus_message *message, char **inputs, int inputs_num, int multiply);
+
+/*
+ * Appends everything from the current read position of the sealed source
+ * message on, container by container. sd-bus has no message copy, this is
+ * the closest thing to it. Returns a negative errno on failure.
+ */
+int systemd_message_copy_contents(sd_bus_message *message, sd_bus_message *source);
+
+/*
+ * Folds everything from the current read position on into hash, value by
+ * value; sd-bus doesn't hand out the marshaled body. Returns a negative
+ * errno on failure.
+ */
+int systemd_message_hash_contents(sd_bus_message *message, uint64_t *hash);
+
+#endif /* DBUS_PING_SYSTEMD_COMMON_H_ */
@@ -32,151 +32,220 @@
 
 #include "dbus-ping-cmdline.h"
 #include "dbus-ping-common.h"
+#include "dbus-ping-driver.h"
+#include "dbus-ping-libdbus.h"
+#include "dbus-ping-systemd-common.h"
 
+/* the template is never sent, sealing it only makes it readable */
+#define TEMPLATE_SERIAL		1
 
-static usec_t start_time;
-static usec_t message_duplicate_time;
-static usec_t message_send_time;
 
-static sd_bus_message* dbus_ping_message_new(sd_bus *bus, const struct gengetopt_args_info *args_info) {
+static sd_bus_message *dbus_ping_message_new_nocontents(sd_bus *bus, const struct gengetopt_args_info *args_info) {
+	sd_bus_message *message;
 	int r;
-	sd_bus_message* message;
 
-	r = sd_bus_message_new_method_call(bus,
-			args_info->destination_arg,
-			args_info->path_arg,
-			args_info->interface_arg,
-			args_info->member_arg,
-			&message);
+	assert_error(!strcmp(args_info->type_arg, "method_call") || !strcmp(args_info->type_arg, "signal"),
+			"Message type '%s' is not supported", args_info->type_arg);
+
+	if (!strcmp(args_info->type_arg, "signal"))
+		r = sd_bus_message_new_signal(bus,
+				args_info->path_arg,
+				args_info->interface_arg,
+				args_info->member_arg,
+				&message);
+	else
+		r = sd_bus_message_new_method_call(bus,
+				args_info->destination_arg,
+				args_info->path_arg,
+				args_info->interface_arg,
+				args_info->member_arg,
+				&message);
+	assert_error(r >= 0, "Unable to allocate message: %s", strerror(-r));
 
-	if (args_info->contents_multiply_arg > 0) {
-		int i;
+	return message;
+}
 
-		if (args_info->contents_multiply_arg > 1) {
-			r = sd_bus_message_open_container(message, 'a', "(idds)");
-			assert_error(r >= 0, "OOM: sd_bus_message_open_container() failed!");
-		}
+/* rebuilt from the CONTENTS arguments, like --clone does with libdbus */
+static sd_bus_message *dbus_ping_message_new(sd_bus *bus, const struct gengetopt_args_info *args_info) {
+	sd_bus_message *message = dbus_ping_message_new_nocontents(bus, args_info);
 
-		for (i = 0; i < args_info->contents_multiply_arg; i++) {
-			r = sd_bus_message_append(message, "(idds)", 1, 12.6, 1e40, "XXXXXXXXXXXXXXXXXXXX");
-			assert_error(r >= 0, "OOM: sd_bus_message_append() failed!");
-		}
+	systemd_message_append_contents(message, args_info->inputs, args_info->inputs_num,
+			args_info->contents_multiply_arg);
 
-		if (args_info->contents_multiply_arg > 1) {
-			r = sd_bus_message_close_container(message);
-			assert_error(r >= 0, "OOM: sd_bus_message_close_container() failed!");
-		}
-	}
+	return message;
+}
+
+/* sd-bus can't copy a message, the sealed template is read back and appended instead */
+static sd_bus_message *dbus_ping_message_copy(sd_bus *bus, const struct gengetopt_args_info *args_info,
+                                              sd_bus_message *template) {
+	sd_bus_message *message = dbus_ping_message_new_nocontents(bus, args_info);
+	int r;
+
+	r = sd_bus_message_rewind(template, true);
+	assert_error(r >= 0, "Unable to rewind message: %s", strerror(-r));
+
+	r = systemd_message_copy_contents(message, template);
+	assert_error(r >= 0, "Unable to copy message: %s", strerror(-r));
 
 	return message;
 }
 
-static int dbus_ping_send_message(sd_bus *bus, const struct gengetopt_args_info *args_info) {
+static void *backend_connect(const struct gengetopt_args_info *args_info) {
+	sd_bus *bus;
 	int r;
-	usec_t time;
-	sd_bus_message *message;
-	sd_bus_message *message_reply;
-	sd_bus_error error = SD_BUS_ERROR_INIT;
 
-	message = dbus_ping_message_new(bus, args_info);
+	assert_error(!args_info->address_given && !args_info->system_given && !args_info->p2p_given
+			&& !args_info->preallocate_arg,
+			"The sd-bus backend only talks to the user bus");
+
+    r = sd_bus_open_user(&bus);
+    assert_error(r >= 0, "Failed to connect to user bus: %s", strerror(-r));
+
+	return bus;
+}
+
+static void backend_disconnect(void *bus) {
+	sd_bus_flush(bus);
+	sd_bus_unref(bus);
+}
+
+/* built once, every message sent is a copy of it unless --clone is given */
+static void *backend_build(void *bus, const struct gengetopt_args_info *args_info) {
+	sd_bus_message *template = dbus_ping_message_new(bus, args_info);
+	int r;
+
+	r = bus_message_seal(template, TEMPLATE_SERIAL);
+	assert_error(r >= 0, "Unable to seal message: %s", strerror(-r));
+
+	return template;
+}
+
+static void *backend_duplicate(void *bus, const struct gengetopt_args_info *args_info, void *template) {
+	return args_info->clone_given ? dbus_ping_message_new(bus, args_info) :
+	                                dbus_ping_message_copy(bus, args_info, template);
+}
+
+static void backend_free_message(void *bus, void *message) {
+	sd_bus_message_unref(message);
+}
+
+static int handle_reply(sd_bus *bus, int ret, sd_bus_message *reply, void *userdata) {
+	uint8_t type = 0;
+
+	dbus_ping_call_complete(userdata, ret >= 0 && reply && sd_bus_message_get_type(reply, &type) >= 0
+			&& type != SD_BUS_MESSAGE_TYPE_METHOD_ERROR);
 
-	time = time_now(CLOCK_MONOTONIC);
+	if (reply)
+		dbus_ping_driver_verify(reply);
 
-	r = sd_bus_send_with_reply_and_block(bus, message, (uint64_t) -1, &error, &message_reply);
-	if (r < 0) {
-		fprintf(stderr, "send error: %s\n", error.message);
-		sd_bus_error_free(&error);
+	return 1;
+}
+
+static int backend_send(void *bus, const struct gengetopt_args_info *args_info, void *message,
+                        struct dbus_ping_call *call) {
+	int r;
+	sd_bus_message *message_reply;
+	sd_bus_error error = SD_BUS_ERROR_INIT;
+
+	if (call) {
+		r = sd_bus_send_with_reply(bus, message, handle_reply, call, (uint64_t) -1, NULL);
+		if (r < 0)
+			fprintf(stderr, "send error: %s\n", strerror(-r));
+	} else if (!strcmp(args_info->type_arg, "signal")) {
+		r = sd_bus_send(bus, message, NULL);
+		if (r < 0)
+			fprintf(stderr, "send error: %s\n", strerror(-r));
 	} else {
-		sd_bus_message_unref(message_reply);
+		r = sd_bus_send_with_reply_and_block(bus, message, (uint64_t) -1, &error, &message_reply);
+		if (r < 0) {
+			fprintf(stderr, "send error: %s\n", error.message);
+			sd_bus_error_free(&error);
+		} else {
+			dbus_ping_driver_verify(message_reply);
+			sd_bus_message_unref(message_reply);
+		}
 	}
 
 	sd_bus_message_unref(message);
 
-	message_send_time += time_now(CLOCK_MONOTONIC) - time;
+	return r >= 0;
+}
+
+/* the template is read from the start again, a reply only once */
+static uint64_t backend_hash(void *bus, void *message) {
+	uint64_t hash = 0;
+	int r;
+
+	r = sd_bus_message_rewind(message, true);
+	assert_error(r >= 0, "Unable to rewind message: %s", strerror(-r));
 
-	return r;
+	r = systemd_message_hash_contents(message, &hash);
+	assert_error(r >= 0, "Unable to read message: %s", strerror(-r));
+
+	return hash;
 }
 
-static inline void update_progress(int count, const struct gengetopt_args_info *args_info) {
-	static usec_t last_update_time;
-	usec_t elapsed_time = time_now(CLOCK_MONOTONIC) - start_time;
+/* sd_bus_process() runs the reply callbacks, sd_bus_wait() only when there was nothing to do */
+static int backend_receive(void *bus) {
+	sd_bus_message *message = NULL;
+	int r;
 
-	if (!args_info->verbose_given)
-		return;
+	r = sd_bus_process(bus, &message);
+	if (message)
+		sd_bus_message_unref(message);
 
-	if (last_update_time > 0) {
-		if (elapsed_time - last_update_time < 2 * USEC_PER_SEC)
-			return;
+	if (r == 0)
+		r = sd_bus_wait(bus, (uint64_t) -1);
 
-		fprintf(stderr, "Sent %d message%s in %llu seconds (%llu msgs/sec, %u%% done)\n",
-				count, count != 1 ? "s" : "",
-				elapsed_time / USEC_PER_SEC,
-				elapsed_time > 0 && count > 0 ? USEC_PER_SEC / (elapsed_time / count) : 0,
-				(100 * count) / args_info->count_arg);
-	}
+	if (r < 0)
+		fprintf(stderr, "receive error: %s\n", strerror(-r));
 
-	last_update_time = elapsed_time;
+	return r >= 0;
 }
 
-static void show_summary(int sent, int received, const struct gengetopt_args_info *args_info) {
-	usec_t elapsed_time = time_now(CLOCK_MONOTONIC) - start_time;
-	usec_t elapsed_time_sec = elapsed_time / USEC_PER_SEC;
-	int total = sent + received;
-	usec_t msgs_per_sec = elapsed_time > 0 ? USEC_PER_SEC / (elapsed_time / total) : total;
-
-	if (args_info->bash_given)
-		printf("DBUS_PING_SYSTEMD_SENT=%d;\n"
-				"DBUS_PING_SYSTEMD_RECEIVED=%d;\n"
-				"DBUS_PING_SYSTEMD_TOTAL=%d;\n"
-				"DBUS_PING_SYSTEMD_TIME=%llu;\n"
-				"DBUS_PING_SYSTEMD_TIME_SEC=%llu;\n"
-				"DBUS_PING_SYSTEMD_MSGS_PER_SEC=%llu;\n"
-				"DBUS_PING_SYSTEMD_DUPLICATE_TIME=%llu;\n"
-				"DBUS_PING_SYSTEMD_SEND_TIME=%llu;\n",
-				sent, received, total,
-				elapsed_time, elapsed_time_sec,
-				msgs_per_sec,
-				message_duplicate_time,
-				message_send_time);
-
-	if (!args_info->bash_given || args_info->verbose_given)
-		fprintf(args_info->bash_given ? stderr : stdout,
-				"sent       received   total      "
-				"time (sec)   time (usec)   msgs/sec (total) "
-				"duplicate time  send time\n"
-				"%-10d %-10d %-10d "
-				"%-12llu %-13llu %-16llu "
-				"%-15llu %llu\n",
-				sent, received, total,
-				elapsed_time_sec, elapsed_time, msgs_per_sec,
-				message_duplicate_time, message_send_time);
-
-	fflush(stdout);
-}
+static const struct dbus_ping_backend systemd_backend = {
+	.name = "sd-bus",
+	.connect = backend_connect,
+	.disconnect = backend_disconnect,
+	.build = backend_build,
+	.duplicate = backend_duplicate,
+	.free_message = backend_free_message,
+	.send = backend_send,
+	.receive = backend_receive,
+	.hash = backend_hash,
+};
+
+/* sd-bus first, the libdbus backend runs the very same workload for comparison */
+static const struct dbus_ping_backend * const backends[] = {
+	&systemd_backend,
+	&libdbus_backend,
+	NULL
+};
 
 int main(int argc, char *argv[]) {
 	struct gengetopt_args_info args_info;
-	sd_bus *bus;
+	const struct dbus_ping_backend *backend;
+	void *state, *template;
 	long int count;
-	int r;
 
 	if (cmdline_parser(argc, argv, &args_info) != 0)
 		return -1;
 
-    r = sd_bus_open_user(&bus);
-    assert_error(r >= 0, "Failed to connect to user bus: %s", strerror(-r));
+	assert_error(args_info.member_given, "'--member' ('-m') option required");
+	dbus_ping_driver_reject_modes(&args_info);
 
-	start_time = time_now(CLOCK_MONOTONIC);
+	backend = dbus_ping_backend_find(backends, &args_info);
+	assert_error(backend != NULL, "Unknown backend '%s'", args_info.backend_arg);
 
-	for (count = 0; count < args_info.count_arg; count++) {
-		dbus_ping_send_message(bus, &args_info);
-		update_progress(count, &args_info);
-	}
+	state = backend->connect(&args_info);
+	template = backend->build(state, &args_info);
 
-	show_summary(count, count, &args_info);
+	count = dbus_ping_driver_run(backend, state, &args_info, template);
+	/* a failed call was sent but nothing came back */
+	dbus_ping_driver_show_summary("DBUS_PING_SYSTEMD", backend, state, count + dbus_ping_driver_failures(), count, &args_info);
 
-	sd_bus_flush(bus);
-	sd_bus_unref(bus);
+	backend->free_message(state, template);
+	backend->disconnect(state);
 
-	return 0;
+	return dbus_ping_driver_mismatches() || dbus_ping_driver_failures() ? -1 : 0;
 }
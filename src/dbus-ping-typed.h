@@ -0,0 +1,50 @@
+/*
+ *
+ * dbus-ping-typed.h D-Bus benchmarking test client
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_PING_TYPED_H_
+#define DBUS_PING_TYPED_H_
+
+#include <stddef.h>
+
+#include <dbus/dbus.h>
+
+
+/*
+ * Marshalers generated at build time by dbus-ping-codegen.py for the
+ * signatures listed in dbus-ping-typed.list. They move the arguments between
+ * a message and a plain C struct of size bytes without looking at a single
+ * type code, where message_append_args() switches on every value.
+ */
+struct typed_marshaler {
+	const char *signature;
+	size_t size;
+	/* the message must have exactly this signature; strings and arrays of fixed types point into it */
+	void (*read)(DBusMessageIter *iter, void *value);
+	void (*append)(DBusMessageIter *iter, const void *value);
+	/* releases what read allocated, not the value itself */
+	void (*free)(void *value);
+};
+
+/* NULL when none was generated for the signature */
+const struct typed_marshaler *typed_marshaler_find(const char *signature);
+
+#endif /* DBUS_PING_TYPED_H_ */
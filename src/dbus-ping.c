@@ -22,466 +22,412 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
 
 #include <dbus/dbus.h>
 
 #include "dbus-ping-cmdline.h"
+#include "dbus-ping-activation.h"
 #include "dbus-ping-common.h"
+#include "dbus-ping-connect.h"
+#include "dbus-ping-driver.h"
+#include "dbus-ping-libdbus.h"
+#include "dbus-ping-raw.h"
+#include "dbus-ping-signals.h"
 #include "dbus-print-message.h"
 
 
-typedef union {
-	dbus_int16_t i16;
-	dbus_uint16_t u16;
-	dbus_int32_t i32;
-	dbus_uint32_t u32;
-	dbus_int64_t i64;
-	dbus_uint64_t u64;
-	double dbl;
-	unsigned char byt;
-	char *str;
-} DBusBasicValue;
-
-
-static usec_t start_time;
-static usec_t message_duplicate_time;
-static usec_t message_send_time;
-
-
-static void append_arg(DBusMessageIter *iter, int type, const char *value) {
-	dbus_uint16_t uint16;
-	dbus_int16_t int16;
-	dbus_uint32_t uint32;
-	dbus_int32_t int32;
-	dbus_uint64_t uint64;
-	dbus_int64_t int64;
-	double d;
-	unsigned char byte;
-	dbus_bool_t v_BOOLEAN;
-
-	/* FIXME - we are ignoring OOM returns on all these functions */
-	switch (type) {
-	case DBUS_TYPE_BYTE:
-		byte = strtoul(value, NULL, 0);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_BYTE, &byte);
-		break;
-
-	case DBUS_TYPE_DOUBLE:
-		d = strtod(value, NULL);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_DOUBLE, &d);
-		break;
-
-	case DBUS_TYPE_INT16:
-		int16 = strtol(value, NULL, 0);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_INT16, &int16);
-		break;
-
-	case DBUS_TYPE_UINT16:
-		uint16 = strtoul(value, NULL, 0);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT16, &uint16);
-		break;
-
-	case DBUS_TYPE_INT32:
-		int32 = strtol(value, NULL, 0);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_INT32, &int32);
-		break;
-
-	case DBUS_TYPE_UINT32:
-		uint32 = strtoul(value, NULL, 0);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32, &uint32);
-		break;
-
-	case DBUS_TYPE_INT64:
-		int64 = strtoll(value, NULL, 0);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_INT64, &int64);
-		break;
-
-	case DBUS_TYPE_UINT64:
-		uint64 = strtoull(value, NULL, 0);
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &uint64);
-		break;
-
-	case DBUS_TYPE_STRING:
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &value);
-		break;
-
-	case DBUS_TYPE_OBJECT_PATH:
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_OBJECT_PATH, &value);
-		break;
-
-	case DBUS_TYPE_BOOLEAN:
-		assert_error(!strcmp(value, "true") || !strcmp(value, "false"),
-				"Expected 'true' or 'false' instead of '%s'", value);
-		v_BOOLEAN = !strcmp(value, "true") ? TRUE : FALSE;
-		dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN, &v_BOOLEAN);
-		break;
-
-	default:
-		assert_error(FALSE, "Unsupported data type %c", (char) type);
-		break;
-	}
-}
-
-static void append_array(DBusMessageIter *iter, int type, const char *value) {
-	const char *val;
-	char *dupval = strdup(value);
+/* the connections that hold the match rules, the rules go away with them */
+struct match_rules {
+	DBusConnection **connections;
+	int connection_count;
+	int count;
+};
 
-	val = strtok(dupval, ",");
-	while (val != NULL) {
-		append_arg(iter, type, val);
-		val = strtok(NULL, ",");
-	}
-	free(dupval);
-}
 
-static void append_struct(DBusMessageIter *iter, char *expr) {
-	while (*expr != '\0') {
-		int type = type_from_name(get_next_data_item(&expr));
-		const char *value = *expr != '\0' ? get_next_data_item(&expr) : "";
+/* peers the daemon has to keep track of, but which never send anything */
+struct idle_connections {
+	DBusConnection **connections;
+	int count;
+	pid_t daemon_pid;
+	long daemon_rss_before;	/* kB */
+	long daemon_rss;		/* kB */
+};
 
-		append_arg(iter, type, value);
-	}
-}
+static const struct dbus_ping_backend * const backends[] = {
+	&libdbus_backend,
+	NULL
+};
 
-static void append_dict(DBusMessageIter *iter, int keytype, int valtype, const char *value) {
-	const char *val;
-	char *dupval = strdup(value);
+static struct match_rules match_rules;
+static struct idle_connections idle_connections;
 
-	val = strtok(dupval, ",");
-	while (val != NULL) {
-		DBusMessageIter subiter;
 
-		dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL, &subiter);
+/* EmitSignals(u count, u rate, contents...), the service broadcasts the contents */
+static DBusMessage *message_create_emit_signals(const struct gengetopt_args_info *args_info,
+                                                DBusMessage *contents_message) {
+	DBusMessage *message = message_create_nocontents(args_info);
+	dbus_uint32_t count = args_info->count_arg;
+	dbus_uint32_t rate = args_info->signal_rate_arg;
+	DBusMessageIter iter, append_iter;
 
-		append_arg(&subiter, keytype, val);
-		val = strtok(NULL, ",");
-		assert_error(val != NULL, "Malformed dictionary");
-		append_arg(&subiter, valtype, val);
+	dbus_message_iter_init_append(message, &append_iter);
+	dbus_message_iter_append_basic(&append_iter, DBUS_TYPE_UINT32, &count);
+	dbus_message_iter_append_basic(&append_iter, DBUS_TYPE_UINT32, &rate);
 
-		dbus_message_iter_close_container(iter, &subiter);
-		val = strtok(NULL, ",");
-	}
-	free(dupval);
-}
+	if (dbus_message_iter_init(contents_message, &iter))
+		message_append_args(&iter, &append_iter);
 
-static void message_append_args(DBusMessageIter *iter, DBusMessageIter *append_iter) {
-	do {
-		int type = dbus_message_iter_get_arg_type(iter);
-		if (type == DBUS_TYPE_INVALID)
-			break;
-
-		if (dbus_type_is_basic(type)) {
-			DBusBasicValue value;
-
-			dbus_message_iter_get_basic(iter, &value);
-			dbus_message_iter_append_basic(append_iter, type, &value);
-
-		} else { // container type
-			char *signature = NULL;
-			DBusMessageIter subiter, append_subiter;
-
-			dbus_message_iter_recurse (iter, &subiter);
-			if (type != DBUS_TYPE_DICT_ENTRY && type != DBUS_TYPE_STRUCT)
-				signature = dbus_message_iter_get_signature(&subiter);
-			dbus_message_iter_open_container(append_iter, type, signature, &append_subiter);
-
-			switch (type) {
-			case DBUS_TYPE_DICT_ENTRY:
-			case DBUS_TYPE_VARIANT:
-				message_append_args(&subiter, &append_subiter);
-
-				if (type == DBUS_TYPE_DICT_ENTRY) {
-					dbus_message_iter_next(&subiter);
-					message_append_args(&subiter, &append_subiter);
-				}
-				break;
-
-			default:
-				while ((type = dbus_message_iter_get_arg_type(&subiter)) != DBUS_TYPE_INVALID) {
-					message_append_args(&subiter, &append_subiter);
-					dbus_message_iter_next(&subiter);
-				}
-				break;
-			}
-
-			dbus_message_iter_close_container(append_iter, &append_subiter);
-		}
-	} while (dbus_message_iter_next(iter));
+	return message;
 }
 
-static DBusMessage *dbus_message_clone_header(DBusMessage *message) {
-	const int type = dbus_message_get_type(message);
-	const char *path = dbus_message_get_path(message);
-	const char *interface = dbus_message_get_interface(message);
-	const char *member = dbus_message_get_member(message);
-	const char *bus_name = (type == DBUS_MESSAGE_TYPE_METHOD_CALL) ? dbus_message_get_destination(message) : NULL;
-	DBusMessage *clone;
+/*
+ * dbus-daemon checks every message against the rules of all connections. It
+ * only indexes them by message type and interface, so the rules without an
+ * interface are the ones that really cost. None of them matches the pings.
+ */
+static void match_rules_add(const struct gengetopt_args_info *args_info) {
+	DBusError error;
+	int i;
 
-	clone = (type == DBUS_MESSAGE_TYPE_METHOD_CALL) ?
-			dbus_message_new_method_call(bus_name, path, interface, member) :
-			dbus_message_new_signal(path, interface, member);
-	assert_error(clone != NULL, "Unable to create message clone (out of memory)");
+	match_rules.connection_count = args_info->match_connections_arg;
+	match_rules.connections = calloc(match_rules.connection_count, sizeof(*match_rules.connections));
+	assert_error(match_rules.connections != NULL, "Unable to allocate match rule connections (out of memory)");
 
-	return clone;
-}
+	for (i = 0; i < match_rules.connection_count; i++)
+		match_rules.connections[i] = dbus_connect(args_info, TRUE);
 
-static DBusMessage *message_multiply_contents(DBusMessage *old_message, int count) {
-	DBusMessage *message = dbus_message_clone_header(old_message);
-	const char *signature = dbus_message_get_signature(old_message);
-	DBusMessageIter append_iter, append_array_iter;
+	dbus_error_init(&error);
 
-	dbus_message_iter_init_append(message, &append_iter);
-	dbus_message_iter_open_container(&append_iter, DBUS_TYPE_ARRAY, signature, &append_array_iter);
+	for (i = 0; i < args_info->match_rules_arg; i++) {
+		char rule[256];
 
-	while (count-- > 0) {
-		DBusMessageIter iter;
+		switch (i % 4) {
+		case 0:
+			snprintf(rule, sizeof(rule), "interface='com.bmw.Test.Rule%d'", i);
+			break;
+		case 1:
+			snprintf(rule, sizeof(rule), "member='Rule%d'", i);
+			break;
+		case 2:
+			snprintf(rule, sizeof(rule), "arg0='dbus-ping-rule-%d'", i);
+			break;
+		default:
+			snprintf(rule, sizeof(rule), "path_namespace='/com/bmw/Rule%d'", i);
+			break;
+		}
 
-		dbus_message_iter_init(old_message, &iter);
-		message_append_args(&iter, &append_array_iter);
+		/* blocks until the daemon has the rule, none may be missing once the pings start */
+		dbus_bus_add_match(match_rules.connections[i % match_rules.connection_count], rule, &error);
+		assert_error(!dbus_error_is_set(&error), "Unable to add match rule \"%s\": %s", rule, error.message);
 	}
 
-	dbus_message_iter_close_container(&append_iter, &append_array_iter);
-
-	return message;
+	match_rules.count = args_info->match_rules_arg;
 }
 
-static DBusMessage *message_create_contents(const struct gengetopt_args_info *args_info, DBusMessage *message) {
+static void match_rules_free(void) {
 	int i;
-	DBusMessageIter message_iter;
-
-	dbus_message_iter_init_append(message, &message_iter);
-
-	for (i = 0; i < args_info->inputs_num; i++) {
-		char *arg = args_info->inputs[i];
-		int type;
-
-		type = type_from_name(get_next_data_item(&arg));
-		if (dbus_type_is_container(type)) {
-			int container_type = type;
-			DBusMessageIter container_iter;
-
-			if (container_type == DBUS_TYPE_STRUCT) {
-				dbus_message_iter_open_container(&message_iter, DBUS_TYPE_STRUCT, 0, &container_iter);
-				append_struct(&container_iter, arg);
-			} else {
-				type = arg[0] == 0 ? DBUS_TYPE_STRING : type_from_name(get_next_data_item(&arg));
-
-				if (container_type == DBUS_TYPE_DICT_ENTRY) {
-					int secondary_type = type_from_name(get_next_data_item(&arg));
-					char sig[] = { DBUS_DICT_ENTRY_BEGIN_CHAR, type, secondary_type, DBUS_DICT_ENTRY_END_CHAR, '\0' };
-
-					dbus_message_iter_open_container(&message_iter, DBUS_TYPE_ARRAY, sig, &container_iter);
-					append_dict(&container_iter, type, secondary_type, arg);
-				} else {
-					char sig[2] = { type, '\0' };
-
-					dbus_message_iter_open_container(&message_iter, container_type, sig, &container_iter);
-
-					if (container_type == DBUS_TYPE_ARRAY)
-						append_array(&container_iter, type, arg);
-					else
-						append_arg(&container_iter, type, arg);
-				}
-			}
-
-			dbus_message_iter_close_container(&message_iter, &container_iter);
-		} else
-			append_arg(&message_iter, type, arg);
-	}
 
-	if (args_info->contents_multiply_arg > 1) {
-		DBusMessage *old_message = message;
-		message = message_multiply_contents(old_message, args_info->contents_multiply_arg);
-		dbus_message_unref(old_message);
+	for (i = 0; i < match_rules.connection_count; i++) {
+		dbus_connection_close(match_rules.connections[i]);
+		dbus_connection_unref(match_rules.connections[i]);
 	}
 
-	return message;
+	free(match_rules.connections);
 }
 
-static DBusMessage *message_create_nocontents(const struct gengetopt_args_info *args_info) {
-    int type = DBUS_MESSAGE_TYPE_METHOD_CALL;
-    DBusMessage *message;
-
-    if (args_info->type_given) {
-        type = dbus_message_type_from_string(args_info->type_arg);
-        assert_error(type == DBUS_MESSAGE_TYPE_METHOD_CALL || type == DBUS_MESSAGE_TYPE_SIGNAL,
-                     "Message type '%s' is not supported\n",
-                     args_info->type_arg);
-    }
-
-    message = (type == DBUS_MESSAGE_TYPE_METHOD_CALL) ?
-                    dbus_message_new_method_call(
-                                    args_info->destination_arg,
-                                    args_info->path_arg,
-                                    args_info->interface_arg,
-                                    args_info->member_arg) :
-                    dbus_message_new_signal(args_info->path_arg, args_info->interface_arg, args_info->member_arg);
-    assert_error(message != NULL, "Unable to allocate message (out of memory)");
-
-    return message;
+static pid_t get_daemon_pid(DBusConnection *connection, const struct gengetopt_args_info *args_info) {
+	DBusMessage *message, *reply;
+	dbus_uint32_t pid = 0;
+	struct ucred credentials;
+	socklen_t length = sizeof(credentials);
+	const char *env;
+	int fd;
+
+	/* newer daemons answer for themselves */
+	message = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS,
+	                                       "GetConnectionUnixProcessID");
+	assert_error(message != NULL, "Unable to allocate message (out of memory)");
+	env = DBUS_SERVICE_DBUS;
+	dbus_message_append_args(message, DBUS_TYPE_STRING, &env, DBUS_TYPE_INVALID);
+
+	reply = dbus_connection_send_with_reply_and_block(connection, message, -1, NULL);
+	dbus_message_unref(message);
+	if (reply) {
+		dbus_message_get_args(reply, NULL, DBUS_TYPE_UINT32, &pid, DBUS_TYPE_INVALID);
+		dbus_message_unref(reply);
+		if (pid)
+			return pid;
+	}
+
+	/* set by dbus-launch and the benchmarking script */
+	env = getenv("DBUS_SESSION_BUS_PID");
+	if (env && !args_info->system_given && !args_info->address_given)
+		return atoi(env);
+
+	/* the process that created the socket, which is gone if the daemon forked */
+	if (dbus_connection_get_unix_fd(connection, &fd) &&
+	    getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 &&
+	    credentials.pid > 0 && kill(credentials.pid, 0) == 0)
+		return credentials.pid;
+
+	return 0;
 }
 
-static DBusMessage *message_create(const struct gengetopt_args_info *args_info) {
-    DBusMessage* message = message_create_nocontents(args_info);
-	return message_create_contents(args_info, message);
+static long get_process_rss(pid_t pid) {
+	char path[64], line[256];
+	long rss = 0;
+	FILE *file;
+
+	if (!pid)
+		return 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", (int) pid);
+	file = fopen(path, "r");
+	if (!file)
+		return 0;
+
+	while (fgets(line, sizeof(line), file))
+		if (sscanf(line, "VmRSS: %ld", &rss) == 1)
+			break;
+
+	fclose(file);
+
+	return rss;
 }
 
-static DBusConnection *dbus_connect(const struct gengetopt_args_info *args_info) {
-	DBusBusType type = args_info->system_given ? DBUS_BUS_SYSTEM : DBUS_BUS_SESSION;
-	DBusConnection *connection;
+static void idle_connections_open(DBusConnection *connection, const struct gengetopt_args_info *args_info) {
+	struct rlimit limit;
 	DBusError error;
+	int i;
 
-	dbus_error_init (&error);
+	/* every idle connection costs a file descriptor on both ends */
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
 
-	connection = args_info->address_given ?
-			dbus_connection_open(args_info->address_arg, &error) :
-			dbus_bus_get(type, &error);
-	assert_error(!dbus_error_is_set(&error), "Failed to open connection to '%s' message bus: %s",
-			args_info->address_given ? args_info->address_arg : (type == DBUS_BUS_SYSTEM) ? "system" : "session",
-			error.message);
+	idle_connections.connections = calloc(args_info->idle_connections_arg, sizeof(*idle_connections.connections));
+	assert_error(idle_connections.connections != NULL, "Unable to allocate idle connections (out of memory)");
 
-	assert_error(dbus_bus_register(connection, &error), "Unable to register bus connection");
+	idle_connections.daemon_pid = get_daemon_pid(connection, args_info);
+	idle_connections.daemon_rss_before = get_process_rss(idle_connections.daemon_pid);
 
-	return connection;
-}
+	dbus_error_init(&error);
 
-static DBusMessage *dbus_message_clone(const struct gengetopt_args_info *args_info, DBusMessage *message) {
-	DBusMessage *clone = message_create_nocontents(args_info);
-	DBusMessageIter iter, append_iter;
+	for (i = 0; i < args_info->idle_connections_arg; i++) {
+		DBusConnection *idle = dbus_connect(args_info, TRUE);
+
+		idle_connections.connections[idle_connections.count++] = idle;
 
-    if (args_info->inputs_num) {
-        dbus_message_iter_init(message, &iter);
-        dbus_message_iter_init_append(clone, &append_iter);
+		if (args_info->idle_names_given) {
+			char name[64];
 
-        message_append_args(&iter, &append_iter);
-    }
+			snprintf(name, sizeof(name), "com.bmw.Test.Idle%d", i);
+			dbus_bus_request_name(idle, name, DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+			assert_error(!dbus_error_is_set(&error), "Unable to request name '%s': %s", name, error.message);
+		}
+	}
 
-	return clone;
+	idle_connections.daemon_rss = get_process_rss(idle_connections.daemon_pid);
 }
 
-static DBusMessage *dbus_message_duplicate(const struct gengetopt_args_info *args_info, DBusMessage *contents_message) {
-	usec_t time = time_now(CLOCK_MONOTONIC);
-    DBusMessage *message;
+static void idle_connections_close(void) {
+	int i;
+
+	for (i = 0; i < idle_connections.count; i++) {
+		dbus_connection_close(idle_connections.connections[i]);
+		dbus_connection_unref(idle_connections.connections[i]);
+	}
 
-    message = args_info->clone_given ? dbus_message_clone(args_info, contents_message) :
-                                       dbus_message_copy(contents_message);
+	free(idle_connections.connections);
+}
 
-    message_duplicate_time += time_now(CLOCK_MONOTONIC) - time;
+/* bytes of daemon memory per idle connection, 0 if the daemon could not be found */
+static long idle_connection_rss(void) {
+	if (!idle_connections.count || !idle_connections.daemon_rss_before)
+		return 0;
 
-	return message;
+	return (idle_connections.daemon_rss - idle_connections.daemon_rss_before) * 1024 / idle_connections.count;
 }
 
-static int dbus_send_message(DBusConnection *connection,
-                             const struct gengetopt_args_info *args_info,
-                             DBusMessage *contents_message) {
-	int ret = 1;
-	DBusMessage *message = dbus_message_duplicate(args_info, contents_message);
-	usec_t time = time_now(CLOCK_MONOTONIC);
-	DBusMessage *reply;
-	DBusError error;
+/* the driver's summary plus what only dbus-ping knows about */
+static void show_summary(const struct dbus_ping_backend *backend, void *state, int sent, int received,
+                         const struct gengetopt_args_info *args_info) {
+	dbus_ping_driver_show_summary("DBUS_PING", backend, state, sent, received, args_info);
 
-	dbus_message_set_auto_start(message, TRUE);
-	dbus_error_init(&error);
+	if (args_info->bash_given)
+		printf("DBUS_PING_P2P=%d;\n"
+				"DBUS_PING_RAW=%d;\n"
+				"DBUS_PING_MATCH_RULES=%d;\n"
+				"DBUS_PING_IDLE_CONNECTIONS=%d;\n"
+				"DBUS_PING_DAEMON_RSS=%ld;\n"
+				"DBUS_PING_DAEMON_RSS_PER_CONNECTION=%ld;\n",
+				args_info->p2p_given, args_info->raw_given, match_rules.count,
+				idle_connections.count, idle_connections.daemon_rss, idle_connection_rss());
+
+	if (!args_info->bash_given || args_info->verbose_given) {
+		if (match_rules.count > 0)
+			fprintf(args_info->bash_given ? stderr : stdout,
+					"match rules\n"
+					"%d\n",
+					match_rules.count);
+
+		if (idle_connections.count > 0)
+			fprintf(args_info->bash_given ? stderr : stdout,
+					"idle connections  daemon rss (kB)  rss/connection (bytes)\n"
+					"%-17d %-16ld %ld\n",
+					idle_connections.count, idle_connections.daemon_rss, idle_connection_rss());
+	}
 
-    reply = dbus_connection_send_with_reply_and_block(connection, message, args_info->reply_timeout_arg, &error);
-    if (dbus_error_is_set(&error)) {
-        fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Send error %s: %s\n", error.name, error.message);
-        dbus_error_free(&error);
-        ret = 0;
-    }
+	fflush(stdout);
+}
 
-	if (reply)
-		dbus_message_unref(reply);
+/* the kernel's share: the same bytes over a socketpair, without D-Bus on either side */
+static int run_raw_baseline(const struct gengetopt_args_info *args_info, DBusMessage *contents_message) {
+	struct raw_peer *peer;
+	long int count;
+	int length, ret = 0;
+	char *data;
 
-	dbus_message_unref(message);
-	message_send_time += time_now(CLOCK_MONOTONIC) - time;
+	assert_error(dbus_message_marshal(contents_message, &data, &length), "Unable to marshal message (out of memory)");
 
-	return ret;
-}
+	if (args_info->verbose_given)
+		fprintf(stderr, "Raw baseline: %d bytes per message\n", length);
 
-static inline void update_progress(int count, const struct gengetopt_args_info *args_info) {
-	static usec_t last_update_time;
-	usec_t elapsed_time = time_now(CLOCK_MONOTONIC) - start_time;
+	peer = raw_peer_start();
+	dbus_ping_driver_start();
 
-	if (!args_info->verbose_given)
-		return;
+	for (count = 0; count < args_info->count_arg; count++) {
+		usec_t time = time_now(CLOCK_MONOTONIC);
 
-	if (last_update_time > 0) {
-		if (elapsed_time - last_update_time < 2 * USEC_PER_SEC)
-			return;
+		if (!raw_peer_ping(peer, data, length)) {
+			fprintf(stderr, CMDLINE_PARSER_PACKAGE ": Raw ping to the echo peer failed\n");
+			ret = -1;
+			break;
+		}
 
-		fprintf(stderr, "Sent %d message%s in %llu seconds (%llu msgs/sec, %u%% done)\n",
-				count, count != 1 ? "s" : "",
-				elapsed_time / USEC_PER_SEC,
-				elapsed_time > 0 && count > 0 ? USEC_PER_SEC / (elapsed_time / count) : 0,
-				(100 * count) / args_info->count_arg);
+		dbus_ping_driver_record(time_now(CLOCK_MONOTONIC) - time);
+		dbus_ping_driver_update_progress(count, args_info);
 	}
 
-	last_update_time = elapsed_time;
-}
-
-static void show_summary(int sent, int received, const struct gengetopt_args_info *args_info) {
-	usec_t elapsed_time = time_now(CLOCK_MONOTONIC) - start_time;
-	usec_t elapsed_time_sec = elapsed_time / USEC_PER_SEC;
-	int total = sent + received;
-	usec_t msgs_per_sec = elapsed_time > 0 ? USEC_PER_SEC / (elapsed_time / total) : total;
+	show_summary(NULL, NULL, count, count, args_info);
 
-	if (args_info->bash_given)
-		printf("DBUS_PING_SENT=%d;\n"
-				"DBUS_PING_RECEIVED=%d;\n"
-				"DBUS_PING_TOTAL=%d;\n"
-				"DBUS_PING_TIME=%llu;\n"
-				"DBUS_PING_TIME_SEC=%llu;\n"
-				"DBUS_PING_MSGS_PER_SEC=%llu;\n"
-				"DBUS_PING_DUPLICATE_TIME=%llu;\n"
-				"DBUS_PING_SEND_TIME=%llu;\n",
-				sent, received, total,
-				elapsed_time, elapsed_time_sec,
-				msgs_per_sec,
-				message_duplicate_time,
-				message_send_time);
-
-	if (!args_info->bash_given || args_info->verbose_given)
-		fprintf(args_info->bash_given ? stderr : stdout,
-				"sent       received   total      "
-				"time (sec)   time (usec)   msgs/sec (total) "
-				"duplicate time  send time\n"
-				"%-10d %-10d %-10d "
-				"%-12llu %-13llu %-16llu "
-				"%-15llu %llu\n",
-				sent, received, total,
-				elapsed_time_sec, elapsed_time, msgs_per_sec,
-				message_duplicate_time, message_send_time);
+	raw_peer_stop(peer);
+	dbus_free(data);
 
-	fflush(stdout);
+	return ret;
 }
 
 int main(int argc, char *argv[]) {
 	struct gengetopt_args_info args_info;
+	const struct dbus_ping_backend *backend;
 	DBusMessage *contents_message = NULL;
-	DBusConnection *connection;
+	DBusConnection *connection = NULL;
+	void *state;
 	long int count;
+	int ret = 0;
 
 	if (cmdline_parser(argc, argv, &args_info) != 0)
 		return -1;
 
+	/* only the driver's pings have replies that echo the message */
+	assert_error(!args_info.verify_given || !(args_info.raw_given || args_info.connect_given
+			|| args_info.activation_given || args_info.subscribers_arg > 0),
+			"'--verify' can't be combined with '--raw', '--connect', '--activation' or '--subscribers'");
+
+	/* nothing is sent, the connections are the measurement */
+	if (args_info.connect_given)
+		return run_connect_cycles(&args_info);
+
+	if (args_info.subscribers_arg > 0) {
+		assert_error(args_info.count_arg > 0 && args_info.count_arg <= UINT32_MAX,
+				"Invalid signal count %ld", args_info.count_arg);
+		assert_error(args_info.signal_rate_arg >= 0, "Invalid signal rate %d", args_info.signal_rate_arg);
+		assert_error(!strcmp(args_info.type_arg, "method_call"), "Subscribers need a method call to EmitSignals");
+
+		/* the subscriber threads have their own connections */
+		dbus_threads_init_default();
+
+		if (!args_info.member_given)
+			args_info.member_arg = strdup(EMIT_SIGNALS_MEMBER);
+	} else if (args_info.activation_given) {
+		if (!args_info.member_given)
+			args_info.member_arg = strdup(STARTUP_TIMES_MEMBER);
+	} else
+		assert_error(args_info.member_given, "'--member' ('-m') option required");
+
+	backend = dbus_ping_backend_find(backends, &args_info);
+	assert_error(backend != NULL, "Backend '%s' is not built into " CMDLINE_PARSER_PACKAGE ", see its -systemd and -gdbus builds",
+			args_info.backend_arg);
+
+	/* everything else needs the bus daemon in between */
+	if (args_info.p2p_given) {
+		assert_error(args_info.address_given, "'--p2p' needs the peer's '--address'");
+		assert_error(!args_info.subscribers_arg && !args_info.activation_given && !args_info.match_rules_arg
+				&& !args_info.idle_connections_arg,
+				"'--p2p' can't be combined with subscribers, activation, match rules or idle connections");
+	}
+
 	contents_message = message_create(&args_info);
 
 	if (args_info.verbose_given)
 		print_message(contents_message, FALSE);
 
-	connection = dbus_connect(&args_info);
-	start_time = time_now(CLOCK_MONOTONIC);
+	/* no bus and no service, the floor the other results are measured against */
+	if (args_info.raw_given) {
+		ret = run_raw_baseline(&args_info, contents_message);
+		dbus_message_unref(contents_message);
+		return ret;
+	}
+
+	state = backend->connect(&args_info);
 
-	for (count = 0; count < args_info.count_arg; count++) {
-		dbus_send_message(connection, &args_info, contents_message);
-		update_progress(count, &args_info);
+	/* the modes that talk to the bus beyond the pings are written against libdbus */
+	if (args_info.subscribers_arg > 0 || args_info.activation_given || args_info.idle_connections_arg > 0) {
+		assert_error(backend == &libdbus_backend,
+				"Subscribers, activation and idle connections need the libdbus backend");
+		connection = libdbus_backend_get_connection(state);
 	}
 
-	show_summary(count, count, &args_info);
+	if (args_info.match_rules_arg > 0) {
+		assert_error(args_info.match_connections_arg > 0, "Invalid match connection count %d",
+				args_info.match_connections_arg);
+		match_rules_add(&args_info);
+	}
+
+	if (args_info.idle_connections_arg > 0)
+		idle_connections_open(connection, &args_info);
+
+	if (args_info.subscribers_arg > 0) {
+		DBusMessage *emit_message = message_create_emit_signals(&args_info, contents_message);
 
-	dbus_connection_unref(connection);
+		ret = run_signal_subscribers(connection, emit_message, &args_info);
+		dbus_message_unref(emit_message);
+	} else if (args_info.activation_given)
+		ret = run_activation_cycles(connection, &args_info);
+	else {
+		void *template = backend->build(state, &args_info);
+
+		count = dbus_ping_driver_run(backend, state, &args_info, template);
+		/* a failed call was sent but nothing came back */
+		show_summary(backend, state, count + dbus_ping_driver_failures(), count, &args_info);
+		backend->free_message(state, template);
+
+		if (dbus_ping_driver_mismatches() || dbus_ping_driver_failures())
+			ret = -1;
+	}
+
+	if (match_rules.connections)
+		match_rules_free();
+
+	if (idle_connections.connections)
+		idle_connections_close();
+
+	backend->disconnect(state);
 	dbus_message_unref(contents_message);
 
-	return 0;
+	return ret;
 }
@@ -0,0 +1,201 @@
+/*
+ *
+ * dbus-test-service-cache.c D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-test-service-cache.h"
+#include "dbus-ping-common.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+
+struct cache_entry {
+	uint64_t key;
+	char *signature;
+	int body_length;
+	DBusMessage *reply;
+
+	struct cache_entry *bucket_next;
+	struct cache_entry *lru_prev;
+	struct cache_entry *lru_next;
+};
+
+struct reply_cache {
+	struct cache_entry **buckets;
+	unsigned int bucket_mask;
+	int size;
+	int count;
+
+	/* most recently used first */
+	struct cache_entry *lru_head;
+	struct cache_entry *lru_tail;
+
+	struct reply_cache_statistics statistics;
+	pthread_mutex_t lock;
+};
+
+
+struct reply_cache *reply_cache_new(int size) {
+	struct reply_cache *cache;
+	unsigned int buckets = 1;
+
+	cache = calloc(1, sizeof(*cache));
+	assert_error(cache != NULL, "Unable to allocate reply cache (out of memory)");
+
+	while (buckets < (unsigned int) size)
+		buckets <<= 1;
+
+	cache->buckets = calloc(buckets, sizeof(*cache->buckets));
+	assert_error(cache->buckets != NULL, "Unable to allocate reply cache (out of memory)");
+
+	cache->bucket_mask = buckets - 1;
+	cache->size = size;
+	pthread_mutex_init(&cache->lock, NULL);
+
+	return cache;
+}
+
+static void entry_free(struct cache_entry *entry) {
+	dbus_message_unref(entry->reply);
+	free(entry->signature);
+	free(entry);
+}
+
+void reply_cache_free(struct reply_cache *cache) {
+	struct cache_entry *entry, *next;
+
+	for (entry = cache->lru_head; entry; entry = next) {
+		next = entry->lru_next;
+		entry_free(entry);
+	}
+
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->buckets);
+	free(cache);
+}
+
+static void lru_unlink(struct reply_cache *cache, struct cache_entry *entry) {
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		cache->lru_head = entry->lru_next;
+
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		cache->lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(struct reply_cache *cache, struct cache_entry *entry) {
+	entry->lru_prev = NULL;
+	entry->lru_next = cache->lru_head;
+
+	if (cache->lru_head)
+		cache->lru_head->lru_prev = entry;
+	else
+		cache->lru_tail = entry;
+
+	cache->lru_head = entry;
+}
+
+static struct cache_entry **bucket_find(struct reply_cache *cache, uint64_t key, const char *signature,
+                                        int body_length) {
+	struct cache_entry **p = &cache->buckets[key & cache->bucket_mask];
+
+	for (; *p; p = &(*p)->bucket_next)
+		if ((*p)->key == key && (*p)->body_length == body_length && !strcmp((*p)->signature, signature))
+			break;
+
+	return p;
+}
+
+static void evict_locked(struct reply_cache *cache) {
+	struct cache_entry *entry = cache->lru_tail;
+	struct cache_entry **p = bucket_find(cache, entry->key, entry->signature, entry->body_length);
+
+	*p = entry->bucket_next;
+	lru_unlink(cache, entry);
+	entry_free(entry);
+
+	cache->count--;
+	cache->statistics.evictions++;
+}
+
+DBusMessage *reply_cache_lookup(struct reply_cache *cache, uint64_t key, const char *signature, int body_length) {
+	struct cache_entry *entry;
+	DBusMessage *reply = NULL;
+
+	pthread_mutex_lock(&cache->lock);
+
+	entry = *bucket_find(cache, key, signature, body_length);
+	if (entry) {
+		lru_unlink(cache, entry);
+		lru_push_front(cache, entry);
+		reply = dbus_message_ref(entry->reply);
+		cache->statistics.hits++;
+	} else
+		cache->statistics.misses++;
+
+	pthread_mutex_unlock(&cache->lock);
+
+	return reply;
+}
+
+void reply_cache_insert(struct reply_cache *cache, uint64_t key, const char *signature, int body_length,
+                        DBusMessage *reply) {
+	struct cache_entry *entry, **p;
+
+	pthread_mutex_lock(&cache->lock);
+
+	/* another worker may have been faster */
+	p = bucket_find(cache, key, signature, body_length);
+	if (*p)
+		goto end;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		goto end;
+
+	entry->signature = strdup(signature);
+	if (!entry->signature) {
+		free(entry);
+		goto end;
+	}
+
+	entry->key = key;
+	entry->body_length = body_length;
+	entry->reply = dbus_message_ref(reply);
+
+	*p = entry;
+	lru_push_front(cache, entry);
+
+	if (++cache->count > cache->size)
+		evict_locked(cache);
+
+end:
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void reply_cache_get_statistics(struct reply_cache *cache, struct reply_cache_statistics *statistics) {
+	pthread_mutex_lock(&cache->lock);
+	*statistics = cache->statistics;
+	pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,53 @@
+/*
+ *
+ * dbus-test-service-cache.h D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_TEST_SERVICE_CACHE_H_
+#define DBUS_TEST_SERVICE_CACHE_H_
+
+#include <stdint.h>
+#include <dbus/dbus.h>
+
+
+struct reply_cache_statistics {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+};
+
+struct reply_cache;
+
+/*
+ * Bounded LRU cache of replies, keyed by a hash of the request's signature
+ * and marshaled body. The signature and body length are compared as well,
+ * anything beyond that is left to the 64 bit hash. The cache is thread safe.
+ */
+struct reply_cache *reply_cache_new(int size);
+void reply_cache_free(struct reply_cache *cache);
+
+/* Returns a new reference to the cached reply or NULL */
+DBusMessage *reply_cache_lookup(struct reply_cache *cache, uint64_t key, const char *signature, int body_length);
+void reply_cache_insert(struct reply_cache *cache, uint64_t key, const char *signature, int body_length,
+                        DBusMessage *reply);
+
+void reply_cache_get_statistics(struct reply_cache *cache, struct reply_cache_statistics *statistics);
+
+#endif /* DBUS_TEST_SERVICE_CACHE_H_ */
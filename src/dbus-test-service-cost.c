@@ -0,0 +1,184 @@
+/*
+ *
+ * dbus-test-service-cost.c D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-test-service-cost.h"
+
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define CACHE_LINE_SIZE		64
+
+
+/* every thread draws from its own generator and touches its own working set */
+static __thread uint64_t random_state;
+static __thread unsigned char *touch_memory;
+static __thread size_t touch_memory_size;
+
+
+static double random_uniform(void) {
+	uint64_t x;
+
+	if (!random_state)
+		random_state = time_now(CLOCK_MONOTONIC) ^ ((uint64_t) (uintptr_t) pthread_self() << 1) ^ 1;
+
+	/* xorshift64* */
+	x = random_state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	random_state = x;
+
+	/* (0, 1], log() must never see zero */
+	return ((x * 0x2545F4914F6CDD1DULL >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static double random_normal(void) {
+	return sqrt(-2.0 * log(random_uniform())) * cos(2.0 * M_PI * random_uniform());
+}
+
+static usec_t draw_duration(const struct handler_cost *cost) {
+	double duration;
+
+	switch (cost->distribution) {
+	case COST_EXPONENTIAL:
+		duration = -cost->mean * log(random_uniform());
+		break;
+
+	case COST_LOGNORMAL:
+		/* mu is chosen so that the mean of the distribution is cost->mean */
+		duration = exp(log(cost->mean) - cost->sigma * cost->sigma / 2.0 + cost->sigma * random_normal());
+		break;
+
+	default:
+		duration = cost->mean;
+		break;
+	}
+
+	return (usec_t) (duration + 0.5);
+}
+
+static void spin(usec_t duration) {
+	usec_t end = time_now(CLOCK_MONOTONIC) + duration;
+
+	while (time_now(CLOCK_MONOTONIC) < end)
+		;
+}
+
+static void sleep_for(usec_t duration) {
+	struct timespec ts = {
+		.tv_sec = duration / USEC_PER_SEC,
+		.tv_nsec = (duration % USEC_PER_SEC) * NSEC_PER_USEC,
+	};
+
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+}
+
+static void touch(size_t size) {
+	size_t i;
+
+	if (touch_memory_size < size) {
+		free(touch_memory);
+		touch_memory = calloc(1, size);
+		assert_error(touch_memory != NULL, "Unable to allocate working set (out of memory)");
+		touch_memory_size = size;
+	}
+
+	/* one write per cache line, the lines stay dirty between calls */
+	for (i = 0; i < size; i += CACHE_LINE_SIZE)
+		touch_memory[i]++;
+}
+
+char *handler_cost_parse(const char *spec, struct handler_cost *cost) {
+	char *copy = strdup(spec), *items = copy;
+	const char *item;
+	char *method;
+
+	assert_error(copy != NULL, "Unable to parse handler cost (out of memory)");
+	memset(cost, 0, sizeof(*cost));
+
+	method = strdup(get_next_data_item(&items));
+	item = get_next_data_item(&items);
+
+	if (!strcmp(item, "touch")) {
+		long kib = strtol(get_next_data_item(&items), NULL, 0);
+
+		assert_error(kib > 0, "Invalid working set size in handler cost '%s'", spec);
+		cost->mode = COST_TOUCH;
+		cost->working_set = kib * 1024;
+		goto end;
+	}
+
+	if (!strcmp(item, "spin"))
+		cost->mode = COST_SPIN;
+	else if (!strcmp(item, "sleep"))
+		cost->mode = COST_SLEEP;
+	else
+		assert_error(0, "Unknown handler cost mode '%s'", item);
+
+	item = get_next_data_item(&items);
+	if (!strcmp(item, "fixed"))
+		cost->distribution = COST_FIXED;
+	else if (!strcmp(item, "exp"))
+		cost->distribution = COST_EXPONENTIAL;
+	else if (!strcmp(item, "lognormal"))
+		cost->distribution = COST_LOGNORMAL;
+	else
+		assert_error(0, "Unknown handler cost distribution '%s'", item);
+
+	cost->mean = strtod(get_next_data_item(&items), NULL);
+	assert_error(cost->mean > 0, "Invalid mean in handler cost '%s'", spec);
+
+	if (cost->distribution == COST_LOGNORMAL) {
+		cost->sigma = strtod(get_next_data_item(&items), NULL);
+		assert_error(cost->sigma > 0, "Invalid sigma in handler cost '%s'", spec);
+	}
+
+end:
+	assert_error(*items == '\0', "Trailing data in handler cost '%s'", spec);
+	free(copy);
+
+	return method;
+}
+
+usec_t handler_cost_apply(const struct handler_cost *cost) {
+	usec_t time = time_now(CLOCK_MONOTONIC);
+
+	switch (cost->mode) {
+	case COST_SPIN:
+		spin(draw_duration(cost));
+		break;
+
+	case COST_SLEEP:
+		sleep_for(draw_duration(cost));
+		break;
+
+	case COST_TOUCH:
+		touch(cost->working_set);
+		break;
+	}
+
+	return time_now(CLOCK_MONOTONIC) - time;
+}
@@ -0,0 +1,60 @@
+/*
+ *
+ * dbus-test-service-cost.h D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_TEST_SERVICE_COST_H_
+#define DBUS_TEST_SERVICE_COST_H_
+
+#include <stddef.h>
+
+#include "dbus-ping-common.h"
+
+
+enum cost_mode {
+	COST_SPIN,
+	COST_SLEEP,
+	COST_TOUCH,
+};
+
+enum cost_distribution {
+	COST_FIXED,
+	COST_EXPONENTIAL,
+	COST_LOGNORMAL,
+};
+
+struct handler_cost {
+	enum cost_mode mode;
+	enum cost_distribution distribution;
+	double mean;		/* usec */
+	double sigma;		/* lognormal only */
+	size_t working_set;	/* bytes, touch only */
+};
+
+/*
+ * Parses "METHOD:spin|sleep:fixed|exp|lognormal:MEAN_USEC[:SIGMA]" or
+ * "METHOD:touch:KIB" and returns the method name, which has to be freed.
+ */
+char *handler_cost_parse(const char *spec, struct handler_cost *cost);
+
+/* Burns the cost of one call on the calling thread, returns the time it took */
+usec_t handler_cost_apply(const struct handler_cost *cost);
+
+#endif /* DBUS_TEST_SERVICE_COST_H_ */
@@ -0,0 +1,536 @@
+/*
+ *
+ * dbus-test-service-epoll.c D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-test-service-epoll.h"
+#include "dbus-ping-common.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define MAX_EVENTS			16
+#define MAX_FD_WATCHES		4
+#define MAX_EXPIRED_TIMEOUTS	16
+
+
+/*
+ * libdbus may call the watch and timeout hooks from any thread that uses the
+ * connection (e.g. a worker sending a reply), so the lists are protected by
+ * the loop lock. The lock is never held while calling back into libdbus,
+ * instead the loop works on snapshots and looks the entries up again by id.
+ */
+struct loop_watch {
+	unsigned long id;
+	DBusWatch *watch;
+	struct loop_watch *next;
+};
+
+struct loop_timeout {
+	unsigned long id;
+	DBusTimeout *timeout;
+	usec_t expires;
+	struct loop_timeout *next;
+};
+
+struct loop_connection {
+	DBusConnection *connection;
+	int dispatch_pending;
+	int accepted;
+	struct loop_connection *next;
+};
+
+struct epoll_loop {
+	int epoll_fd;
+	int wakeup_fd;
+	unsigned long wakeups;
+	unsigned long next_id;
+
+	epoll_loop_idle_func_t idle_func;
+	void *idle_data;
+
+	pthread_mutex_t lock;
+	struct loop_watch *watches;
+	struct loop_timeout *timeouts;
+	struct loop_connection *connections;
+	DBusServer *server;
+	epoll_loop_connection_func_t connection_func;
+	void *connection_data;
+};
+
+
+static uint32_t watch_flags_to_events(unsigned int flags) {
+	uint32_t events = 0;
+
+	if (flags & DBUS_WATCH_READABLE)
+		events |= EPOLLIN;
+	if (flags & DBUS_WATCH_WRITABLE)
+		events |= EPOLLOUT;
+
+	return events;
+}
+
+static unsigned int events_to_watch_flags(uint32_t events) {
+	unsigned int flags = 0;
+
+	if (events & EPOLLIN)
+		flags |= DBUS_WATCH_READABLE;
+	if (events & EPOLLOUT)
+		flags |= DBUS_WATCH_WRITABLE;
+	if (events & EPOLLERR)
+		flags |= DBUS_WATCH_ERROR;
+	if (events & EPOLLHUP)
+		flags |= DBUS_WATCH_HANGUP;
+
+	return flags;
+}
+
+/* libdbus uses separate read and write watches on the same socket, epoll wants one registration per fd */
+static void update_fd_locked(struct epoll_loop *loop, int fd) {
+	struct epoll_event event;
+	struct loop_watch *w;
+	int count = 0;
+
+	memset(&event, 0, sizeof(event));
+	event.data.fd = fd;
+
+	for (w = loop->watches; w; w = w->next) {
+		if (dbus_watch_get_unix_fd(w->watch) != fd)
+			continue;
+
+		count++;
+		if (dbus_watch_get_enabled(w->watch))
+			event.events |= watch_flags_to_events(dbus_watch_get_flags(w->watch));
+	}
+
+	if (!count) {
+		/* the fd may already be closed */
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		return;
+	}
+
+	if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0 && errno == ENOENT)
+		if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+			fprintf(stderr, "Unable to add fd %d to epoll: %s\n", fd, strerror(errno));
+}
+
+static dbus_bool_t add_watch(DBusWatch *watch, void *data) {
+	struct epoll_loop *loop = data;
+	struct loop_watch *w = calloc(1, sizeof(*w));
+
+	if (!w)
+		return FALSE;
+
+	pthread_mutex_lock(&loop->lock);
+	w->id = ++loop->next_id;
+	w->watch = watch;
+	w->next = loop->watches;
+	loop->watches = w;
+	update_fd_locked(loop, dbus_watch_get_unix_fd(watch));
+	pthread_mutex_unlock(&loop->lock);
+
+	return TRUE;
+}
+
+static void remove_watch(DBusWatch *watch, void *data) {
+	struct epoll_loop *loop = data;
+	struct loop_watch **p, *w;
+
+	pthread_mutex_lock(&loop->lock);
+	for (p = &loop->watches; (w = *p); p = &w->next) {
+		if (w->watch == watch) {
+			*p = w->next;
+			free(w);
+			break;
+		}
+	}
+	update_fd_locked(loop, dbus_watch_get_unix_fd(watch));
+	pthread_mutex_unlock(&loop->lock);
+}
+
+static void toggle_watch(DBusWatch *watch, void *data) {
+	struct epoll_loop *loop = data;
+
+	pthread_mutex_lock(&loop->lock);
+	update_fd_locked(loop, dbus_watch_get_unix_fd(watch));
+	pthread_mutex_unlock(&loop->lock);
+}
+
+static void arm_timeout_locked(struct loop_timeout *t) {
+	t->expires = dbus_timeout_get_enabled(t->timeout) ?
+			time_now(CLOCK_MONOTONIC) + (usec_t) dbus_timeout_get_interval(t->timeout) * USEC_PER_MSEC : 0;
+}
+
+static dbus_bool_t add_timeout(DBusTimeout *timeout, void *data) {
+	struct epoll_loop *loop = data;
+	struct loop_timeout *t = calloc(1, sizeof(*t));
+
+	if (!t)
+		return FALSE;
+
+	pthread_mutex_lock(&loop->lock);
+	t->id = ++loop->next_id;
+	t->timeout = timeout;
+	arm_timeout_locked(t);
+	t->next = loop->timeouts;
+	loop->timeouts = t;
+	pthread_mutex_unlock(&loop->lock);
+
+	/* the loop may be sleeping with a longer timeout */
+	eventfd_write(loop->wakeup_fd, 1);
+
+	return TRUE;
+}
+
+static void remove_timeout(DBusTimeout *timeout, void *data) {
+	struct epoll_loop *loop = data;
+	struct loop_timeout **p, *t;
+
+	pthread_mutex_lock(&loop->lock);
+	for (p = &loop->timeouts; (t = *p); p = &t->next) {
+		if (t->timeout == timeout) {
+			*p = t->next;
+			free(t);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&loop->lock);
+}
+
+static void toggle_timeout(DBusTimeout *timeout, void *data) {
+	struct epoll_loop *loop = data;
+	struct loop_timeout *t;
+
+	pthread_mutex_lock(&loop->lock);
+	for (t = loop->timeouts; t; t = t->next)
+		if (t->timeout == timeout)
+			arm_timeout_locked(t);
+	pthread_mutex_unlock(&loop->lock);
+
+	eventfd_write(loop->wakeup_fd, 1);
+}
+
+static void wakeup_main(void *data) {
+	struct epoll_loop *loop = data;
+
+	/* a reply was queued by another thread */
+	eventfd_write(loop->wakeup_fd, 1);
+}
+
+static void dispatch_status_changed(DBusConnection *connection, DBusDispatchStatus status, void *data) {
+	struct loop_connection *c = data;
+
+	/* messages are only read by the loop thread, which dispatches after every wakeup */
+	if (status == DBUS_DISPATCH_DATA_REMAINS)
+		__atomic_store_n(&c->dispatch_pending, 1, __ATOMIC_RELEASE);
+}
+
+struct epoll_loop *epoll_loop_new(void) {
+	struct epoll_loop *loop;
+	struct epoll_event event;
+
+	loop = calloc(1, sizeof(*loop));
+	assert_error(loop != NULL, "Unable to allocate epoll loop (out of memory)");
+
+	loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	assert_error(loop->epoll_fd >= 0, "Unable to create epoll: %s", strerror(errno));
+
+	loop->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	assert_error(loop->wakeup_fd >= 0, "Unable to create eventfd: %s", strerror(errno));
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = loop->wakeup_fd;
+	assert_error(epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeup_fd, &event) == 0,
+			"Unable to add eventfd to epoll: %s", strerror(errno));
+
+	pthread_mutex_init(&loop->lock, NULL);
+
+	return loop;
+}
+
+void epoll_loop_free(struct epoll_loop *loop) {
+	if (loop->server)
+		epoll_loop_remove_server(loop, loop->server);
+
+	while (loop->connections)
+		epoll_loop_remove_connection(loop, loop->connections->connection);
+
+	pthread_mutex_destroy(&loop->lock);
+	close(loop->wakeup_fd);
+	close(loop->epoll_fd);
+	free(loop);
+}
+
+static struct loop_connection *add_connection(struct epoll_loop *loop, DBusConnection *connection) {
+	struct loop_connection *c;
+
+	c = calloc(1, sizeof(*c));
+	assert_error(c != NULL, "Unable to allocate loop connection (out of memory)");
+
+	c->connection = dbus_connection_ref(connection);
+	c->dispatch_pending = 1;
+
+	pthread_mutex_lock(&loop->lock);
+	c->next = loop->connections;
+	loop->connections = c;
+	pthread_mutex_unlock(&loop->lock);
+
+	assert_error(dbus_connection_set_watch_functions(connection, add_watch, remove_watch, toggle_watch, loop, NULL),
+			"Unable to set watch functions (out of memory)");
+	assert_error(dbus_connection_set_timeout_functions(connection, add_timeout, remove_timeout, toggle_timeout, loop, NULL),
+			"Unable to set timeout functions (out of memory)");
+	dbus_connection_set_wakeup_main_function(connection, wakeup_main, loop, NULL);
+	dbus_connection_set_dispatch_status_function(connection, dispatch_status_changed, c, NULL);
+
+	return c;
+}
+
+void epoll_loop_add_connection(struct epoll_loop *loop, DBusConnection *connection) {
+	add_connection(loop, connection);
+}
+
+void epoll_loop_remove_connection(struct epoll_loop *loop, DBusConnection *connection) {
+	struct loop_connection **p, *c;
+
+	pthread_mutex_lock(&loop->lock);
+	for (p = &loop->connections; (c = *p); p = &c->next)
+		if (c->connection == connection) {
+			*p = c->next;
+			break;
+		}
+	pthread_mutex_unlock(&loop->lock);
+
+	if (!c)
+		return;
+
+	/* removes all watches and timeouts of the connection */
+	dbus_connection_set_dispatch_status_function(connection, NULL, NULL, NULL);
+	dbus_connection_set_wakeup_main_function(connection, NULL, NULL, NULL);
+	dbus_connection_set_watch_functions(connection, NULL, NULL, NULL, NULL, NULL);
+	dbus_connection_set_timeout_functions(connection, NULL, NULL, NULL, NULL, NULL);
+
+	/* the last reference of a private connection must not be dropped while open */
+	if (c->accepted)
+		dbus_connection_close(c->connection);
+
+	dbus_connection_unref(c->connection);
+	free(c);
+}
+
+static void new_connection(DBusServer *server, DBusConnection *connection, void *data) {
+	struct epoll_loop *loop = data;
+
+	if (loop->connection_func)
+		loop->connection_func(connection, loop->connection_data);
+
+	add_connection(loop, connection)->accepted = 1;
+}
+
+void epoll_loop_add_server(struct epoll_loop *loop, DBusServer *server, epoll_loop_connection_func_t func,
+                           void *data) {
+	assert_error(loop->server == NULL, "Only one server per loop is supported");
+	loop->server = dbus_server_ref(server);
+	loop->connection_func = func;
+	loop->connection_data = data;
+
+	dbus_server_set_new_connection_function(server, new_connection, loop, NULL);
+
+	assert_error(dbus_server_set_watch_functions(server, add_watch, remove_watch, toggle_watch, loop, NULL),
+			"Unable to set server watch functions (out of memory)");
+	assert_error(dbus_server_set_timeout_functions(server, add_timeout, remove_timeout, toggle_timeout, loop, NULL),
+			"Unable to set server timeout functions (out of memory)");
+}
+
+void epoll_loop_remove_server(struct epoll_loop *loop, DBusServer *server) {
+	if (loop->server != server)
+		return;
+
+	dbus_server_set_new_connection_function(server, NULL, NULL, NULL);
+	dbus_server_set_watch_functions(server, NULL, NULL, NULL, NULL, NULL);
+	dbus_server_set_timeout_functions(server, NULL, NULL, NULL, NULL, NULL);
+
+	dbus_server_unref(loop->server);
+	loop->server = NULL;
+}
+
+void epoll_loop_set_idle_function(struct epoll_loop *loop, epoll_loop_idle_func_t func, void *data) {
+	loop->idle_func = func;
+	loop->idle_data = data;
+}
+
+static DBusWatch *lookup_watch(struct epoll_loop *loop, unsigned long id) {
+	struct loop_watch *w;
+	DBusWatch *watch = NULL;
+
+	pthread_mutex_lock(&loop->lock);
+	for (w = loop->watches; w; w = w->next)
+		if (w->id == id) {
+			watch = w->watch;
+			break;
+		}
+	pthread_mutex_unlock(&loop->lock);
+
+	return watch;
+}
+
+static void handle_fd(struct epoll_loop *loop, int fd, uint32_t events) {
+	unsigned long ids[MAX_FD_WATCHES];
+	struct loop_watch *w;
+	int i, count = 0;
+
+	pthread_mutex_lock(&loop->lock);
+	for (w = loop->watches; w && count < MAX_FD_WATCHES; w = w->next)
+		if (dbus_watch_get_unix_fd(w->watch) == fd && dbus_watch_get_enabled(w->watch))
+			ids[count++] = w->id;
+	pthread_mutex_unlock(&loop->lock);
+
+	for (i = 0; i < count; i++) {
+		DBusWatch *watch = lookup_watch(loop, ids[i]);
+		unsigned int flags;
+		int pending;
+
+		if (!watch)
+			continue;
+
+		flags = events_to_watch_flags(events) & (dbus_watch_get_flags(watch) | DBUS_WATCH_ERROR | DBUS_WATCH_HANGUP);
+		if (!flags)
+			continue;
+
+		dbus_watch_handle(watch, flags);
+
+		if (!(flags & DBUS_WATCH_READABLE) || (flags & (DBUS_WATCH_ERROR | DBUS_WATCH_HANGUP)))
+			continue;
+
+		/*
+		 * libdbus stops reading after a few kilobytes per call, read the
+		 * rest now instead of coming back through epoll_wait()
+		 */
+		while ((watch = lookup_watch(loop, ids[i])) && dbus_watch_get_enabled(watch)
+				&& ioctl(fd, FIONREAD, &pending) == 0 && pending > 0)
+			dbus_watch_handle(watch, DBUS_WATCH_READABLE);
+	}
+}
+
+static int handle_timeouts(struct epoll_loop *loop) {
+	unsigned long ids[MAX_EXPIRED_TIMEOUTS];
+	struct loop_timeout *t;
+	usec_t now = time_now(CLOCK_MONOTONIC), next = 0;
+	int i, count = 0;
+
+	pthread_mutex_lock(&loop->lock);
+	for (t = loop->timeouts; t; t = t->next) {
+		if (!t->expires)
+			continue;
+
+		if (t->expires <= now && count < MAX_EXPIRED_TIMEOUTS)
+			ids[count++] = t->id;
+		else if (!next || t->expires < next)
+			next = t->expires;
+	}
+	pthread_mutex_unlock(&loop->lock);
+
+	for (i = 0; i < count; i++) {
+		DBusTimeout *timeout = NULL;
+
+		pthread_mutex_lock(&loop->lock);
+		for (t = loop->timeouts; t; t = t->next)
+			if (t->id == ids[i]) {
+				timeout = t->timeout;
+				/* libdbus timeouts fire periodically until removed */
+				arm_timeout_locked(t);
+				break;
+			}
+		pthread_mutex_unlock(&loop->lock);
+
+		if (timeout)
+			dbus_timeout_handle(timeout);
+	}
+
+	if (count)
+		return 0;
+
+	return next ? (int) ((next - now + USEC_PER_MSEC - 1) / USEC_PER_MSEC) : -1;
+}
+
+static int dispatch_connections(struct epoll_loop *loop) {
+	struct loop_connection *c, *next;
+	int connected = 0;
+
+	/* connections are only added and removed by the loop thread */
+	for (c = loop->connections; c; c = next) {
+		next = c->next;
+
+		if (__atomic_exchange_n(&c->dispatch_pending, 0, __ATOMIC_ACQUIRE))
+			while (dbus_connection_dispatch(c->connection) == DBUS_DISPATCH_DATA_REMAINS)
+				;
+
+		if (dbus_connection_get_is_connected(c->connection))
+			connected++;
+		else
+			epoll_loop_remove_connection(loop, c->connection);
+	}
+
+	return connected;
+}
+
+void epoll_loop_run(struct epoll_loop *loop, volatile sig_atomic_t *terminated) {
+	struct epoll_event events[MAX_EVENTS];
+	int i, n, timeout;
+
+	while (!*terminated && (dispatch_connections(loop) || loop->server)) {
+		if (loop->idle_func)
+			loop->idle_func(loop->idle_data);
+
+		timeout = handle_timeouts(loop);
+		if (!timeout)
+			continue;
+
+		n = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Unable to wait for events: %s\n", strerror(errno));
+			break;
+		}
+
+		loop->wakeups++;
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.fd == loop->wakeup_fd) {
+				eventfd_t value;
+				eventfd_read(loop->wakeup_fd, &value);
+				continue;
+			}
+
+			handle_fd(loop, events[i].data.fd, events[i].events);
+		}
+	}
+}
+
+unsigned long epoll_loop_get_wakeups(const struct epoll_loop *loop) {
+	return loop->wakeups;
+}
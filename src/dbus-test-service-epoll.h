@@ -0,0 +1,64 @@
+/*
+ *
+ * dbus-test-service-epoll.h D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_TEST_SERVICE_EPOLL_H_
+#define DBUS_TEST_SERVICE_EPOLL_H_
+
+#include <signal.h>
+#include <dbus/dbus.h>
+
+
+typedef void (*epoll_loop_idle_func_t)(void *data);
+typedef void (*epoll_loop_connection_func_t)(DBusConnection *connection, void *data);
+
+struct epoll_loop;
+
+struct epoll_loop *epoll_loop_new(void);
+void epoll_loop_free(struct epoll_loop *loop);
+
+/* Installs the watch, timeout, wakeup and dispatch status hooks of the connection */
+void epoll_loop_add_connection(struct epoll_loop *loop, DBusConnection *connection);
+void epoll_loop_remove_connection(struct epoll_loop *loop, DBusConnection *connection);
+
+/*
+ * Watches the listening sockets of the server and adds every accepted
+ * connection to the loop, after func had a chance to register its objects.
+ * Accepted connections are closed when they are removed from the loop. The
+ * loop keeps running while a server is attached, even without connections.
+ */
+void epoll_loop_add_server(struct epoll_loop *loop, DBusServer *server, epoll_loop_connection_func_t func,
+                           void *data);
+void epoll_loop_remove_server(struct epoll_loop *loop, DBusServer *server);
+
+/* Called after every dispatch batch, right before the loop waits again */
+void epoll_loop_set_idle_function(struct epoll_loop *loop, epoll_loop_idle_func_t func, void *data);
+
+/*
+ * Runs until terminated is set or no connection or server is left. Every wakeup drains
+ * the readable sockets completely and dispatches all complete messages
+ * before waiting again.
+ */
+void epoll_loop_run(struct epoll_loop *loop, volatile sig_atomic_t *terminated);
+
+unsigned long epoll_loop_get_wakeups(const struct epoll_loop *loop);
+
+#endif /* DBUS_TEST_SERVICE_EPOLL_H_ */
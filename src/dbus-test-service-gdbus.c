@@ -0,0 +1,138 @@
+/*
+ *
+ * dbus-test-service-gdbus.c D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include <stdio.h>
+#include <signal.h>
+#include <string.h>
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+
+/* the same name and object as the libdbus service, so every client can drive it */
+#define DEFAULT_BUS_NAME		"com.bmw.Test"
+#define	DEFAULT_OBJECT_PATH		"/com/bmw/Test"
+
+
+static GMainLoop *main_loop;
+
+/* the body of the last getEcho reply, only touched from the main loop */
+static GVariant *last_reply_body;
+
+
+static gboolean handle_method_call(gpointer data) {
+	GDBusMessage *message = data;
+	GDBusConnection *connection = g_object_get_data(G_OBJECT(message), "connection");
+	GDBusMessage *reply = g_dbus_message_new_method_reply(message);
+	GVariant *body = g_dbus_message_get_body(message);
+	GError *error = NULL;
+
+	if (!strcmp(g_dbus_message_get_member(message), "getLastReply") && last_reply_body)
+		body = last_reply_body;
+	else if (body) {
+		if (last_reply_body)
+			g_variant_unref(last_reply_body);
+		last_reply_body = g_variant_ref(body);
+	}
+
+	if (body)
+		g_dbus_message_set_body(reply, body);
+
+	if (!g_dbus_connection_send_message(connection, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, &error)) {
+		g_printerr("Failed to send reply: %s\n", error->message);
+		g_error_free(error);
+	}
+
+	g_object_unref(reply);
+	g_object_unref(message);
+
+	return FALSE;
+}
+
+/*
+ * GDBus checks the arguments of registered objects against their
+ * introspection data, which rules out an echo of any signature. The echo
+ * methods are picked up here instead, on GDBus' worker thread, and handed
+ * to the main loop just like GDBus dispatches calls to registered objects.
+ */
+static GDBusMessage *filter_message(GDBusConnection *connection, GDBusMessage *message, gboolean incoming,
+                                    gpointer data) {
+	const gchar *member;
+
+	if (!incoming || g_dbus_message_get_message_type(message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL ||
+	    g_strcmp0(g_dbus_message_get_path(message), DEFAULT_OBJECT_PATH))
+		return message;
+
+	member = g_dbus_message_get_member(message);
+	if (g_strcmp0(member, "getEcho") && g_strcmp0(member, "getLastReply"))
+		return message;
+
+	g_object_set_data(G_OBJECT(message), "connection", connection);
+	g_main_context_invoke(NULL, handle_method_call, message);
+
+	return NULL;
+}
+
+static void name_lost(GDBusConnection *connection, const gchar *name, gpointer data) {
+	g_printerr("Failed to acquire name '%s'\n", name);
+	g_main_loop_quit(main_loop);
+}
+
+static gboolean handle_sigterm(gpointer data) {
+	g_main_loop_quit(main_loop);
+
+	return TRUE;
+}
+
+int main() {
+	GDBusConnection *connection;
+	GError *error = NULL;
+	guint owner_id;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+	g_type_init();
+#endif
+
+	connection = g_bus_get_sync(G_BUS_TYPE_STARTER, NULL, &error);
+	if (!connection) {
+		g_printerr("Failed to connect to bus: %s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	main_loop = g_main_loop_new(NULL, FALSE);
+	g_unix_signal_add(SIGTERM, handle_sigterm, NULL);
+
+	g_dbus_connection_add_filter(connection, filter_message, NULL, NULL);
+	owner_id = g_bus_own_name_on_connection(connection, DEFAULT_BUS_NAME, G_BUS_NAME_OWNER_FLAGS_NONE,
+			NULL, name_lost, NULL, NULL);
+
+	g_main_loop_run(main_loop);
+
+	g_bus_unown_name(owner_id);
+	if (last_reply_body)
+		g_variant_unref(last_reply_body);
+
+	g_dbus_connection_flush_sync(connection, NULL, NULL);
+	g_object_unref(connection);
+	g_main_loop_unref(main_loop);
+
+	return 0;
+}
@@ -0,0 +1,317 @@
+/*
+ *
+ * dbus-test-service-properties.c D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-test-service-properties.h"
+#include "dbus-ping-common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define PROPERTY_NAME_PREFIX		"Property"
+#define PROPERTY_NAME_SIZE			32
+
+#ifndef DBUS_ERROR_UNKNOWN_INTERFACE
+#define DBUS_ERROR_UNKNOWN_INTERFACE	"org.freedesktop.DBus.Error.UnknownInterface"
+#endif
+#ifndef DBUS_ERROR_UNKNOWN_PROPERTY
+#define DBUS_ERROR_UNKNOWN_PROPERTY		"org.freedesktop.DBus.Error.UnknownProperty"
+#endif
+
+
+union property_value {
+	dbus_int32_t i32;
+	dbus_uint32_t u32;
+	dbus_int64_t i64;
+	dbus_uint64_t u64;
+	double dbl;
+	dbus_bool_t bool_val;
+	unsigned char byt;
+	char *str;
+};
+
+struct property {
+	char name[PROPERTY_NAME_SIZE];
+	int type;
+	union property_value value;
+};
+
+struct property_set {
+	char *interface;
+	struct property *properties;
+	int count;
+	pthread_rwlock_t lock;
+};
+
+static const int property_types[] = {
+	DBUS_TYPE_INT32,
+	DBUS_TYPE_STRING,
+	DBUS_TYPE_BOOLEAN,
+	DBUS_TYPE_DOUBLE,
+	DBUS_TYPE_UINT32,
+	DBUS_TYPE_OBJECT_PATH,
+	DBUS_TYPE_INT64,
+	DBUS_TYPE_BYTE,
+	DBUS_TYPE_UINT64,
+};
+
+
+static int is_string_type(int type) {
+	return type == DBUS_TYPE_STRING || type == DBUS_TYPE_OBJECT_PATH || type == DBUS_TYPE_SIGNATURE;
+}
+
+static void property_init(struct property *property, int index) {
+	char str[PROPERTY_NAME_SIZE * 2];
+
+	snprintf(property->name, sizeof(property->name), PROPERTY_NAME_PREFIX "%d", index);
+	property->type = property_types[index % (sizeof(property_types) / sizeof(property_types[0]))];
+
+	switch (property->type) {
+	case DBUS_TYPE_STRING:
+		snprintf(str, sizeof(str), "Value of %s", property->name);
+		break;
+	case DBUS_TYPE_OBJECT_PATH:
+		snprintf(str, sizeof(str), "/com/bmw/Test/%s", property->name);
+		break;
+	case DBUS_TYPE_BOOLEAN:
+		property->value.bool_val = index & 1;
+		return;
+	case DBUS_TYPE_DOUBLE:
+		property->value.dbl = index * 0.5;
+		return;
+	case DBUS_TYPE_BYTE:
+		property->value.byt = index;
+		return;
+	case DBUS_TYPE_UINT32:
+		property->value.u32 = index;
+		return;
+	case DBUS_TYPE_INT64:
+		property->value.i64 = index;
+		return;
+	case DBUS_TYPE_UINT64:
+		property->value.u64 = index;
+		return;
+	default:
+		property->value.i32 = index;
+		return;
+	}
+
+	property->value.str = strdup(str);
+	assert_error(property->value.str != NULL, "Unable to allocate property (out of memory)");
+}
+
+struct property_set *property_set_new(const char *interface, int count) {
+	struct property_set *set;
+	int i;
+
+	set = calloc(1, sizeof(*set));
+	assert_error(set != NULL, "Unable to allocate property set (out of memory)");
+
+	set->interface = strdup(interface);
+	set->properties = calloc(count ? count : 1, sizeof(*set->properties));
+	assert_error(set->interface != NULL && set->properties != NULL,
+			"Unable to allocate property set (out of memory)");
+
+	for (i = 0; i < count; i++)
+		property_init(&set->properties[i], i);
+
+	set->count = count;
+	pthread_rwlock_init(&set->lock, NULL);
+
+	return set;
+}
+
+void property_set_free(struct property_set *set) {
+	int i;
+
+	for (i = 0; i < set->count; i++)
+		if (is_string_type(set->properties[i].type))
+			free(set->properties[i].value.str);
+
+	pthread_rwlock_destroy(&set->lock);
+	free(set->properties);
+	free(set->interface);
+	free(set);
+}
+
+/* the names are generated, so the index is in the name and no search is needed */
+static struct property *property_lookup(struct property_set *set, const char *name) {
+	const size_t prefix_length = strlen(PROPERTY_NAME_PREFIX);
+	char *end;
+	long index;
+
+	if (strncmp(name, PROPERTY_NAME_PREFIX, prefix_length) || !name[prefix_length])
+		return NULL;
+
+	index = strtol(name + prefix_length, &end, 10);
+	if (*end || index < 0 || index >= set->count || strcmp(set->properties[index].name, name))
+		return NULL;
+
+	return &set->properties[index];
+}
+
+/* an empty interface name stands for any interface */
+static int interface_matches(struct property_set *set, const char *interface) {
+	return !*interface || !strcmp(interface, set->interface);
+}
+
+static dbus_bool_t append_variant(DBusMessageIter *iter, const struct property *property) {
+	char signature[2] = { property->type, '\0' };
+	DBusMessageIter variant_iter;
+
+	return dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, signature, &variant_iter)
+			&& dbus_message_iter_append_basic(&variant_iter, property->type, &property->value)
+			&& dbus_message_iter_close_container(iter, &variant_iter);
+}
+
+DBusMessage *property_set_get(struct property_set *set, DBusMessage *message) {
+	const char *interface, *name;
+	struct property *property;
+	DBusMessageIter iter;
+	DBusMessage *reply;
+
+	if (!dbus_message_get_args(message, NULL,
+	                           DBUS_TYPE_STRING, &interface,
+	                           DBUS_TYPE_STRING, &name,
+	                           DBUS_TYPE_INVALID))
+		return dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "Expected (s interface, s name) arguments");
+
+	if (!interface_matches(set, interface))
+		return dbus_message_new_error_printf(message, DBUS_ERROR_UNKNOWN_INTERFACE,
+		                                     "Unknown interface '%s'", interface);
+
+	property = property_lookup(set, name);
+	if (!property)
+		return dbus_message_new_error_printf(message, DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property '%s'", name);
+
+	reply = dbus_message_new_method_return(message);
+	if (!reply)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	pthread_rwlock_rdlock(&set->lock);
+	if (!append_variant(&iter, property)) {
+		dbus_message_unref(reply);
+		reply = NULL;
+	}
+	pthread_rwlock_unlock(&set->lock);
+
+	return reply;
+}
+
+DBusMessage *property_set_get_all(struct property_set *set, DBusMessage *message) {
+	DBusMessageIter iter, array_iter, entry_iter;
+	const char *interface, *name;
+	DBusMessage *reply;
+	dbus_bool_t ok;
+	int i;
+
+	if (!dbus_message_get_args(message, NULL, DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID))
+		return dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "Expected (s interface) argument");
+
+	if (!interface_matches(set, interface))
+		return dbus_message_new_error_printf(message, DBUS_ERROR_UNKNOWN_INTERFACE,
+		                                     "Unknown interface '%s'", interface);
+
+	reply = dbus_message_new_method_return(message);
+	if (!reply)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+	ok = dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+	                                      DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+	                                      DBUS_TYPE_STRING_AS_STRING
+	                                      DBUS_TYPE_VARIANT_AS_STRING
+	                                      DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+	                                      &array_iter);
+
+	pthread_rwlock_rdlock(&set->lock);
+	for (i = 0; ok && i < set->count; i++) {
+		name = set->properties[i].name;
+		ok = dbus_message_iter_open_container(&array_iter, DBUS_TYPE_DICT_ENTRY, NULL, &entry_iter)
+				&& dbus_message_iter_append_basic(&entry_iter, DBUS_TYPE_STRING, &name)
+				&& append_variant(&entry_iter, &set->properties[i])
+				&& dbus_message_iter_close_container(&array_iter, &entry_iter);
+	}
+	pthread_rwlock_unlock(&set->lock);
+
+	if (!ok || !dbus_message_iter_close_container(&iter, &array_iter)) {
+		dbus_message_unref(reply);
+		return NULL;
+	}
+
+	return reply;
+}
+
+DBusMessage *property_set_set(struct property_set *set, DBusMessage *message) {
+	const char *interface, *name;
+	struct property *property;
+	union property_value value;
+	DBusMessageIter iter, variant_iter;
+
+	if (!dbus_message_iter_init(message, &iter)
+			|| dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+		goto invalid;
+	dbus_message_iter_get_basic(&iter, &interface);
+
+	if (!dbus_message_iter_next(&iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+		goto invalid;
+	dbus_message_iter_get_basic(&iter, &name);
+
+	if (!dbus_message_iter_next(&iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_VARIANT)
+		goto invalid;
+	dbus_message_iter_recurse(&iter, &variant_iter);
+
+	if (!interface_matches(set, interface))
+		return dbus_message_new_error_printf(message, DBUS_ERROR_UNKNOWN_INTERFACE,
+		                                     "Unknown interface '%s'", interface);
+
+	property = property_lookup(set, name);
+	if (!property)
+		return dbus_message_new_error_printf(message, DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property '%s'", name);
+
+	if (dbus_message_iter_get_arg_type(&variant_iter) != property->type)
+		return dbus_message_new_error_printf(message, DBUS_ERROR_INVALID_ARGS,
+		                                     "Property '%s' has type '%c'", name, property->type);
+
+	memset(&value, 0, sizeof(value));
+	dbus_message_iter_get_basic(&variant_iter, &value);
+
+	if (is_string_type(property->type)) {
+		value.str = strdup(value.str);
+		if (!value.str)
+			return NULL;
+	}
+
+	pthread_rwlock_wrlock(&set->lock);
+	if (is_string_type(property->type))
+		free(property->value.str);
+	property->value = value;
+	pthread_rwlock_unlock(&set->lock);
+
+	return dbus_message_new_method_return(message);
+
+invalid:
+	return dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS,
+	                              "Expected (s interface, s name, v value) arguments");
+}
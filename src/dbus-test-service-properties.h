@@ -0,0 +1,48 @@
+/*
+ *
+ * dbus-test-service-properties.h D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_TEST_SERVICE_PROPERTIES_H_
+#define DBUS_TEST_SERVICE_PROPERTIES_H_
+
+#include <dbus/dbus.h>
+
+
+struct property_set;
+
+/*
+ * COUNT read-write properties named Property0, Property1, ... of one
+ * interface. Their types cycle through the basic types, so that GetAll
+ * returns the kind of variant-heavy a{sv} a real service would. The set
+ * is thread safe.
+ */
+struct property_set *property_set_new(const char *interface, int count);
+void property_set_free(struct property_set *set);
+
+/*
+ * org.freedesktop.DBus.Properties: every call returns its reply or an error
+ * reply, NULL when out of memory.
+ */
+DBusMessage *property_set_get(struct property_set *set, DBusMessage *message);
+DBusMessage *property_set_get_all(struct property_set *set, DBusMessage *message);
+DBusMessage *property_set_set(struct property_set *set, DBusMessage *message);
+
+#endif /* DBUS_TEST_SERVICE_PROPERTIES_H_ */
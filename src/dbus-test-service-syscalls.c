@@ -0,0 +1,153 @@
+/*
+ *
+ * dbus-test-service-syscalls.c D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/* the fortified inline wrappers would clash with the definitions below */
+#undef _FORTIFY_SOURCE
+
+#include "dbus-test-service-syscalls.h"
+#include "dbus-ping-common.h"
+
+#include <poll.h>
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+
+static struct syscall_statistics counters;
+
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+static ssize_t (*real_readv)(int, const struct iovec *, int);
+static ssize_t (*real_writev)(int, const struct iovec *, int);
+static ssize_t (*real_recv)(int, void *, size_t, int);
+static ssize_t (*real_send)(int, const void *, size_t, int);
+static ssize_t (*real_recvmsg)(int, struct msghdr *, int);
+static ssize_t (*real_sendmsg)(int, const struct msghdr *, int);
+static int (*real_poll)(struct pollfd *, nfds_t, int);
+static int (*real_epoll_wait)(int, struct epoll_event *, int, int);
+static int (*real_ioctl)(int, unsigned long, void *);
+
+#define COUNT(counter)		__atomic_add_fetch(&counters.counter, 1, __ATOMIC_RELAXED)
+
+/* resolved before main() so that the worker threads never race on the pointers */
+static void __attribute__((constructor)) resolve_syscalls(void) {
+	real_read = dlsym(RTLD_NEXT, "read");
+	real_write = dlsym(RTLD_NEXT, "write");
+	real_readv = dlsym(RTLD_NEXT, "readv");
+	real_writev = dlsym(RTLD_NEXT, "writev");
+	real_recv = dlsym(RTLD_NEXT, "recv");
+	real_send = dlsym(RTLD_NEXT, "send");
+	real_recvmsg = dlsym(RTLD_NEXT, "recvmsg");
+	real_sendmsg = dlsym(RTLD_NEXT, "sendmsg");
+	real_poll = dlsym(RTLD_NEXT, "poll");
+	real_epoll_wait = dlsym(RTLD_NEXT, "epoll_wait");
+	real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+
+	assert_error(real_read && real_write && real_readv && real_writev && real_recv && real_send
+			&& real_recvmsg && real_sendmsg && real_poll && real_epoll_wait && real_ioctl,
+			"Unable to resolve the I/O functions: %s", dlerror());
+}
+
+ssize_t read(int fd, void *buf, size_t count) {
+	COUNT(reads);
+	return real_read(fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+	COUNT(writes);
+	return real_write(fd, buf, count);
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
+	COUNT(reads);
+	return real_readv(fd, iov, iovcnt);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+	COUNT(writes);
+	return real_writev(fd, iov, iovcnt);
+}
+
+ssize_t recv(int fd, void *buf, size_t len, int flags) {
+	COUNT(reads);
+	return real_recv(fd, buf, len, flags);
+}
+
+ssize_t send(int fd, const void *buf, size_t len, int flags) {
+	COUNT(writes);
+	return real_send(fd, buf, len, flags);
+}
+
+ssize_t recvmsg(int fd, struct msghdr *msg, int flags) {
+	COUNT(reads);
+	return real_recvmsg(fd, msg, flags);
+}
+
+ssize_t sendmsg(int fd, const struct msghdr *msg, int flags) {
+	COUNT(writes);
+	return real_sendmsg(fd, msg, flags);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+	COUNT(polls);
+	return real_poll(fds, nfds, timeout);
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+	COUNT(polls);
+	return real_epoll_wait(epfd, events, maxevents, timeout);
+}
+
+int ioctl(int fd, unsigned long request, ...) {
+	va_list ap;
+	void *arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	COUNT(others);
+	return real_ioctl(fd, request, arg);
+}
+
+void syscall_statistics_get(struct syscall_statistics *statistics) {
+	statistics->reads = __atomic_load_n(&counters.reads, __ATOMIC_RELAXED);
+	statistics->writes = __atomic_load_n(&counters.writes, __ATOMIC_RELAXED);
+	statistics->polls = __atomic_load_n(&counters.polls, __ATOMIC_RELAXED);
+	statistics->others = __atomic_load_n(&counters.others, __ATOMIC_RELAXED);
+}
+
+unsigned long syscall_statistics_total(const struct syscall_statistics *statistics) {
+	return statistics->reads + statistics->writes + statistics->polls + statistics->others;
+}
+
+void syscall_statistics_diff(struct syscall_statistics *result, const struct syscall_statistics *end,
+                             const struct syscall_statistics *start) {
+	result->reads = end->reads - start->reads;
+	result->writes = end->writes - start->writes;
+	result->polls = end->polls - start->polls;
+	result->others = end->others - start->others;
+}
@@ -0,0 +1,43 @@
+/*
+ *
+ * dbus-test-service-syscalls.h D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_TEST_SERVICE_SYSCALLS_H_
+#define DBUS_TEST_SERVICE_SYSCALLS_H_
+
+
+/*
+ * The I/O calls made by libdbus and the main loops are interposed and counted
+ * by the service binary itself, so no tracer is needed to get per message numbers.
+ */
+struct syscall_statistics {
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long polls;
+	unsigned long others;
+};
+
+void syscall_statistics_get(struct syscall_statistics *statistics);
+unsigned long syscall_statistics_total(const struct syscall_statistics *statistics);
+void syscall_statistics_diff(struct syscall_statistics *result, const struct syscall_statistics *end,
+                             const struct syscall_statistics *start);
+
+#endif /* DBUS_TEST_SERVICE_SYSCALLS_H_ */
@@ -29,6 +29,17 @@
 #include <libsystemd-bus/sd-bus.h>
 #include <libsystemd-bus/bus-message.h>
 
+#include "dbus-ping-systemd-common.h"
+
+/* the same name as the libdbus service, so both clients can drive either one */
+#define DEFAULT_BUS_NAME		"com.bmw.Test"
+/* what the service was called before, kept for the clients that still use it */
+#define LEGACY_BUS_NAME			"org.genivi.test.dbus.systemd.Ping"
+
+
+/* the last getEcho reply, getLastReply answers with a copy of it */
+static sd_bus_message *last_reply;
+
 
 static int handleGetTestDataCopy(sd_bus *bus, sd_bus_message *message, sd_bus_message **reply) {
 	int r;
@@ -119,6 +130,53 @@ static int handleGetTestDataArrayCopy(sd_bus *bus, sd_bus_message *message, sd_b
 	return r;
 }
 
+static int handleGetEcho(sd_bus *bus, sd_bus_message *message, sd_bus_message **reply) {
+	int r;
+
+	r = sd_bus_message_new_method_return(bus, message, reply);
+	if (r < 0) {
+		log_error("Failed to allocate return: %s", strerror(-r));
+		return r;
+	}
+
+	/* signature agnostic, whatever the call carries goes back */
+	r = systemd_message_copy_contents(*reply, message);
+	if (r < 0) {
+		log_error("Failed to copy message: %s", strerror(-r));
+		return r;
+	}
+
+	if (last_reply)
+		sd_bus_message_unref(last_reply);
+	last_reply = sd_bus_message_ref(*reply);
+
+	return r;
+}
+
+static int handleGetLastReply(sd_bus *bus, sd_bus_message *message, sd_bus_message **reply) {
+	int r;
+
+	if (!last_reply)
+		return handleGetEcho(bus, message, reply);
+
+	r = sd_bus_message_new_method_return(bus, message, reply);
+	if (r < 0) {
+		log_error("Failed to allocate return: %s", strerror(-r));
+		return r;
+	}
+
+	/* the header has to be written anew for every caller, only the body is reused */
+	r = sd_bus_message_rewind(last_reply, 1);
+	if (r >= 0)
+		r = systemd_message_copy_contents(*reply, last_reply);
+	if (r < 0) {
+		log_error("Failed to copy last reply: %s", strerror(-r));
+		return r;
+	}
+
+	return r;
+}
+
 int main() {
 	sd_bus *bus;
 	int r;
@@ -129,7 +187,13 @@ int main() {
         goto fail;
     }
 
-    r = sd_bus_request_name(bus, "org.genivi.test.dbus.systemd.Ping", 0);
+    r = sd_bus_request_name(bus, DEFAULT_BUS_NAME, 0);
+    if (r < 0) {
+    	log_error("Failed to acquire name: %s", strerror(-r));
+    	goto fail;
+    }
+
+    r = sd_bus_request_name(bus, LEGACY_BUS_NAME, 0);
     if (r < 0) {
     	log_error("Failed to acquire name: %s", strerror(-r));
     	goto fail;
@@ -159,6 +223,16 @@ int main() {
 				log_error("Failed to allocate return: %s", strerror(-r));
 				goto fail;
 			}
+		} else if (sd_bus_message_is_method_call(message, NULL, "getEcho")) {
+			r = handleGetEcho(bus, message, &reply);
+			if (r < 0) {
+				goto fail;
+			}
+		} else if (sd_bus_message_is_method_call(message, NULL, "getLastReply")) {
+			r = handleGetLastReply(bus, message, &reply);
+			if (r < 0) {
+				goto fail;
+			}
 		} else if (sd_bus_message_is_method_call(message, NULL, "getTestDataCopy")) {
 			r = handleGetTestDataCopy(bus, message, &reply);
 			if (r < 0) {
@@ -193,6 +267,9 @@ int main() {
 	r = 0;
 
 fail:
+	if (last_reply)
+		sd_bus_message_unref(last_reply);
+
 	if (bus)
 		sd_bus_unref(bus);
 
@@ -0,0 +1,219 @@
+/*
+ *
+ * dbus-test-service-workers.c D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include "dbus-test-service-workers.h"
+#include "dbus-ping-common.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define QUEUE_SIZE			1024	/* must be a power of two */
+#define CACHE_LINE_SIZE		64
+
+
+/* Bounded lock-free queue cell, see Dmitry Vyukov's MPMC queue */
+struct work_item {
+	unsigned long sequence;
+	worker_handler_t handler;
+	void *data;
+	DBusMessage *message;
+};
+
+struct worker {
+	pthread_t thread;
+	struct worker_pool *pool;
+	unsigned long processed;
+};
+
+struct worker_pool {
+	struct work_item items[QUEUE_SIZE];
+
+	char pad0[CACHE_LINE_SIZE];
+	unsigned long enqueue_pos;
+	char pad1[CACHE_LINE_SIZE];
+	unsigned long dequeue_pos;
+	char pad2[CACHE_LINE_SIZE];
+
+	sem_t available;
+	DBusConnection *connection;
+	struct worker *workers;
+	int count;
+};
+
+
+static int queue_push(struct worker_pool *pool, worker_handler_t handler, void *data, DBusMessage *message) {
+	unsigned long pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+	struct work_item *item;
+
+	for (;;) {
+		long diff;
+
+		item = &pool->items[pos & (QUEUE_SIZE - 1)];
+		diff = (long) __atomic_load_n(&item->sequence, __ATOMIC_ACQUIRE) - (long) pos;
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&pool->enqueue_pos, &pos, pos + 1, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0)
+			return 0; /* full */
+		else
+			pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+	}
+
+	item->handler = handler;
+	item->data = data;
+	item->message = message;
+	__atomic_store_n(&item->sequence, pos + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+static int queue_pop(struct worker_pool *pool, worker_handler_t *handler, void **data, DBusMessage **message) {
+	unsigned long pos = __atomic_load_n(&pool->dequeue_pos, __ATOMIC_RELAXED);
+	struct work_item *item;
+
+	for (;;) {
+		long diff;
+
+		item = &pool->items[pos & (QUEUE_SIZE - 1)];
+		diff = (long) __atomic_load_n(&item->sequence, __ATOMIC_ACQUIRE) - (long) (pos + 1);
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&pool->dequeue_pos, &pos, pos + 1, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0)
+			return 0; /* empty */
+		else
+			pos = __atomic_load_n(&pool->dequeue_pos, __ATOMIC_RELAXED);
+	}
+
+	*handler = item->handler;
+	*data = item->data;
+	*message = item->message;
+	__atomic_store_n(&item->sequence, pos + QUEUE_SIZE, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+static void *worker_thread(void *data) {
+	struct worker *worker = data;
+	struct worker_pool *pool = worker->pool;
+
+	for (;;) {
+		worker_handler_t handler;
+		DBusMessage *message;
+		void *handler_data;
+
+		while (sem_wait(&pool->available) < 0 && errno == EINTR)
+			;
+
+		/* the item is published before the semaphore is posted */
+		while (!queue_pop(pool, &handler, &handler_data, &message))
+			sched_yield();
+
+		if (message == NULL)
+			break;
+
+		if (handler(pool->connection, message, handler_data) == DBUS_HANDLER_RESULT_NEED_MEMORY)
+			fprintf(stderr, "Worker failed to handle message (out of memory)\n");
+
+		dbus_message_unref(message);
+		worker->processed++;
+	}
+
+	return NULL;
+}
+
+struct worker_pool *worker_pool_new(DBusConnection *connection, int count) {
+	struct worker_pool *pool;
+	sigset_t mask, old_mask;
+	int i;
+
+	pool = calloc(1, sizeof(*pool));
+	assert_error(pool != NULL, "Unable to allocate worker pool (out of memory)");
+
+	pool->workers = calloc(count, sizeof(*pool->workers));
+	assert_error(pool->workers != NULL, "Unable to allocate workers (out of memory)");
+
+	for (i = 0; i < QUEUE_SIZE; i++)
+		pool->items[i].sequence = i;
+
+	assert_error(sem_init(&pool->available, 0, 0) == 0, "Unable to initialize worker semaphore");
+
+	pool->connection = dbus_connection_ref(connection);
+	pool->count = count;
+
+	/* termination signals are left to the I/O thread */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+
+	for (i = 0; i < count; i++) {
+		pool->workers[i].pool = pool;
+		assert_error(pthread_create(&pool->workers[i].thread, NULL, worker_thread, &pool->workers[i]) == 0,
+				"Unable to start worker thread %d", i);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+	return pool;
+}
+
+void worker_pool_push(struct worker_pool *pool, worker_handler_t handler, void *data, DBusMessage *message) {
+	/* the queue is full when all workers are busy, just wait for them */
+	while (!queue_push(pool, handler, data, message))
+		sched_yield();
+
+	sem_post(&pool->available);
+}
+
+void worker_pool_stop(struct worker_pool *pool) {
+	int i;
+
+	/* a NULL message stops one worker */
+	for (i = 0; i < pool->count; i++)
+		worker_pool_push(pool, NULL, NULL, NULL);
+
+	for (i = 0; i < pool->count; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+}
+
+void worker_pool_free(struct worker_pool *pool) {
+	sem_destroy(&pool->available);
+	dbus_connection_unref(pool->connection);
+	free(pool->workers);
+	free(pool);
+}
+
+int worker_pool_get_count(const struct worker_pool *pool) {
+	return pool->count;
+}
+
+unsigned long worker_pool_get_processed(const struct worker_pool *pool, int worker) {
+	return pool->workers[worker].processed;
+}
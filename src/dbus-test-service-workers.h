@@ -0,0 +1,46 @@
+/*
+ *
+ * dbus-test-service-workers.h D-Bus benchmarking test service
+ *
+ * Copyright (C) 2013 BMW AG
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef DBUS_TEST_SERVICE_WORKERS_H_
+#define DBUS_TEST_SERVICE_WORKERS_H_
+
+#include <dbus/dbus.h>
+
+
+typedef DBusHandlerResult (*worker_handler_t)(DBusConnection *connection, DBusMessage *message, void *data);
+
+struct worker_pool;
+
+/*
+ * The pool is fed by the I/O thread only, the workers build and send the
+ * replies themselves on the (thread safe) connection. dbus_threads_init_default()
+ * must have been called before the pool is created.
+ */
+struct worker_pool *worker_pool_new(DBusConnection *connection, int count);
+void worker_pool_push(struct worker_pool *pool, worker_handler_t handler, void *data, DBusMessage *message);
+void worker_pool_stop(struct worker_pool *pool);
+void worker_pool_free(struct worker_pool *pool);
+
+int worker_pool_get_count(const struct worker_pool *pool);
+unsigned long worker_pool_get_processed(const struct worker_pool *pool, int worker);
+
+#endif /* DBUS_TEST_SERVICE_WORKERS_H_ */
@@ -20,12 +20,41 @@
  *
  */
 
+#include <poll.h>
+#include <errno.h>
 #include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
 #include <dbus/dbus.h>
 
+#include "dbus-ping-common.h"
+#include "dbus-ping-marshal.h"
+#include "dbus-test-service-cache.h"
+#include "dbus-test-service-cost.h"
+#include "dbus-test-service-epoll.h"
+#include "dbus-test-service-properties.h"
+#include "dbus-test-service-workers.h"
+#include "dbus-test-service-syscalls.h"
+
 #define DEFAULT_BUS_NAME		"com.bmw.Test"
 #define	DEFAULT_OBJECT_PATH		"/com/bmw/Test"
+#define TEST_SIGNAL_NAME		"TestSignal"
+
+#define MAX_BATCH_REPLIES		128
+#define DEFAULT_REPLY_CACHE_SIZE	64
+#define DEFAULT_PROPERTY_COUNT		16
+/* serials of the replies built without libdbus, out of reach of the ones it assigns */
+#define FIRST_PRIVATE_SERIAL	0x80000000U
+/* emitted signals are flushed once this much is queued, the socket is faster than the bus */
+#define MAX_OUTGOING_SIGNAL_SIZE	(1024 * 1024)
 
 typedef union {
 	dbus_int16_t i16;
@@ -40,7 +69,103 @@ typedef union {
 } DBusBasicValue;
 
 
+enum main_loop_type {
+	MAIN_LOOP_DISPATCH,
+	MAIN_LOOP_EPOLL,
+};
+
+static const char *main_loop_names[] = {
+	[MAIN_LOOP_DISPATCH] = "dispatch",
+	[MAIN_LOOP_EPOLL] = "epoll",
+};
+
+struct service_options {
+	int verbose;
+	int bash;
+	int workers;
+	int batch;
+	int preallocate;
+	int reply_cache;
+	int properties;
+	enum main_loop_type main_loop;
+	const char *listen_address;
+};
+
+/* refilled by the I/O thread between dispatch batches, drained by whoever sends */
+struct send_pool {
+	DBusPreallocatedSend **items;
+	int count;
+	pthread_mutex_t lock;
+};
+
+struct reply_batch {
+	DBusMessage *replies[MAX_BATCH_REPLIES];
+	int count;
+};
+
+struct method {
+	const char *name;
+	/* NULL matches the member on any interface */
+	const char *interface;
+	worker_handler_t handler;
+	struct handler_cost *cost;
+	unsigned long calls;
+	usec_t cost_time;
+	usec_t build_time;
+	usec_t send_time;
+};
+
+struct service_statistics {
+	unsigned long messages;
+	unsigned long replies;
+	unsigned long signals;
+	unsigned long wakeups;
+	unsigned long batches;
+	unsigned long preallocated_sends;
+	unsigned long send_pool_misses;
+	usec_t cache_hash_time;
+	usec_t cache_hit_time;
+	usec_t cache_miss_time;
+	usec_t first_message_time;
+	usec_t last_reply_time;
+	struct syscall_statistics first_message_syscalls;
+};
+
+/* monotonic, so that the client can line them up with its own clock */
+struct startup_times {
+	usec_t main;
+	usec_t connected;
+	usec_t name_acquired;
+};
+
+
+static struct service_options options = {
+	.reply_cache = DEFAULT_REPLY_CACHE_SIZE,
+	.properties = DEFAULT_PROPERTY_COUNT,
+};
+static struct service_statistics statistics;
+static struct startup_times startup_times;
+static struct worker_pool *worker_pool;
+static struct reply_cache *reply_cache;
+static struct property_set *property_set;
+static struct reply_batch reply_batch;
+static dbus_uint32_t private_serial = FIRST_PRIVATE_SERIAL;
+static struct send_pool send_pool = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static volatile sig_atomic_t terminated;
+static int connection_fd = -1;
+
 static DBusMessage *last_method_reply;
+static pthread_mutex_t last_method_reply_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* time spent sending by the handler that currently runs on this thread */
+static __thread usec_t handler_send_time;
+
+static dbus_uint32_t next_private_serial(void) {
+	dbus_uint32_t serial = __atomic_fetch_add(&private_serial, 1, __ATOMIC_RELAXED);
+
+	/* nobody replies to our replies, so wrapping around is harmless */
+	return serial ? serial : next_private_serial();
+}
 
 static void message_append_args(DBusMessageIter *iter, DBusMessageIter *append_iter) {
 	do {
@@ -87,21 +212,195 @@ static void message_append_args(DBusMessageIter *iter, DBusMessageIter *append_i
 	} while (dbus_message_iter_next(iter));
 }
 
-static DBusHandlerResult echo_send(DBusConnection *connection, DBusMessage *reply) {
-	if (!dbus_connection_send (connection, reply, NULL)) {
+static int write_all(int fd, struct iovec *iov, int count) {
+	while (count > 0) {
+		ssize_t written = writev(fd, iov, count);
+
+		if (written < 0) {
+			struct pollfd pfd = { fd, POLLOUT, 0 };
+
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+				return -1;
+
+			/* the socket is non-blocking, wait for the bus to catch up */
+			poll(&pfd, 1, -1);
+			continue;
+		}
+
+		while (count > 0 && (size_t) written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		if (count > 0) {
+			iov->iov_base = (char *) iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * libdbus writes every message with its own sendmsg(), so the batched replies
+ * are marshalled and written to the socket with a single writev() instead.
+ */
+static void flush_replies(DBusConnection *connection) {
+	struct iovec iov[MAX_BATCH_REPLIES];
+	char *data[MAX_BATCH_REPLIES];
+	int i, count = 0, fd;
+
+	if (!reply_batch.count)
+		return;
+
+	/* whatever libdbus still has queued must not be overtaken */
+	dbus_connection_flush(connection);
+
+	for (i = 0; i < reply_batch.count; i++) {
+		DBusMessage *reply = reply_batch.replies[i];
+		int length;
+
+		if (dbus_message_marshal(reply, &data[count], &length)) {
+			iov[count].iov_base = data[count];
+			iov[count].iov_len = length;
+			count++;
+		} else
+			fprintf(stderr, "Unable to marshal reply (out of memory)\n");
+
+		dbus_message_unref(reply);
+	}
+
+	reply_batch.count = 0;
+
+	if (!dbus_connection_get_socket(connection, &fd) || write_all(fd, iov, count) < 0)
+		fprintf(stderr, "Unable to write replies: %s\n", strerror(errno));
+
+	for (i = 0; i < count; i++)
+		dbus_free(data[i]);
+
+	statistics.batches++;
+}
+
+static void send_pool_refill(DBusConnection *connection) {
+	DBusPreallocatedSend *preallocated;
+
+	pthread_mutex_lock(&send_pool.lock);
+	while (send_pool.count < options.preallocate) {
+		preallocated = dbus_connection_preallocate_send(connection);
+		if (!preallocated)
+			break;
+
+		send_pool.items[send_pool.count++] = preallocated;
+	}
+	pthread_mutex_unlock(&send_pool.lock);
+}
+
+static void send_pool_free(DBusConnection *connection) {
+	while (send_pool.count > 0)
+		dbus_connection_free_preallocated_send(connection, send_pool.items[--send_pool.count]);
+
+	free(send_pool.items);
+}
+
+static dbus_bool_t send_reply(DBusConnection *connection, DBusMessage *reply) {
+	DBusPreallocatedSend *preallocated = NULL;
+
+	if (options.preallocate > 0) {
+		pthread_mutex_lock(&send_pool.lock);
+		if (send_pool.count > 0)
+			preallocated = send_pool.items[--send_pool.count];
+		pthread_mutex_unlock(&send_pool.lock);
+	}
+
+	if (!preallocated) {
+		if (options.preallocate > 0)
+			__atomic_add_fetch(&statistics.send_pool_misses, 1, __ATOMIC_RELAXED);
+
+		return dbus_connection_send(connection, reply, NULL);
+	}
+
+	dbus_connection_send_preallocated(connection, preallocated, reply, NULL);
+	__atomic_add_fetch(&statistics.preallocated_sends, 1, __ATOMIC_RELAXED);
+
+	return TRUE;
+}
+
+/* everything that may allocate or write in bulk happens between two dispatch batches */
+static void handle_idle(DBusConnection *connection) {
+	if (options.batch)
+		flush_replies(connection);
+
+	if (options.preallocate > 0)
+		send_pool_refill(connection);
+}
+
+static void handle_idle_epoll(void *data) {
+	handle_idle(data);
+}
+
+static void queue_reply(DBusConnection *connection, DBusMessage *reply) {
+	if (reply_batch.count == MAX_BATCH_REPLIES)
+		flush_replies(connection);
+
+	/* replies built by hand or copied from the last one already have a serial */
+	if (!dbus_message_get_serial(reply))
+		dbus_message_set_serial(reply, next_private_serial());
+
+	reply_batch.replies[reply_batch.count++] = dbus_message_ref(reply);
+}
+
+static DBusHandlerResult reply_send(DBusConnection *connection, DBusMessage *reply) {
+	usec_t time = time_now(CLOCK_MONOTONIC);
+
+	if (options.batch)
+		queue_reply(connection, reply);
+	else if (!send_reply(connection, reply)) {
 		dbus_message_unref(reply);
 		return DBUS_HANDLER_RESULT_NEED_MEMORY;
 	}
 
-	if (last_method_reply)
-		dbus_message_unref(last_method_reply);
+	handler_send_time += time_now(CLOCK_MONOTONIC) - time;
 
-	last_method_reply = reply;
+	__atomic_add_fetch(&statistics.replies, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&statistics.last_reply_time, time_now(CLOCK_MONOTONIC), __ATOMIC_RELAXED);
+
+	dbus_message_unref(reply);
 
 	return DBUS_HANDLER_RESULT_HANDLED;
 }
 
-static DBusHandlerResult echo_method_call(DBusConnection *connection, DBusMessage *message) {
+/* takes over the reference, getLastReply copies it from here */
+static void remember_reply(DBusMessage *reply) {
+	DBusMessage *old_reply;
+
+	pthread_mutex_lock(&last_method_reply_lock);
+	old_reply = last_method_reply;
+	last_method_reply = reply;
+	pthread_mutex_unlock(&last_method_reply_lock);
+
+	if (old_reply)
+		dbus_message_unref(old_reply);
+}
+
+/* only the echo methods send what getLastReply replays */
+static DBusHandlerResult echo_send(DBusConnection *connection, DBusMessage *reply) {
+	DBusHandlerResult result;
+
+	dbus_message_ref(reply);
+
+	result = reply_send(connection, reply);
+	if (result == DBUS_HANDLER_RESULT_HANDLED)
+		remember_reply(reply);
+	else
+		dbus_message_unref(reply);
+
+	return result;
+}
+
+static DBusHandlerResult echo_method_call(DBusConnection *connection, DBusMessage *message, void *data) {
 	DBusMessage *reply = dbus_message_new_method_return(message);
 	DBusMessageIter iter, append_iter;
 
@@ -115,15 +414,16 @@ static DBusHandlerResult echo_method_call(DBusConnection *connection, DBusMessag
 	return echo_send(connection, reply);
 }
 
-static DBusHandlerResult echo_last_method_reply(DBusConnection *connection, DBusMessage *message) {
-	DBusMessage *reply;
+static DBusHandlerResult echo_last_method_reply(DBusConnection *connection, DBusMessage *message, void *data) {
+	DBusMessage *reply = NULL;
 
-	if (!last_method_reply)
-		return echo_method_call(connection, message);
+	pthread_mutex_lock(&last_method_reply_lock);
+	if (last_method_reply)
+		reply = dbus_message_copy(last_method_reply);
+	pthread_mutex_unlock(&last_method_reply_lock);
 
-	reply = dbus_message_copy(last_method_reply);
 	if (!reply)
-		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+		return echo_method_call(connection, message, data);
 
 	dbus_message_set_destination(reply, dbus_message_get_sender(message));
 	dbus_message_set_reply_serial(reply, dbus_message_get_serial(message));
@@ -131,21 +431,253 @@ static DBusHandlerResult echo_last_method_reply(DBusConnection *connection, DBus
 	return echo_send(connection, reply);
 }
 
+/*
+ * The request's marshaled body is reused as is, only the header is written from
+ * scratch. Marshaling and demarshaling cost more than iterating a few arguments,
+ * this pays off for large arrays and many arguments.
+ */
+static DBusHandlerResult echo_fast_method_call(DBusConnection *connection, DBusMessage *message, void *data) {
+	DBusMessage *reply = message_new_method_return_with_body(message, next_private_serial());
+
+	if (!reply)
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+	return echo_send(connection, reply);
+}
+
+/* the reply is looked up by the content of the request, any earlier identical request will do */
+static DBusHandlerResult echo_cached_reply(DBusConnection *connection, DBusMessage *message, void *data) {
+	const char *signature = dbus_message_get_signature(message);
+	usec_t time = time_now(CLOCK_MONOTONIC), now;
+	DBusMessage *reply, *cached;
+	DBusMessageIter iter, append_iter;
+	const char *body;
+	char *marshaled;
+	int body_length;
+	uint64_t key;
+
+	if (!reply_cache)
+		return echo_method_call(connection, message, data);
+
+	marshaled = message_marshal_body(message, &body, &body_length);
+	if (!marshaled)
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+	key = hash64(body, body_length, hash64(signature, strlen(signature), 0));
+	dbus_free(marshaled);
+
+	now = time_now(CLOCK_MONOTONIC);
+	__atomic_add_fetch(&statistics.cache_hash_time, now - time, __ATOMIC_RELAXED);
+	time = now;
+
+	cached = reply_cache_lookup(reply_cache, key, signature, body_length);
+	if (cached) {
+		reply = dbus_message_copy(cached);
+		dbus_message_unref(cached);
+		if (!reply)
+			return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+		dbus_message_set_destination(reply, dbus_message_get_sender(message));
+		dbus_message_set_reply_serial(reply, dbus_message_get_serial(message));
+
+		__atomic_add_fetch(&statistics.cache_hit_time, time_now(CLOCK_MONOTONIC) - time, __ATOMIC_RELAXED);
+
+		return echo_send(connection, reply);
+	}
+
+	reply = dbus_message_new_method_return(message);
+	if (!reply)
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+	dbus_message_iter_init(message, &iter);
+	dbus_message_iter_init_append(reply, &append_iter);
+	message_append_args(&iter, &append_iter);
+
+	reply_cache_insert(reply_cache, key, signature, body_length, reply);
+	__atomic_add_fetch(&statistics.cache_miss_time, time_now(CLOCK_MONOTONIC) - time, __ATOMIC_RELAXED);
+
+	return echo_send(connection, reply);
+}
+
+/* lets a client that had the service activated break the activation down */
+static DBusHandlerResult echo_startup_times(DBusConnection *connection, DBusMessage *message, void *data) {
+	DBusMessage *reply = dbus_message_new_method_return(message);
+
+	if (!reply)
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+	dbus_message_append_args(reply,
+	                         DBUS_TYPE_UINT64, &startup_times.main,
+	                         DBUS_TYPE_UINT64, &startup_times.connected,
+	                         DBUS_TYPE_UINT64, &startup_times.name_acquired,
+	                         DBUS_TYPE_INVALID);
+
+	return reply_send(connection, reply);
+}
+
+static DBusHandlerResult properties_send(DBusConnection *connection, DBusMessage *reply) {
+	if (!reply)
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+	return reply_send(connection, reply);
+}
+
+static DBusHandlerResult get_property(DBusConnection *connection, DBusMessage *message, void *data) {
+	return properties_send(connection, property_set_get(property_set, message));
+}
+
+static DBusHandlerResult get_all_properties(DBusConnection *connection, DBusMessage *message, void *data) {
+	return properties_send(connection, property_set_get_all(property_set, message));
+}
+
+static DBusHandlerResult set_property(DBusConnection *connection, DBusMessage *message, void *data) {
+	return properties_send(connection, property_set_set(property_set, message));
+}
+
+static void sleep_until(usec_t deadline) {
+	struct timespec ts = {
+		.tv_sec = deadline / USEC_PER_SEC,
+		.tv_nsec = (deadline % USEC_PER_SEC) * NSEC_PER_USEC,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !terminated)
+		;
+}
+
+/*
+ * EmitSignals(u count, u rate, contents...) broadcasts count TestSignal(u sequence,
+ * t monotonic time, contents...) signals, rate per second or as fast as possible
+ * if rate is 0, and replies with the number of signals emitted.
+ */
+static DBusHandlerResult emit_signals(DBusConnection *connection, DBusMessage *message, void *data) {
+	usec_t start = time_now(CLOCK_MONOTONIC);
+	dbus_uint32_t count, rate, sequence;
+	dbus_bool_t has_contents;
+	DBusMessageIter iter;
+	DBusMessage *reply;
+
+	if (!dbus_message_iter_init(message, &iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32)
+		goto invalid;
+	dbus_message_iter_get_basic(&iter, &count);
+
+	if (!dbus_message_iter_next(&iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32)
+		goto invalid;
+	dbus_message_iter_get_basic(&iter, &rate);
+
+	has_contents = dbus_message_iter_next(&iter);
+
+	for (sequence = 0; sequence < count && !terminated; sequence++) {
+		DBusMessageIter contents = iter, append_iter;
+		DBusMessage *signal;
+		usec_t time;
+
+		if (rate > 0)
+			sleep_until(start + sequence * USEC_PER_SEC / rate);
+
+		signal = dbus_message_new_signal(DEFAULT_OBJECT_PATH, DEFAULT_BUS_NAME, TEST_SIGNAL_NAME);
+		if (!signal)
+			break;
+
+		time = time_now(CLOCK_MONOTONIC);
+		dbus_message_iter_init_append(signal, &append_iter);
+		dbus_message_iter_append_basic(&append_iter, DBUS_TYPE_UINT32, &sequence);
+		dbus_message_iter_append_basic(&append_iter, DBUS_TYPE_UINT64, &time);
+		if (has_contents)
+			message_append_args(&contents, &append_iter);
+
+		if (!dbus_connection_send(connection, signal, NULL)) {
+			dbus_message_unref(signal);
+			break;
+		}
+		dbus_message_unref(signal);
+
+		__atomic_add_fetch(&statistics.signals, 1, __ATOMIC_RELAXED);
+
+		if (dbus_connection_get_outgoing_size(connection) > MAX_OUTGOING_SIGNAL_SIZE)
+			dbus_connection_flush(connection);
+	}
+
+	reply = dbus_message_new_method_return(message);
+	if (!reply)
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+	dbus_message_append_args(reply, DBUS_TYPE_UINT32, &sequence, DBUS_TYPE_INVALID);
+
+	return reply_send(connection, reply);
+
+invalid:
+	reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS,
+	                               "Expected (u count, u rate, contents...) arguments");
+	if (!reply)
+		return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+	return reply_send(connection, reply);
+}
+
+static struct method methods[] = {
+	{ "getEcho",		NULL,	echo_method_call },
+	{ "getLastReply",	NULL,	echo_last_method_reply },
+	{ "getFastEcho",	NULL,	echo_fast_method_call },
+	{ "getCachedReply",	NULL,	echo_cached_reply },
+	{ "EmitSignals",	NULL,	emit_signals },
+	{ "getStartupTimes",	NULL,	echo_startup_times },
+	{ "Get",		DBUS_INTERFACE_PROPERTIES,	get_property },
+	{ "GetAll",		DBUS_INTERFACE_PROPERTIES,	get_all_properties },
+	{ "Set",		DBUS_INTERFACE_PROPERTIES,	set_property },
+};
+
+/* runs on the I/O thread or on a worker */
+static DBusHandlerResult run_method(DBusConnection *connection, DBusMessage *message, void *data) {
+	struct method *method = data;
+	DBusHandlerResult result;
+	usec_t time;
+
+	/* the synthetic work the service does before it replies */
+	if (method->cost)
+		__atomic_add_fetch(&method->cost_time, handler_cost_apply(method->cost), __ATOMIC_RELAXED);
+
+	time = time_now(CLOCK_MONOTONIC);
+	handler_send_time = 0;
+	result = method->handler(connection, message, NULL);
+	time = time_now(CLOCK_MONOTONIC) - time;
+
+	__atomic_add_fetch(&method->calls, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&method->build_time, time - handler_send_time, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&method->send_time, handler_send_time, __ATOMIC_RELAXED);
+
+	return result;
+}
+
 static void path_unregistered_func(DBusConnection *connection, void *user_data) {
 	/* connection was finalized */
 }
 
+static DBusHandlerResult handle_method_call(DBusConnection *connection, DBusMessage *message,
+                                            struct method *method) {
+	if (!statistics.messages++) {
+		statistics.first_message_time = time_now(CLOCK_MONOTONIC);
+		syscall_statistics_get(&statistics.first_message_syscalls);
+	}
+
+	if (!worker_pool)
+		return run_method(connection, message, method);
+
+	worker_pool_push(worker_pool, run_method, method, dbus_message_ref(message));
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 static DBusHandlerResult path_message_func(DBusConnection *connection, DBusMessage *message, void *user_data) {
 	const char *member;
+	int i;
 
 	if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL) {
 		member = dbus_message_get_member(message);
 
-		if (!strcmp(member, "getLastReply"))
-			return echo_last_method_reply(connection, message);
-
-		if (!strcmp(member, "getEcho"))
-			return echo_method_call(connection, message);
+		for (i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+			if (methods[i].interface ? dbus_message_is_method_call(message, methods[i].interface, methods[i].name) :
+			                           !strcmp(member, methods[i].name))
+				return handle_method_call(connection, message, &methods[i]);
 	}
 
 	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
@@ -157,10 +689,454 @@ static DBusObjectPathVTable echo_vtable = {
 		NULL,
 };
 
-int main(void) {
+static void wakeup_main(void *data) {
+	const int *wakeup_fd = data;
+	eventfd_t value = 1;
+
+	/* a worker queued a reply while the I/O thread was busy */
+	if (write(*wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		fprintf(stderr, "Unable to wake up main loop: %s\n", strerror(errno));
+}
+
+static void run_dispatch_loop(DBusConnection *connection) {
+	while (!terminated && dbus_connection_read_write_dispatch(connection, -1)) {
+		statistics.wakeups++;
+		handle_idle(connection);
+	}
+}
+
+/*
+ * The workers send on the connection too, so the I/O thread must not block
+ * inside libdbus: it polls the socket itself and is woken up whenever a worker
+ * could not write its reply immediately.
+ */
+static void run_worker_loop(DBusConnection *connection) {
+	int wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	struct pollfd fds[2];
+
+	assert_error(wakeup_fd >= 0, "Unable to create eventfd: %s", strerror(errno));
+	assert_error(dbus_connection_get_unix_fd(connection, &fds[0].fd), "Unable to get connection socket");
+	fds[1].fd = wakeup_fd;
+	fds[1].events = POLLIN;
+
+	dbus_connection_set_wakeup_main_function(connection, wakeup_main, &wakeup_fd, NULL);
+
+	while (!terminated && dbus_connection_get_is_connected(connection)) {
+		fds[0].events = POLLIN;
+		if (dbus_connection_has_messages_to_send(connection))
+			fds[0].events |= POLLOUT;
+
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Unable to poll: %s\n", strerror(errno));
+			break;
+		}
+
+		statistics.wakeups++;
+
+		if (fds[1].revents & POLLIN) {
+			eventfd_t value;
+			eventfd_read(wakeup_fd, &value);
+		}
+
+		dbus_connection_read_write(connection, 0);
+		while (dbus_connection_dispatch(connection) == DBUS_DISPATCH_DATA_REMAINS)
+			;
+
+		handle_idle(connection);
+	}
+
+	dbus_connection_set_wakeup_main_function(connection, NULL, NULL, NULL);
+	close(wakeup_fd);
+}
+
+/* like the dispatch loop, but everything already received is dispatched before the replies are flushed */
+static void run_batch_loop(DBusConnection *connection) {
+	while (!terminated && dbus_connection_read_write(connection, -1)) {
+		statistics.wakeups++;
+
+		while (dbus_connection_get_dispatch_status(connection) == DBUS_DISPATCH_DATA_REMAINS)
+			dbus_connection_dispatch(connection);
+
+		handle_idle(connection);
+	}
+}
+
+static void run_epoll_loop(DBusConnection *connection) {
+	struct epoll_loop *loop = epoll_loop_new();
+
+	epoll_loop_add_connection(loop, connection);
+	epoll_loop_set_idle_function(loop, handle_idle_epoll, connection);
+	epoll_loop_run(loop, &terminated);
+
+	statistics.wakeups = epoll_loop_get_wakeups(loop);
+	epoll_loop_free(loop);
+}
+
+static void register_peer(DBusConnection *connection, void *data) {
+	if (!dbus_connection_register_object_path(connection, DEFAULT_OBJECT_PATH, &echo_vtable, NULL))
+		fprintf(stderr, "Unable to register object path '%s'!", DEFAULT_OBJECT_PATH);
+
+	if (options.verbose)
+		fprintf(stderr, "Accepted peer connection\n");
+}
+
+/* peer-to-peer: no bus daemon, every client connects to the service directly */
+static int run_server_loop(void) {
+	struct epoll_loop *loop;
+	DBusServer *server;
+	DBusError error;
+	char *address;
+
+	dbus_error_init(&error);
+
+	server = dbus_server_listen(options.listen_address, &error);
+	if (dbus_error_is_set(&error)) {
+		fprintf(stderr, "Unable to listen on '%s': %s\n", options.listen_address, error.message);
+		dbus_error_free(&error);
+		return -1;
+	}
+
+	startup_times.connected = startup_times.name_acquired = time_now(CLOCK_MONOTONIC);
+
+	if (options.verbose) {
+		address = dbus_server_get_address(server);
+		fprintf(stderr, "Listening on %s\n", address);
+		dbus_free(address);
+	}
+
+	loop = epoll_loop_new();
+	epoll_loop_add_server(loop, server, register_peer, NULL);
+	epoll_loop_run(loop, &terminated);
+
+	statistics.wakeups = epoll_loop_get_wakeups(loop);
+	epoll_loop_free(loop);
+
+	dbus_server_disconnect(server);
+	dbus_server_unref(server);
+
+	return 0;
+}
+
+static double per_message(unsigned long count) {
+	return statistics.messages ? (double) count / statistics.messages : 0.0;
+}
+
+/* what the hits would have cost as misses, minus what they and the hashing cost instead */
+static void show_cache_summary(void) {
+	struct reply_cache_statistics cache;
+	unsigned long lookups;
+	double hit_rate, miss_time, saved_time;
+
+	reply_cache_get_statistics(reply_cache, &cache);
+	lookups = cache.hits + cache.misses;
+	hit_rate = lookups ? 100.0 * cache.hits / lookups : 0.0;
+	miss_time = cache.misses ? (double) statistics.cache_miss_time / cache.misses : 0.0;
+	saved_time = cache.hits * miss_time - statistics.cache_hit_time - statistics.cache_hash_time;
+
+	if (options.bash)
+		printf("DBUS_TEST_SERVICE_CACHE_SIZE=%d;\n"
+				"DBUS_TEST_SERVICE_CACHE_HITS=%lu;\n"
+				"DBUS_TEST_SERVICE_CACHE_MISSES=%lu;\n"
+				"DBUS_TEST_SERVICE_CACHE_EVICTIONS=%lu;\n"
+				"DBUS_TEST_SERVICE_CACHE_HIT_RATE=%.2f;\n"
+				"DBUS_TEST_SERVICE_CACHE_SAVED_TIME=%.0f;\n",
+				options.reply_cache, cache.hits, cache.misses, cache.evictions, hit_rate, saved_time);
+
+	if (!options.bash || options.verbose)
+		fprintf(options.bash ? stderr : stdout,
+				"cache size hits       misses     evictions  hit rate   "
+				"hash/call  hit/call   miss/call  saved time (usec)\n"
+				"%-10d %-10lu %-10lu %-10lu %-10.2f %-10.2f %-10.2f %-10.2f %.0f\n",
+				options.reply_cache, cache.hits, cache.misses, cache.evictions, hit_rate,
+				lookups ? (double) statistics.cache_hash_time / lookups : 0.0,
+				cache.hits ? (double) statistics.cache_hit_time / cache.hits : 0.0,
+				miss_time, saved_time);
+}
+
+static void show_summary(void) {
+	/* what is printed, usec_t is only unsigned long on 64 bit */
+	unsigned long long elapsed_time = statistics.last_reply_time - statistics.first_message_time;
+	unsigned long long msgs_per_sec = elapsed_time > 0 ? USEC_PER_SEC * statistics.replies / elapsed_time : 0;
+	double replies_per_write;
+	struct syscall_statistics syscalls, now;
+	unsigned long total_syscalls;
+	int i;
+
+	/* setup and name acquisition are not part of the measurement */
+	syscall_statistics_get(&now);
+	syscall_statistics_diff(&syscalls, &now, &statistics.first_message_syscalls);
+	total_syscalls = syscall_statistics_total(&syscalls);
+	replies_per_write = syscalls.writes ? (double) statistics.replies / syscalls.writes : 0.0;
+
+	if (options.bash)
+		printf("DBUS_TEST_SERVICE_WORKERS=%d;\n"
+				"DBUS_TEST_SERVICE_MESSAGES=%lu;\n"
+				"DBUS_TEST_SERVICE_REPLIES=%lu;\n"
+				"DBUS_TEST_SERVICE_SIGNALS=%lu;\n"
+				"DBUS_TEST_SERVICE_TIME=%llu;\n"
+				"DBUS_TEST_SERVICE_MSGS_PER_SEC=%llu;\n"
+				"DBUS_TEST_SERVICE_MAIN_LOOP=%s;\n"
+				"DBUS_TEST_SERVICE_WAKEUPS=%lu;\n"
+				"DBUS_TEST_SERVICE_SYSCALLS=%lu;\n"
+				"DBUS_TEST_SERVICE_WAKEUPS_PER_MSG=%.2f;\n"
+				"DBUS_TEST_SERVICE_SYSCALLS_PER_MSG=%.2f;\n"
+				"DBUS_TEST_SERVICE_BATCH=%d;\n"
+				"DBUS_TEST_SERVICE_BATCHES=%lu;\n"
+				"DBUS_TEST_SERVICE_REPLIES_PER_WRITE=%.2f;\n"
+				"DBUS_TEST_SERVICE_PREALLOCATE=%d;\n"
+				"DBUS_TEST_SERVICE_PREALLOCATED_SENDS=%lu;\n"
+				"DBUS_TEST_SERVICE_SEND_POOL_MISSES=%lu;\n",
+				options.workers, statistics.messages, statistics.replies, statistics.signals,
+				elapsed_time, msgs_per_sec,
+				main_loop_names[options.main_loop], statistics.wakeups, total_syscalls,
+				per_message(statistics.wakeups), per_message(total_syscalls),
+				options.batch, statistics.batches, replies_per_write,
+				options.preallocate, statistics.preallocated_sends, statistics.send_pool_misses);
+
+	if (reply_cache)
+		show_cache_summary();
+
+	for (i = 0; options.bash && i < sizeof(methods) / sizeof(methods[0]); i++) {
+		char name[32];
+		int j;
+
+		if (!methods[i].calls)
+			continue;
+
+		for (j = 0; methods[i].name[j] && j < sizeof(name) - 1; j++)
+			name[j] = toupper(methods[i].name[j]);
+		name[j] = '\0';
+
+		printf("DBUS_TEST_SERVICE_%s_CALLS=%lu;\n"
+				"DBUS_TEST_SERVICE_%s_COST_TIME=%llu;\n"
+				"DBUS_TEST_SERVICE_%s_BUILD_TIME=%llu;\n"
+				"DBUS_TEST_SERVICE_%s_SEND_TIME=%llu;\n",
+				name, methods[i].calls, name, (unsigned long long) methods[i].cost_time,
+				name, (unsigned long long) methods[i].build_time, name, (unsigned long long) methods[i].send_time);
+	}
+
+	if (!options.bash || options.verbose) {
+		fprintf(options.bash ? stderr : stdout,
+				"workers    messages   replies    signals    time (usec)   msgs/sec\n"
+				"%-10d %-10lu %-10lu %-10lu %-13llu %llu\n",
+				options.workers, statistics.messages, statistics.replies, statistics.signals,
+				elapsed_time, msgs_per_sec);
+
+		fprintf(options.bash ? stderr : stdout,
+				"main loop  wakeups    reads      writes     polls      other      wakeups/msg  syscalls/msg\n"
+				"%-10s %-10lu %-10lu %-10lu %-10lu %-10lu %-12.2f %.2f\n",
+				main_loop_names[options.main_loop], statistics.wakeups,
+				syscalls.reads, syscalls.writes, syscalls.polls, syscalls.others,
+				per_message(statistics.wakeups), per_message(total_syscalls));
+
+		fprintf(options.bash ? stderr : stdout,
+				"batching   batches    replies/batch  replies/write\n"
+				"%-10s %-10lu %-14.2f %.2f\n",
+				options.batch ? "on" : "off", statistics.batches,
+				statistics.batches ? (double) statistics.replies / statistics.batches : 0.0,
+				replies_per_write);
+
+		fprintf(options.bash ? stderr : stdout,
+				"preallocate  preallocated sends  pool misses\n"
+				"%-12d %-19lu %lu\n",
+				options.preallocate, statistics.preallocated_sends, statistics.send_pool_misses);
+
+		fprintf(options.bash ? stderr : stdout,
+				"method         calls      cost time    build time   send time    "
+				"cost/call    build/call   send/call (usec)\n");
+		for (i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+			if (methods[i].calls)
+				fprintf(options.bash ? stderr : stdout,
+						"%-14s %-10lu %-12llu %-12llu %-12llu %-12.2f %-12.2f %.2f\n",
+						methods[i].name, methods[i].calls,
+						(unsigned long long) methods[i].cost_time, (unsigned long long) methods[i].build_time,
+						(unsigned long long) methods[i].send_time,
+						(double) methods[i].cost_time / methods[i].calls,
+						(double) methods[i].build_time / methods[i].calls,
+						(double) methods[i].send_time / methods[i].calls);
+
+		for (i = 0; worker_pool && i < worker_pool_get_count(worker_pool); i++)
+			fprintf(options.bash ? stderr : stdout, "worker %-3d processed %lu\n",
+					i, worker_pool_get_processed(worker_pool, i));
+	}
+
+	fflush(stdout);
+}
+
+static void handle_termination(int sig) {
+	terminated = 1;
+
+	/* libdbus restarts interrupted polls, wake it up by closing the socket */
+	if (connection_fd >= 0)
+		shutdown(connection_fd, SHUT_RDWR);
+}
+
+static void usage(const char *name) {
+	printf("Usage: %s [OPTIONS]...\n\n"
+			"  -h, --help           Print help and exit\n"
+			"  -v, --verbose        Print statistics on exit\n"
+			"      --bash           Print statistics as bash variables on exit\n"
+			"  -w, --workers=COUNT  Handle method calls in a pool of COUNT worker threads\n"
+			"  -l, --main-loop=LOOP Main loop to use: dispatch (default) or epoll\n"
+			"  -L, --listen=ADDRESS Serve peer-to-peer connections on ADDRESS instead of\n"
+			"                       connecting to a bus, implies the epoll main loop\n"
+			"  -b, --batch          Flush the replies once per dispatch batch\n"
+			"  -r, --reply-cache=SIZE\n"
+			"                       Keep up to SIZE getCachedReply replies in an LRU cache\n"
+			"                       (default 64, 0 disables the cache)\n"
+			"  -P, --properties=COUNT\n"
+			"                       Number of properties of mixed types behind\n"
+			"                       org.freedesktop.DBus.Properties (default 16)\n"
+			"  -C, --handler-cost=METHOD:spin|sleep:fixed|exp|lognormal:MEAN_USEC[:SIGMA]\n"
+			"  -C, --handler-cost=METHOD:touch:KIB\n"
+			"                       Burn CPU, sleep or touch a working set before METHOD\n"
+			"                       replies ('*' for all methods), may be repeated\n"
+			"  -p, --preallocate=COUNT\n"
+			"                       Send the replies through a pool of COUNT preallocated\n"
+			"                       send resources\n",
+			name);
+}
+
+static void set_handler_cost(const char *spec) {
+	struct handler_cost *cost = malloc(sizeof(*cost));
+	char *method;
+	int i, found = 0;
+
+	assert_error(cost != NULL, "Unable to allocate handler cost (out of memory)");
+	method = handler_cost_parse(spec, cost);
+
+	for (i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+		if (!strcmp(method, "*") || !strcmp(method, methods[i].name)) {
+			methods[i].cost = cost;
+			found = 1;
+		}
+
+	assert_error(found, "Unknown method '%s' in handler cost", method);
+	free(method);
+}
+
+static void parse_options(int argc, char *argv[]) {
+	static const struct option long_options[] = {
+		{ "help",		0, NULL, 'h' },
+		{ "verbose",	0, NULL, 'v' },
+		{ "bash",		0, NULL, 'B' },
+		{ "workers",	1, NULL, 'w' },
+		{ "main-loop",	1, NULL, 'l' },
+		{ "batch",		0, NULL, 'b' },
+		{ "preallocate",	1, NULL, 'p' },
+		{ "reply-cache",	1, NULL, 'r' },
+		{ "handler-cost",	1, NULL, 'C' },
+		{ "listen",		1, NULL, 'L' },
+		{ "properties",	1, NULL, 'P' },
+		{ NULL,			0, NULL, 0 }
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "hvw:l:L:bp:r:P:C:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+
+		case 'v':
+			options.verbose = 1;
+			break;
+
+		case 'B':
+			options.bash = 1;
+			break;
+
+		case 'b':
+			options.batch = 1;
+			break;
+
+		case 'p':
+			options.preallocate = atoi(optarg);
+			assert_error(options.preallocate >= 0, "Invalid preallocate count '%s'", optarg);
+			break;
+
+		case 'r':
+			options.reply_cache = atoi(optarg);
+			assert_error(options.reply_cache >= 0, "Invalid reply cache size '%s'", optarg);
+			break;
+
+		case 'P':
+			options.properties = atoi(optarg);
+			assert_error(options.properties >= 0, "Invalid property count '%s'", optarg);
+			break;
+
+		case 'C':
+			set_handler_cost(optarg);
+			break;
+
+		case 'w':
+			options.workers = atoi(optarg);
+			assert_error(options.workers >= 0, "Invalid worker count '%s'", optarg);
+			break;
+
+		case 'l':
+			if (!strcmp(optarg, main_loop_names[MAIN_LOOP_DISPATCH]))
+				options.main_loop = MAIN_LOOP_DISPATCH;
+			else if (!strcmp(optarg, main_loop_names[MAIN_LOOP_EPOLL]))
+				options.main_loop = MAIN_LOOP_EPOLL;
+			else
+				assert_error(0, "Invalid main loop '%s'", optarg);
+			break;
+
+		case 'L':
+			options.listen_address = optarg;
+			options.main_loop = MAIN_LOOP_EPOLL;
+			break;
+
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+}
+
+int main(int argc, char *argv[]) {
 	int ret = -1;
-	DBusConnection *connection;
+	DBusConnection *connection = NULL;
 	DBusError error;
+	struct sigaction action;
+
+	startup_times.main = time_now(CLOCK_MONOTONIC);
+
+	parse_options(argc, argv);
+
+	/* the workers send on their own, there is no dispatch batch to flush */
+	assert_error(!options.batch || !options.workers, "Batching can't be combined with worker threads");
+
+	/* the workers, the reply batch and the send pool are bound to a single connection */
+	assert_error(!options.listen_address || (!options.workers && !options.batch && !options.preallocate),
+			"Peer-to-peer mode can't be combined with workers, batching or preallocation");
+
+	/* must precede any other libdbus call */
+	if (options.workers > 0)
+		dbus_threads_init_default();
+
+	property_set = property_set_new(DEFAULT_BUS_NAME, options.properties);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_termination;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	if (options.listen_address) {
+		if (options.reply_cache > 0)
+			reply_cache = reply_cache_new(options.reply_cache);
+
+		if (run_server_loop() < 0)
+			goto end;
+
+		if (options.verbose || options.bash)
+			show_summary();
+
+		goto cleanup;
+	}
 
 	dbus_error_init(&error);
 
@@ -171,6 +1147,8 @@ int main(void) {
 		goto end;
 	}
 
+	startup_times.connected = time_now(CLOCK_MONOTONIC);
+
 	dbus_bus_request_name(connection, DEFAULT_BUS_NAME, 0, &error);
 	if (dbus_error_is_set(&error)) {
 		fprintf(stderr, "Failed to get bus name '%s': %s", DEFAULT_BUS_NAME, error.message);
@@ -178,13 +1156,55 @@ int main(void) {
 		goto end;
 	}
 
+	startup_times.name_acquired = time_now(CLOCK_MONOTONIC);
+
 	if (!dbus_connection_register_object_path(connection, DEFAULT_OBJECT_PATH, &echo_vtable, NULL)) {
 		fprintf(stderr, "Unable to register object path '%s'!", DEFAULT_OBJECT_PATH);
 		goto end;
 	}
 
-	while (dbus_connection_read_write_dispatch(connection, -1))
-		;
+	/* report the statistics when the bus goes away */
+	dbus_connection_set_exit_on_disconnect(connection, FALSE);
+	dbus_connection_get_socket(connection, &connection_fd);
+
+	if (options.preallocate > 0) {
+		send_pool.items = calloc(options.preallocate, sizeof(*send_pool.items));
+		assert_error(send_pool.items != NULL, "Unable to allocate send pool (out of memory)");
+		send_pool_refill(connection);
+	}
+
+	if (options.reply_cache > 0)
+		reply_cache = reply_cache_new(options.reply_cache);
+
+	if (options.workers > 0)
+		worker_pool = worker_pool_new(connection, options.workers);
+
+	if (options.main_loop == MAIN_LOOP_EPOLL)
+		run_epoll_loop(connection);
+	else if (worker_pool)
+		run_worker_loop(connection);
+	else if (options.batch)
+		run_batch_loop(connection);
+	else
+		run_dispatch_loop(connection);
+
+	if (worker_pool)
+		worker_pool_stop(worker_pool);
+
+	if (options.verbose || options.bash)
+		show_summary();
+
+	if (worker_pool)
+		worker_pool_free(worker_pool);
+
+	if (options.preallocate > 0)
+		send_pool_free(connection);
+
+cleanup:
+	property_set_free(property_set);
+
+	if (reply_cache)
+		reply_cache_free(reply_cache);
 
 	if (last_method_reply)
 		dbus_message_unref(last_method_reply);